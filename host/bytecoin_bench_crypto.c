@@ -0,0 +1,320 @@
+/*******************************************************************************
+*   Bytecoin Wallet for Ledger Nano S
+*   (c) 2018 - 2019 The Bytecoin developers
+*
+*  Licensed under the Apache License, Version 2.0 (the "License");
+*  you may not use this file except in compliance with the License.
+*  You may obtain a copy of the License at
+*
+*      http://www.apache.org/licenses/LICENSE-2.0
+*
+*  Unless required by applicable law or agreed to in writing, software
+*  distributed under the License is distributed on an "AS IS" BASIS,
+*  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+*  See the License for the specific language governing permissions and
+*  limitations under the License.
+********************************************************************************/
+
+// Times every primitive of bytecoin_crypto.h and bytecoin_keys.h in
+// isolation and reports ns/op and syscalls/op as CSV or JSON.
+//
+//   bytecoin_bench_crypto [--format csv|json] [--min-time-ms N] [--filter NAME]
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "os.h"
+#include "host_syscalls.h"
+#include "bytecoin_host.h"
+#include "bytecoin_crypto.h"
+#include "bytecoin_fe.h"
+#include "bytecoin_keys.h"
+#include "bytecoin_wallet.h"
+#include "bytecoin_vars.h"
+#include "bytecoin_debug.h"
+
+typedef struct fixture_s
+{
+    elliptic_curve_point_t P;
+    elliptic_curve_point_t Q;
+    elliptic_curve_scalar_t a;
+    elliptic_curve_scalar_t b;
+    hash_t hash;
+    hash_t tx_inputs_hash;
+    uint8_t output_secret_hash_arg[40];
+    keccak_hasher_t hasher;
+    elliptic_curve_point_t point_result;
+    elliptic_curve_scalar_t scalar_result;
+    hash_t hash_result;
+} fixture_t;
+
+static fixture_t F;
+
+static void bench_ecmul(void)       { ecmul(&F.P, &F.a, &F.point_result); }
+static void bench_ecmul_G(void)     { ecmul_G(&F.a, &F.point_result); }
+static void bench_ecmul_H(void)     { ecmul_H(&F.a, &F.point_result); }
+static void bench_ecadd(void)       { ecadd(&F.P, &F.Q, &F.point_result); }
+static void bench_ecsub(void)       { ecsub(&F.P, &F.Q, &F.point_result); }
+static void bench_ecadd_G(void)     { ecadd_G(&F.P, &F.point_result); }
+static void bench_ecmul_8(void)     { ecmul_8(&F.P, &F.point_result); }
+static void bench_ecmulm(void)      { ecmulm(&F.a, &F.b, &F.scalar_result); }
+static void bench_ecaddm(void)      { ecaddm(&F.a, &F.b, &F.scalar_result); }
+static void bench_reduce32(void)    { reduce32(&F.hash, &F.scalar_result); }
+static void bench_reduce64(void)    { reduce64(&F.hash, &F.scalar_result); }
+static void bench_invert32(void)    { invert32(&F.a, &F.scalar_result); }
+static void bench_fast_hash(void)   { fast_hash(F.hash.data, sizeof(F.hash.data), &F.hash_result); }
+static void bench_hash_to_scalar(void) { hash_to_scalar(F.output_secret_hash_arg, sizeof(F.output_secret_hash_arg), &F.scalar_result); }
+
+static void bench_hash_point_to_good_point(void)
+{
+    hash_point_to_good_point(&F.P, &F.point_result);
+}
+
+static void bench_ge_fromfe_frombytes(void)
+{
+    ge_fromfe_frombytes(&F.hash, &F.point_result);
+}
+
+static void bench_keccak_update_varint(void)
+{
+    keccak_update_varint(&F.hasher, 0x12345678);
+}
+
+static void bench_secret_keys_to_public_key(void)
+{
+    secret_keys_to_public_key(&F.a, &F.b, &F.point_result);
+}
+
+static void bench_generate_keyimage(void)
+{
+    generate_keyimage(&F.P, &F.a, &F.point_result);
+}
+
+static void bench_generate_keyimage_for_address(void)
+{
+    generate_keyimage_for_address(&G_host_device.state.wallet_keys, &G_host_device.state.address_cache, F.output_secret_hash_arg, sizeof(F.output_secret_hash_arg), 0, &F.point_result);
+}
+
+static void bench_linkable_generate_output_secret(void)
+{
+    uint8_t address_type;
+    linkable_generate_output_secret(&F.hash, &F.scalar_result, &address_type);
+}
+
+static void bench_unlinkable_generate_output_secret(void)
+{
+    uint8_t address_type;
+    unlinkable_generate_output_secret(&F.hash, &F.point_result, &address_type);
+}
+
+static void bench_linkable_derive_output_public_key(void)
+{
+    public_key_t encrypted_secret;
+    linkable_derive_output_public_key(&F.a, &F.tx_inputs_hash, 1, &F.P, &F.Q, &F.point_result, &encrypted_secret);
+}
+
+static void bench_unlinkable_derive_output_public_key(void)
+{
+    public_key_t encrypted_secret;
+    unlinkable_derive_output_public_key(&F.P, &F.tx_inputs_hash, 1, &F.P, &F.Q, &F.point_result, &encrypted_secret);
+}
+
+static void bench_generate_sign_secrets(void)
+{
+    sign_secrets_t k;
+    generate_sign_secrets(&G_host_device.state.wallet_keys, 1, &F.hash, &k);
+}
+
+static void bench_encrypt_scalar(void)
+{
+    static const uint8_t name[2] = { 'r', 's' };
+    encrypt_scalar(&F.hash, &F.a, 1, name, &F.hash_result);
+}
+
+static void bench_prepare_address_public(void)
+{
+    public_key_t address_s_v;
+    prepare_address_public(&G_host_device.state.wallet_keys, &G_host_device.state.address_cache, 0, &F.point_result, &address_s_v);
+}
+
+typedef struct benchmark_s
+{
+    const char* name;
+    void (*run)(void);
+} benchmark_t;
+
+static const benchmark_t benchmarks[] = {
+    { "ecmul",                               bench_ecmul },
+    { "ecmul_G",                             bench_ecmul_G },
+    { "ecmul_H",                             bench_ecmul_H },
+    { "ecadd",                               bench_ecadd },
+    { "ecsub",                               bench_ecsub },
+    { "ecadd_G",                             bench_ecadd_G },
+    { "ecmul_8",                             bench_ecmul_8 },
+    { "ecmulm",                              bench_ecmulm },
+    { "ecaddm",                              bench_ecaddm },
+    { "hash_point_to_good_point",            bench_hash_point_to_good_point },
+    { "ge_fromfe_frombytes",                 bench_ge_fromfe_frombytes },
+    { "reduce32",                            bench_reduce32 },
+    { "reduce64",                            bench_reduce64 },
+    { "invert32",                            bench_invert32 },
+    { "fast_hash",                           bench_fast_hash },
+    { "hash_to_scalar",                      bench_hash_to_scalar },
+    { "keccak_update_varint",                bench_keccak_update_varint },
+    { "secret_keys_to_public_key",           bench_secret_keys_to_public_key },
+    { "generate_keyimage",                   bench_generate_keyimage },
+    { "generate_keyimage_for_address",       bench_generate_keyimage_for_address },
+    { "linkable_generate_output_secret",     bench_linkable_generate_output_secret },
+    { "unlinkable_generate_output_secret",   bench_unlinkable_generate_output_secret },
+    { "linkable_derive_output_public_key",   bench_linkable_derive_output_public_key },
+    { "unlinkable_derive_output_public_key", bench_unlinkable_derive_output_public_key },
+    { "generate_sign_secrets",               bench_generate_sign_secrets },
+    { "encrypt_scalar",                      bench_encrypt_scalar },
+    { "prepare_address_public",              bench_prepare_address_public },
+};
+
+typedef struct result_s
+{
+    uint64_t iterations;
+    double ns_per_op;
+    double syscalls_per_op[HOST_SYSCALL_COUNT];
+    double total_syscalls_per_op;
+} result_t;
+
+static
+uint64_t now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+}
+
+static
+void setup_fixture(void)
+{
+    hash_to_scalar("a", 1, &F.a);
+    hash_to_scalar("b", 1, &F.b);
+    ecmul_G(&F.a, &F.P);
+    ecmul_G(&F.b, &F.Q);
+    fast_hash("hash", 4, &F.hash);
+    fast_hash("tx_inputs_hash", 14, &F.tx_inputs_hash);
+    for (size_t i = 0; i < sizeof(F.output_secret_hash_arg); ++i)
+        F.output_secret_hash_arg[i] = (uint8_t)i;
+    keccak_init(&F.hasher);
+}
+
+static
+void run_benchmark(const benchmark_t* benchmark, uint64_t min_time_ns, result_t* result)
+{
+    benchmark->run(); // warm up, e.g. the address secret cache
+
+    const host_syscall_counters_t before = G_host_syscalls;
+    uint64_t iterations = 0;
+    const uint64_t start = now_ns();
+    uint64_t elapsed = 0;
+    do
+    {
+        benchmark->run();
+        ++iterations;
+        elapsed = now_ns() - start;
+    } while (elapsed < min_time_ns);
+
+    result->iterations = iterations;
+    result->ns_per_op = (double)elapsed / iterations;
+    for (int i = 0; i < HOST_SYSCALL_COUNT; ++i)
+        result->syscalls_per_op[i] = (double)(G_host_syscalls.calls[i] - before.calls[i]) / iterations;
+    result->total_syscalls_per_op = (double)(host_syscall_total(&G_host_syscalls) - host_syscall_total(&before)) / iterations;
+}
+
+static
+void print_csv_header(void)
+{
+    printf("primitive,iterations,ns_per_op,syscalls_per_op");
+    for (int i = 0; i < HOST_SYSCALL_COUNT; ++i)
+        printf(",%s", host_syscall_name(i));
+    printf("\n");
+}
+
+static
+void print_csv(const benchmark_t* benchmark, const result_t* result)
+{
+    printf("%s,%llu,%.1f,%g", benchmark->name, (unsigned long long)result->iterations, result->ns_per_op, result->total_syscalls_per_op);
+    for (int i = 0; i < HOST_SYSCALL_COUNT; ++i)
+        printf(",%g", result->syscalls_per_op[i]);
+    printf("\n");
+}
+
+static
+void print_json(const benchmark_t* benchmark, const result_t* result, bool first)
+{
+    printf("%s\n    {\"primitive\": \"%s\", \"iterations\": %llu, \"ns_per_op\": %.1f, \"syscalls_per_op\": %g, \"syscalls\": {",
+           first ? "" : ",", benchmark->name, (unsigned long long)result->iterations, result->ns_per_op, result->total_syscalls_per_op);
+    bool first_syscall = true;
+    for (int i = 0; i < HOST_SYSCALL_COUNT; ++i)
+    {
+        if (result->syscalls_per_op[i] == 0)
+            continue;
+        printf("%s\"%s\": %g", first_syscall ? "" : ", ", host_syscall_name(i), result->syscalls_per_op[i]);
+        first_syscall = false;
+    }
+    printf("}}");
+}
+
+static
+void usage(const char* argv0)
+{
+    fprintf(stderr, "usage: %s [--format csv|json] [--min-time-ms N] [--filter NAME]\n", argv0);
+    exit(2);
+}
+
+int main(int argc, char** argv)
+{
+    bool json = false;
+    uint64_t min_time_ms = 200;
+    const char* filter = NULL;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        if (!strcmp(argv[i], "--format") && i + 1 < argc)
+        {
+            ++i;
+            if (!strcmp(argv[i], "json"))
+                json = true;
+            else if (strcmp(argv[i], "csv"))
+                usage(argv[0]);
+        }
+        else if (!strcmp(argv[i], "--min-time-ms") && i + 1 < argc)
+            min_time_ms = strtoull(argv[++i], NULL, 10);
+        else if (!strcmp(argv[i], "--filter") && i + 1 < argc)
+            filter = argv[++i];
+        else
+            usage(argv[0]);
+    }
+
+    bytecoin_host_init();
+    setup_fixture();
+
+    if (json)
+        printf("{\"app_version\": \"%s\", \"benchmarks\": [", XSTR(BYTECOIN_VERSION));
+    else
+        print_csv_header();
+
+    bool first = true;
+    for (size_t i = 0; i < sizeof(benchmarks) / sizeof(benchmarks[0]); ++i)
+    {
+        if (filter && !strstr(benchmarks[i].name, filter))
+            continue;
+        result_t result;
+        run_benchmark(&benchmarks[i], min_time_ms * 1000000u, &result);
+        if (json)
+            print_json(&benchmarks[i], &result, first);
+        else
+            print_csv(&benchmarks[i], &result);
+        first = false;
+    }
+
+    if (json)
+        printf("\n]}\n");
+    return 0;
+}
@@ -0,0 +1,454 @@
+/*******************************************************************************
+*   Bytecoin Wallet for Ledger Nano S
+*   (c) 2018 - 2019 The Bytecoin developers
+*
+*  Licensed under the Apache License, Version 2.0 (the "License");
+*  you may not use this file except in compliance with the License.
+*  You may obtain a copy of the License at
+*
+*      http://www.apache.org/licenses/LICENSE-2.0
+*
+*  Unless required by applicable law or agreed to in writing, software
+*  distributed under the License is distributed on an "AS IS" BASIS,
+*  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+*  See the License for the specific language governing permissions and
+*  limitations under the License.
+********************************************************************************/
+
+// Signs synthetic transactions of every requested shape through dispatch()
+// and reports how time, APDU count and bytes on the wire grow with it.
+//
+//   bytecoin_bench_sign [--format csv|json] [--inputs LIST] [--mixins LIST]
+//                       [--outputs LIST] [--extra LIST] [--addresses N]
+//                       [--ui SCRIPT] [--screens] [--batch] [--chained]
+//                       [--combined] [--varints] [--grouped]
+//                       [--grouped-steps] [--streamed] [--tokens]
+//                       [--key-stream] [--lose N]
+//
+// LIST is a comma separated list of values, every combination is signed.
+// SCRIPT decides the confirmation, e.g. approve:1500 approves after 1.5 s;
+// the outputs phase then includes the wait. --screens prints the confirmation
+// text to stderr. --batch sends the commands packed by host_tx_batch(),
+// --chained streams long rings and extra as chained commands, --combined sends
+// every input as one INS_SIG_ADD_INPUT, --varints as one
+// INS_SIG_ADD_INPUT_VARINTS. --grouped sends the outputs BYTECOIN_MAX_ADD_OUTPUTS
+// at a time with INS_SIG_ADD_OUTPUTS, --grouped-steps the inputs of steps A
+// and B with INS_SIG_STEP_A_INPUTS and INS_SIG_STEP_B_INPUTS. --streamed
+// streams the prefix up to the extra size with INS_SIG_PREFIX. --tokens has
+// the inputs answer their tokens and steps A and B take them with
+// INS_SIG_STEP_A_TOKEN and INS_SIG_STEP_B_TOKEN. --key-stream has step B
+// encrypt the scalars of an input with one key stream. --lose N drops every
+// Nth response and fetches it again with INS_GET_LAST_RESPONSE.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "os.h"
+#include "host_syscalls.h"
+#include "bytecoin_host.h"
+#include "bytecoin_host_tx.h"
+#include "bytecoin_ledger_api.h"
+#include "bytecoin_apdu.h"
+
+#define MAX_LIST_SIZE 16
+
+typedef struct list_s
+{
+    uint32_t values[MAX_LIST_SIZE];
+    size_t size;
+} list_t;
+
+typedef struct phase_stats_s
+{
+    uint64_t apdus;
+    uint64_t bytes_in;   // command bytes received by the device
+    uint64_t bytes_out;  // response bytes sent by the device
+    uint64_t ns;
+    uint64_t syscalls;
+} phase_stats_t;
+
+typedef struct session_s
+{
+    const host_tx_apdus_t* apdus;
+    size_t next;
+    uint64_t started_ns;
+    uint64_t started_syscalls;
+    phase_stats_t phases[HOST_TX_PHASE_COUNT];
+    uint64_t ui_render_ns;
+    uint16_t sequence;      // of the last response, see INS_GET_LAST_RESPONSE
+    bool lost;              // the last response is fetched again
+    uint8_t lost_response[IO_LAST_RESPONSE_SIZE];
+    size_t lost_length;
+    uint8_t* tokens;        // answered by the inputs, BYTECOIN_INPUT_TOKEN_SIZE each
+    size_t tokens_count;
+    size_t step_a_tokens;   // put into commands of step A so far
+    size_t step_b_tokens;
+} session_t;
+
+static const char* G_ui_script = "";
+static bool G_print_screens = false;
+static bool G_batch = false;
+static bool G_chained = false;
+static bool G_combined = false;
+static bool G_varints = false;
+static bool G_grouped = false;
+static bool G_grouped_steps = false;
+static bool G_streamed = false;
+static bool G_tokens = false;
+static bool G_key_stream = false;
+static uint32_t G_lose_every = 0;
+
+static
+uint64_t now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+}
+
+static
+size_t session_next_command(void* ctx, uint8_t* buf, size_t size)
+{
+    session_t* session = ctx;
+    host_apdu_t apdu;
+    const host_tx_apdu_t* item;
+    if (session->lost)
+    {
+        item = &session->apdus->items[session->next - 1];
+        host_apdu_encode_get_last_response(&apdu);
+        apdu.data[2] = (uint8_t)(session->sequence >> 8);
+        apdu.data[3] = (uint8_t)session->sequence;
+    }
+    else
+    {
+        if (session->next == session->apdus->count)
+            return 0;
+        item = &session->apdus->items[session->next++];
+        apdu = item->apdu;
+        uint8_t* token = host_tx_token(&apdu);
+        size_t* used = apdu.data[1] == INS_SIG_STEP_A_TOKEN ? &session->step_a_tokens : &session->step_b_tokens;
+        if (token && *used < session->tokens_count)
+            os_memmove(token, session->tokens + BYTECOIN_INPUT_TOKEN_SIZE * (*used)++, BYTECOIN_INPUT_TOKEN_SIZE);
+    }
+    if (apdu.length > size)
+        return 0;
+    os_memmove(buf, apdu.data, apdu.length);
+
+    phase_stats_t* phase = &session->phases[item->phase];
+    phase->apdus += 1;
+    phase->bytes_in += apdu.length;
+    session->started_syscalls = host_syscall_total(&G_host_syscalls);
+    session->started_ns = now_ns();
+    return apdu.length;
+}
+
+static
+void session_on_response(void* ctx, const uint8_t* buf, size_t len)
+{
+    const uint64_t ns = now_ns();
+    session_t* session = ctx;
+    const host_tx_apdu_t* item = &session->apdus->items[session->next - 1];
+    phase_stats_t* phase = &session->phases[item->phase];
+    phase->ns += ns - session->started_ns;
+    phase->syscalls += host_syscall_total(&G_host_syscalls) - session->started_syscalls;
+    phase->bytes_out += len;
+
+    if (session->lost)
+    {
+        session->lost = false;
+        if (len != session->lost_length || memcmp(buf, session->lost_response, len))
+        {
+            fprintf(stderr, "APDU #%zu: the response fetched again differs\n", session->next - 1);
+            exit(1);
+        }
+    }
+    else
+    {
+        session->sequence = (item->apdu.data[1] == INS_RESET) ? 0 : session->sequence + 1;
+        // the response is dropped on the way and fetched again
+        if (G_lose_every && session->sequence % G_lose_every == 0 && len <= sizeof(session->lost_response))
+        {
+            session->lost = true;
+            session->lost_length = len;
+            os_memmove(session->lost_response, buf, len);
+            return;
+        }
+    }
+
+    uint16_t sw = host_response_sw(buf, len);
+    if (sw == SW_NO_ERROR && item->apdu.data[1] == INS_BATCH)
+    {
+        host_batch_item_t items[BYTECOIN_BATCH_MAX_RESPONSE / 3];
+        const int count = host_batch_parse(buf, len, items, sizeof(items) / sizeof(items[0]));
+        if (count <= 0)
+            sw = SW_SOMETHING_WRONG;
+        else
+            sw = items[count - 1].sw;
+    }
+    if (!host_sw_ok(sw))
+    {
+        fprintf(stderr, "APDU #%zu (INS 0x%02x, %s) failed with SW %04x\n",
+                session->next - 1, item->apdu.data[1], host_tx_phase_name(item->phase), sw);
+        exit(1);
+    }
+    if (host_tx_answers_token(&item->apdu) && len == BYTECOIN_INPUT_TOKEN_SIZE + 2)
+    {
+        session->tokens = realloc(session->tokens, BYTECOIN_INPUT_TOKEN_SIZE * (session->tokens_count + 1));
+        os_memmove(session->tokens + BYTECOIN_INPUT_TOKEN_SIZE * session->tokens_count++, buf, BYTECOIN_INPUT_TOKEN_SIZE);
+    }
+}
+
+static
+void session_on_screen(void* ctx, const host_ui_screen_t* screen)
+{
+    session_t* session = ctx;
+    session->ui_render_ns += screen->render_ns;
+    if (!G_print_screens)
+        return;
+    for (size_t i = 0; i < screen->lines_count; ++i)
+        fprintf(stderr, "%s | %s\n", screen->name, screen->lines[i]);
+    fprintf(stderr, "%s | %s after %u ms\n", screen->name,
+            screen->step.action == HOST_UI_APPROVE ? "approved" : "rejected", screen->step.delay_ms);
+}
+
+static
+void sign(const host_tx_shape_t* shape, session_t* session)
+{
+    host_tx_apdus_t apdus = { 0 };
+    host_tx_generate(shape, &apdus);
+    if (G_batch)
+    {
+        host_tx_apdus_t batched = { 0 };
+        host_tx_batch(&apdus, &batched);
+        host_tx_apdus_free(&apdus);
+        apdus = batched;
+    }
+
+    os_memset(session, 0, sizeof(*session));
+    session->apdus = &apdus;
+    const bytecoin_host_transport_t transport = { session_next_command, session_on_response, session };
+    bytecoin_host_init();
+    host_ui_set_script(&G_host_device.ui, G_ui_script);
+    G_host_device.ui.on_screen = session_on_screen;
+    G_host_device.ui.ctx = session;
+    bytecoin_host_run(&transport);
+    if (session->next != apdus.count)
+    {
+        fprintf(stderr, "the session stopped after %zu of %zu APDUs\n", session->next, apdus.count);
+        exit(1);
+    }
+    free(session->tokens);
+    session->tokens = NULL;
+    host_tx_apdus_free(&apdus);
+}
+
+static
+void total(const session_t* session, phase_stats_t* result)
+{
+    os_memset(result, 0, sizeof(*result));
+    for (int i = 0; i < HOST_TX_PHASE_COUNT; ++i)
+    {
+        result->apdus     += session->phases[i].apdus;
+        result->bytes_in  += session->phases[i].bytes_in;
+        result->bytes_out += session->phases[i].bytes_out;
+        result->ns        += session->phases[i].ns;
+        result->syscalls  += session->phases[i].syscalls;
+    }
+}
+
+static
+void print_csv_header(void)
+{
+    printf("inputs,mixins,outputs,extra,addresses,apdus,bytes_in,bytes_out,syscalls,total_ms");
+    for (int i = HOST_TX_PHASE_START; i < HOST_TX_PHASE_COUNT; ++i)
+        printf(",%s_ms", host_tx_phase_name(i));
+    printf(",ui_render_ms\n");
+}
+
+static
+void print_csv(const host_tx_shape_t* shape, const session_t* session)
+{
+    phase_stats_t sum;
+    total(session, &sum);
+    printf("%u,%u,%u,%u,%u,%llu,%llu,%llu,%llu,%.3f",
+           shape->inputs, shape->mixins, shape->outputs, shape->extra_size, shape->addresses,
+           (unsigned long long)sum.apdus, (unsigned long long)sum.bytes_in, (unsigned long long)sum.bytes_out,
+           (unsigned long long)sum.syscalls, sum.ns / 1e6);
+    for (int i = HOST_TX_PHASE_START; i < HOST_TX_PHASE_COUNT; ++i)
+        printf(",%.3f", session->phases[i].ns / 1e6);
+    printf(",%.3f\n", session->ui_render_ns / 1e6);
+}
+
+static
+void print_json_stats(const phase_stats_t* stats)
+{
+    printf("{\"apdus\": %llu, \"bytes_in\": %llu, \"bytes_out\": %llu, \"syscalls\": %llu, \"ms\": %.3f}",
+           (unsigned long long)stats->apdus, (unsigned long long)stats->bytes_in, (unsigned long long)stats->bytes_out,
+           (unsigned long long)stats->syscalls, stats->ns / 1e6);
+}
+
+static
+void print_json(const host_tx_shape_t* shape, const session_t* session, bool first)
+{
+    phase_stats_t sum;
+    total(session, &sum);
+    printf("%s\n    {\"inputs\": %u, \"mixins\": %u, \"outputs\": %u, \"extra\": %u, \"addresses\": %u,\n     \"total\": ",
+           first ? "" : ",", shape->inputs, shape->mixins, shape->outputs, shape->extra_size, shape->addresses);
+    print_json_stats(&sum);
+    printf(",\n     \"ui_render_ms\": %.3f,\n     \"phases\": {", session->ui_render_ns / 1e6);
+    for (int i = HOST_TX_PHASE_START; i < HOST_TX_PHASE_COUNT; ++i)
+    {
+        printf("%s\n       \"%s\": ", i != HOST_TX_PHASE_START ? "," : "", host_tx_phase_name(i));
+        print_json_stats(&session->phases[i]);
+    }
+    printf("}}");
+}
+
+static
+void usage(const char* argv0)
+{
+    fprintf(stderr, "usage: %s [--format csv|json] [--inputs LIST] [--mixins LIST] [--outputs LIST] [--extra LIST] [--addresses N] [--ui SCRIPT] [--screens] [--batch] [--chained] [--combined] [--varints] [--grouped] [--grouped-steps] [--streamed] [--tokens] [--key-stream] [--lose N]\n", argv0);
+    exit(2);
+}
+
+static
+void parse_list(const char* argv0, const char* str, list_t* list)
+{
+    list->size = 0;
+    while (*str)
+    {
+        char* end;
+        const unsigned long value = strtoul(str, &end, 10);
+        if (end == str || list->size == MAX_LIST_SIZE || (*end && *end != ','))
+            usage(argv0);
+        list->values[list->size++] = (uint32_t)value;
+        str = *end ? end + 1 : end;
+    }
+    if (!list->size)
+        usage(argv0);
+}
+
+int main(int argc, char** argv)
+{
+    bool json = false;
+    list_t inputs  = { { 1, 10, 100 }, 3 };
+    list_t mixins  = { { 0, 3, 10 }, 3 };
+    list_t outputs = { { 2 }, 1 };
+    list_t extra   = { { 64 }, 1 };
+    uint32_t addresses = 1;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        if (!strcmp(argv[i], "--screens"))
+        {
+            G_print_screens = true;
+            continue;
+        }
+        if (!strcmp(argv[i], "--batch"))
+        {
+            G_batch = true;
+            continue;
+        }
+        if (!strcmp(argv[i], "--chained"))
+        {
+            G_chained = true;
+            continue;
+        }
+        if (!strcmp(argv[i], "--combined"))
+        {
+            G_combined = true;
+            continue;
+        }
+        if (!strcmp(argv[i], "--varints"))
+        {
+            G_combined = G_varints = true;
+            continue;
+        }
+        if (!strcmp(argv[i], "--grouped"))
+        {
+            G_grouped = true;
+            continue;
+        }
+        if (!strcmp(argv[i], "--grouped-steps"))
+        {
+            G_grouped_steps = true;
+            continue;
+        }
+        if (!strcmp(argv[i], "--streamed"))
+        {
+            G_streamed = true;
+            continue;
+        }
+        if (!strcmp(argv[i], "--tokens"))
+        {
+            G_tokens = true;
+            continue;
+        }
+        if (!strcmp(argv[i], "--key-stream"))
+        {
+            G_key_stream = true;
+            continue;
+        }
+        if (i + 1 == argc)
+            usage(argv[0]);
+        if (!strcmp(argv[i], "--lose"))
+            G_lose_every = strtoul(argv[++i], NULL, 10);
+        else if (!strcmp(argv[i], "--format"))
+        {
+            ++i;
+            if (!strcmp(argv[i], "json"))
+                json = true;
+            else if (strcmp(argv[i], "csv"))
+                usage(argv[0]);
+        }
+        else if (!strcmp(argv[i], "--inputs"))
+            parse_list(argv[0], argv[++i], &inputs);
+        else if (!strcmp(argv[i], "--mixins"))
+            parse_list(argv[0], argv[++i], &mixins);
+        else if (!strcmp(argv[i], "--outputs"))
+            parse_list(argv[0], argv[++i], &outputs);
+        else if (!strcmp(argv[i], "--extra"))
+            parse_list(argv[0], argv[++i], &extra);
+        else if (!strcmp(argv[i], "--addresses"))
+            addresses = strtoul(argv[++i], NULL, 10);
+        else if (!strcmp(argv[i], "--ui"))
+        {
+            G_ui_script = argv[++i];
+            host_ui_t ui;
+            if (!host_ui_set_script(&ui, G_ui_script))
+                usage(argv[0]);
+        }
+        else
+            usage(argv[0]);
+    }
+    // the streamed inputs and the grouped steps have no tokens
+    if (G_tokens && (G_streamed || G_grouped_steps))
+        usage(argv[0]);
+
+    if (json)
+        printf("{\"sessions\": [");
+    else
+        print_csv_header();
+
+    bool first = true;
+    for (size_t i = 0; i < inputs.size; ++i)
+        for (size_t m = 0; m < mixins.size; ++m)
+            for (size_t o = 0; o < outputs.size; ++o)
+                for (size_t e = 0; e < extra.size; ++e)
+                {
+                    const host_tx_shape_t shape = { inputs.values[i], mixins.values[m], outputs.values[o], extra.values[e], addresses, G_chained, G_combined, G_varints, G_grouped, G_grouped_steps, G_streamed, G_tokens, G_key_stream };
+                    session_t session;
+                    sign(&shape, &session);
+                    if (json)
+                        print_json(&shape, &session, first);
+                    else
+                        print_csv(&shape, &session);
+                    fflush(stdout);
+                    first = false;
+                }
+
+    if (json)
+        printf("\n]}\n");
+    return 0;
+}
@@ -0,0 +1,271 @@
+/*******************************************************************************
+*   Bytecoin Wallet for Ledger Nano S
+*   (c) 2018 - 2019 The Bytecoin developers
+*
+*  Licensed under the Apache License, Version 2.0 (the "License");
+*  you may not use this file except in compliance with the License.
+*  You may obtain a copy of the License at
+*
+*      http://www.apache.org/licenses/LICENSE-2.0
+*
+*  Unless required by applicable law or agreed to in writing, software
+*  distributed under the License is distributed on an "AS IS" BASIS,
+*  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+*  See the License for the specific language governing permissions and
+*  limitations under the License.
+********************************************************************************/
+
+// Predicts the device time spent in every APDU handler of bytecoin_apdu.c
+// from the syscalls and USB traffic counted on a host run of a wallet
+// session: a sync (scan_outputs, generate_keyimage) followed by signing a
+// transaction of the given shape. Builds with BYTECOIN_CRYPTO_COUNTERS also
+// report the crypto operations per call of every handler.
+//
+//   bytecoin_cost_model [--format csv|json] [--cost FILE] [--print-cost]
+//                       [--scans N] [--keyimages N]
+//                       [--inputs N] [--mixins N] [--outputs N] [--extra N] [--addresses N]
+//                       [--batch]
+//
+// --batch packs the commands with host_tx_batch(), the batched handlers are
+// then reported under batch.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "os.h"
+#include "host_syscalls.h"
+#include "bytecoin_host.h"
+#include "bytecoin_host_cost.h"
+#include "bytecoin_host_tx.h"
+#include "bytecoin_ledger_api.h"
+#include "bytecoin_stats.h"
+
+typedef struct handler_stats_s
+{
+    uint64_t calls;
+    host_syscall_counters_t syscalls;
+    host_io_counters_t io;
+#ifdef BYTECOIN_CRYPTO_COUNTERS
+    uint64_t crypto_ops[CRYPTO_OP_COUNT];
+#endif
+} handler_stats_t;
+
+typedef struct profile_s
+{
+    const host_tx_apdus_t* apdus;
+    size_t next;
+    host_syscall_counters_t syscalls_before;
+    host_io_counters_t io_before;
+    handler_stats_t handlers[256];
+} profile_t;
+
+static
+size_t profile_next_command(void* ctx, uint8_t* buf, size_t size)
+{
+    profile_t* profile = ctx;
+    if (profile->next == profile->apdus->count)
+        return 0;
+    const host_apdu_t* apdu = &profile->apdus->items[profile->next++].apdu;
+    if (apdu->length > size)
+        return 0;
+    os_memmove(buf, apdu->data, apdu->length);
+    profile->syscalls_before = G_host_syscalls;
+    profile->io_before = G_host_io;
+    return apdu->length;
+}
+
+static
+void profile_on_response(void* ctx, const uint8_t* buf, size_t len)
+{
+    profile_t* profile = ctx;
+    const uint8_t ins = profile->apdus->items[profile->next - 1].apdu.data[1];
+    handler_stats_t* handler = &profile->handlers[ins];
+    handler->calls += 1;
+    for (int i = 0; i < HOST_SYSCALL_COUNT; ++i)
+        handler->syscalls.calls[i] += G_host_syscalls.calls[i] - profile->syscalls_before.calls[i];
+    handler->io.exchanges  += G_host_io.exchanges  - profile->io_before.exchanges;
+    handler->io.hid_frames += G_host_io.hid_frames - profile->io_before.hid_frames;
+    handler->io.bytes      += G_host_io.bytes      - profile->io_before.bytes;
+#ifdef BYTECOIN_CRYPTO_COUNTERS
+    for (int i = 0; i < CRYPTO_OP_COUNT; ++i)
+        handler->crypto_ops[i] += G_crypto_counters.current[i];
+#endif
+
+    const uint16_t sw = host_response_sw(buf, len);
+    if (!host_sw_ok(sw))
+    {
+        fprintf(stderr, "APDU #%zu (%s) failed with SW %04x\n", profile->next - 1, host_ins_name(ins), sw);
+        exit(1);
+    }
+}
+
+static
+void print_csv(const host_cost_model_t* model, const profile_t* profile, double total_us)
+{
+    printf("handler,calls,exchanges,hid_frames,bytes,syscalls,syscall_ms,io_ms,total_ms,ms_per_call,share");
+#ifdef BYTECOIN_CRYPTO_COUNTERS
+    for (int i = 0; i < CRYPTO_OP_COUNT; ++i)
+        printf(",%s_per_call", host_crypto_op_name(i));
+#endif
+    printf("\n");
+    for (int ins = 0; ins < 256; ++ins)
+    {
+        const handler_stats_t* handler = &profile->handlers[ins];
+        if (!handler->calls)
+            continue;
+        const double syscall_us = host_cost_syscalls_us(model, &handler->syscalls);
+        const double io_us = host_cost_io_us(model, &handler->io);
+        printf("%s,%llu,%llu,%llu,%llu,%llu,%.3f,%.3f,%.3f,%.3f,%.4f",
+               host_ins_name(ins), (unsigned long long)handler->calls,
+               (unsigned long long)handler->io.exchanges, (unsigned long long)handler->io.hid_frames,
+               (unsigned long long)handler->io.bytes, (unsigned long long)host_syscall_total(&handler->syscalls),
+               syscall_us / 1000, io_us / 1000, (syscall_us + io_us) / 1000,
+               (syscall_us + io_us) / 1000 / handler->calls, (syscall_us + io_us) / total_us);
+#ifdef BYTECOIN_CRYPTO_COUNTERS
+        for (int i = 0; i < CRYPTO_OP_COUNT; ++i)
+            printf(",%g", (double)handler->crypto_ops[i] / handler->calls);
+#endif
+        printf("\n");
+    }
+}
+
+static
+void print_json(const host_cost_model_t* model, const profile_t* profile, double total_us)
+{
+    printf("{\"total_ms\": %.3f, \"handlers\": [", total_us / 1000);
+    bool first = true;
+    for (int ins = 0; ins < 256; ++ins)
+    {
+        const handler_stats_t* handler = &profile->handlers[ins];
+        if (!handler->calls)
+            continue;
+        const double syscall_us = host_cost_syscalls_us(model, &handler->syscalls);
+        const double io_us = host_cost_io_us(model, &handler->io);
+        printf("%s\n    {\"handler\": \"%s\", \"calls\": %llu, \"exchanges\": %llu, \"hid_frames\": %llu, \"bytes\": %llu,\n",
+               first ? "" : ",", host_ins_name(ins), (unsigned long long)handler->calls,
+               (unsigned long long)handler->io.exchanges, (unsigned long long)handler->io.hid_frames,
+               (unsigned long long)handler->io.bytes);
+        printf("     \"syscall_ms\": %.3f, \"io_ms\": %.3f, \"total_ms\": %.3f, \"ms_per_call\": %.3f, \"share\": %.4f,\n",
+               syscall_us / 1000, io_us / 1000, (syscall_us + io_us) / 1000,
+               (syscall_us + io_us) / 1000 / handler->calls, (syscall_us + io_us) / total_us);
+        printf("     \"syscalls\": {");
+        bool first_syscall = true;
+        for (int i = 0; i < HOST_SYSCALL_COUNT; ++i)
+        {
+            const uint64_t calls = handler->syscalls.calls[i];
+            if (!calls)
+                continue;
+            printf("%s\"%s\": {\"calls\": %llu, \"ms\": %.3f}", first_syscall ? "" : ", ",
+                   host_syscall_name(i), (unsigned long long)calls, model->syscall_us[i] * calls / 1000);
+            first_syscall = false;
+        }
+        printf("}");
+#ifdef BYTECOIN_CRYPTO_COUNTERS
+        printf(",\n     \"crypto_ops_per_call\": {");
+        bool first_op = true;
+        for (int i = 0; i < CRYPTO_OP_COUNT; ++i)
+        {
+            if (!handler->crypto_ops[i])
+                continue;
+            printf("%s\"%s\": %g", first_op ? "" : ", ", host_crypto_op_name(i), (double)handler->crypto_ops[i] / handler->calls);
+            first_op = false;
+        }
+        printf("}");
+#endif
+        printf("}");
+        first = false;
+    }
+    printf("\n]}\n");
+}
+
+static
+void usage(const char* argv0)
+{
+    fprintf(stderr, "usage: %s [--format csv|json] [--cost FILE] [--print-cost] [--scans N] [--keyimages N]\n"
+                    "       [--inputs N] [--mixins N] [--outputs N] [--extra N] [--addresses N] [--batch]\n", argv0);
+    exit(2);
+}
+
+int main(int argc, char** argv)
+{
+    host_cost_model_t model;
+    host_cost_model_init(&model);
+    bool json = false;
+    bool batch = false;
+    uint32_t scans = 10;
+    uint32_t keyimages = 10;
+    host_tx_shape_t shape = { 2, 10, 2, 64, 1 };
+
+    for (int i = 1; i < argc; ++i)
+    {
+        if (!strcmp(argv[i], "--print-cost"))
+        {
+            host_cost_model_print(&model, stdout);
+            return 0;
+        }
+        if (!strcmp(argv[i], "--batch"))
+        {
+            batch = true;
+            continue;
+        }
+        if (i + 1 == argc)
+            usage(argv[0]);
+        const char* value = argv[++i];
+        if (!strcmp(argv[i - 1], "--format"))
+        {
+            if (!strcmp(value, "json"))
+                json = true;
+            else if (strcmp(value, "csv"))
+                usage(argv[0]);
+        }
+        else if (!strcmp(argv[i - 1], "--cost"))
+        {
+            if (!host_cost_model_load(&model, value))
+                return 1;
+        }
+        else if (!strcmp(argv[i - 1], "--scans"))
+            scans = strtoul(value, NULL, 10);
+        else if (!strcmp(argv[i - 1], "--keyimages"))
+            keyimages = strtoul(value, NULL, 10);
+        else if (!strcmp(argv[i - 1], "--inputs"))
+            shape.inputs = strtoul(value, NULL, 10);
+        else if (!strcmp(argv[i - 1], "--mixins"))
+            shape.mixins = strtoul(value, NULL, 10);
+        else if (!strcmp(argv[i - 1], "--outputs"))
+            shape.outputs = strtoul(value, NULL, 10);
+        else if (!strcmp(argv[i - 1], "--extra"))
+            shape.extra_size = strtoul(value, NULL, 10);
+        else if (!strcmp(argv[i - 1], "--addresses"))
+            shape.addresses = strtoul(value, NULL, 10);
+        else
+            usage(argv[0]);
+    }
+
+    host_tx_apdus_t apdus = { 0 };
+    host_tx_generate_sync(scans, keyimages, shape.addresses, &apdus);
+    host_tx_generate(&shape, &apdus);
+    if (batch)
+    {
+        host_tx_apdus_t batched = { 0 };
+        host_tx_batch(&apdus, &batched);
+        host_tx_apdus_free(&apdus);
+        apdus = batched;
+    }
+
+    static profile_t profile;
+    profile.apdus = &apdus;
+    const bytecoin_host_transport_t transport = { profile_next_command, profile_on_response, &profile };
+    bytecoin_host_init();
+    bytecoin_host_run(&transport);
+    host_tx_apdus_free(&apdus);
+
+    double total_us = 0;
+    for (int ins = 0; ins < 256; ++ins)
+        total_us += host_cost_syscalls_us(&model, &profile.handlers[ins].syscalls) + host_cost_io_us(&model, &profile.handlers[ins].io);
+
+    if (json)
+        print_json(&model, &profile, total_us);
+    else
+        print_csv(&model, &profile, total_us);
+    return 0;
+}
@@ -0,0 +1,234 @@
+/*******************************************************************************
+*   Bytecoin Wallet for Ledger Nano S
+*   (c) 2018 - 2019 The Bytecoin developers
+*
+*  Licensed under the Apache License, Version 2.0 (the "License");
+*  you may not use this file except in compliance with the License.
+*  You may obtain a copy of the License at
+*
+*      http://www.apache.org/licenses/LICENSE-2.0
+*
+*  Unless required by applicable law or agreed to in writing, software
+*  distributed under the License is distributed on an "AS IS" BASIS,
+*  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+*  See the License for the specific language governing permissions and
+*  limitations under the License.
+********************************************************************************/
+
+// Load test: signs the same synthetic transaction on many independent
+// emulated wallets spread over worker threads, all in this process. Every
+// device gets its own seed; the responses of each session are checked against
+// a single-threaded run of the same device.
+//
+//   bytecoin_farm [--threads N] [--devices N] [--sessions N]
+//                 [--inputs N] [--mixins N] [--outputs N] [--extra N] [--addresses N]
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+#include "os.h"
+#include "bytecoin_host.h"
+#include "bytecoin_host_tx.h"
+#include "bytecoin_ledger_api.h"
+
+typedef struct farm_s
+{
+    const host_tx_apdus_t* apdus;
+    bytecoin_host_device_t* devices;
+    uint64_t* expected; // digest of the responses of every device
+    uint32_t devices_num;
+    uint32_t threads_num;
+    uint32_t sessions;
+} farm_t;
+
+typedef struct worker_s
+{
+    farm_t* farm;
+    pthread_t thread;
+    uint32_t index;
+    uint32_t mismatches;
+    uint32_t failures;
+} worker_t;
+
+typedef struct session_s
+{
+    const host_tx_apdus_t* apdus;
+    size_t next;
+    uint64_t digest;
+    uint32_t failures;
+} session_t;
+
+static
+uint64_t now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+}
+
+static
+size_t session_next_command(void* ctx, uint8_t* buf, size_t size)
+{
+    session_t* session = ctx;
+    if (session->next == session->apdus->count)
+        return 0;
+    const host_apdu_t* apdu = &session->apdus->items[session->next++].apdu;
+    if (apdu->length > size)
+        return 0;
+    os_memmove(buf, apdu->data, apdu->length);
+    return apdu->length;
+}
+
+// FNV-1a over all responses
+static
+void session_on_response(void* ctx, const uint8_t* buf, size_t len)
+{
+    session_t* session = ctx;
+    for (size_t i = 0; i < len; ++i)
+        session->digest = (session->digest ^ buf[i]) * 0x100000001b3ULL;
+    if (!host_sw_ok(host_response_sw(buf, len)))
+        session->failures += 1;
+}
+
+static
+void device_seed(uint32_t index, uint8_t seed[32])
+{
+    static const char base[] = "bytecoin host seed";
+    os_memset(seed, 0, 32);
+    os_memmove(seed, base, sizeof(base) - 1);
+    for (int i = 0; i < 4; ++i)
+        seed[28 + i] = (uint8_t)(index >> (8 * i));
+}
+
+static
+uint64_t sign(bytecoin_host_device_t* device, const host_tx_apdus_t* apdus, uint32_t* failures)
+{
+    session_t session = { apdus, 0, 0xcbf29ce484222325ULL, 0 };
+    const bytecoin_host_transport_t transport = { session_next_command, session_on_response, &session };
+    bytecoin_host_device_run(device, &transport);
+    *failures += session.failures + (session.next != apdus->count);
+    return session.digest;
+}
+
+// devices are dealt round robin, a worker interleaves its devices session by session
+static
+void* worker_run(void* arg)
+{
+    worker_t* worker = arg;
+    farm_t* farm = worker->farm;
+    uint8_t seed[32];
+    for (uint32_t d = worker->index; d < farm->devices_num; d += farm->threads_num)
+    {
+        device_seed(d, seed);
+        bytecoin_host_device_init(&farm->devices[d], seed);
+    }
+    for (uint32_t s = 0; s < farm->sessions; ++s)
+        for (uint32_t d = worker->index; d < farm->devices_num; d += farm->threads_num)
+            if (sign(&farm->devices[d], farm->apdus, &worker->failures) != farm->expected[d])
+                worker->mismatches += 1;
+    return NULL;
+}
+
+static
+void usage(const char* argv0)
+{
+    fprintf(stderr, "usage: %s [--threads N] [--devices N] [--sessions N] [--inputs N] [--mixins N] [--outputs N] [--extra N] [--addresses N]\n", argv0);
+    exit(2);
+}
+
+int main(int argc, char** argv)
+{
+    uint32_t threads_num = 4;
+    uint32_t devices_num = 64;
+    uint32_t sessions = 1;
+    host_tx_shape_t shape = { 2, 3, 2, 64, 1 };
+
+    for (int i = 1; i < argc; ++i)
+    {
+        if (i + 1 == argc)
+            usage(argv[0]);
+        const uint32_t value = strtoul(argv[i + 1], NULL, 10);
+        if (!strcmp(argv[i], "--threads"))
+            threads_num = value;
+        else if (!strcmp(argv[i], "--devices"))
+            devices_num = value;
+        else if (!strcmp(argv[i], "--sessions"))
+            sessions = value;
+        else if (!strcmp(argv[i], "--inputs"))
+            shape.inputs = value;
+        else if (!strcmp(argv[i], "--mixins"))
+            shape.mixins = value;
+        else if (!strcmp(argv[i], "--outputs"))
+            shape.outputs = value;
+        else if (!strcmp(argv[i], "--extra"))
+            shape.extra_size = value;
+        else if (!strcmp(argv[i], "--addresses"))
+            shape.addresses = value;
+        else
+            usage(argv[0]);
+        ++i;
+    }
+    if (!threads_num || !devices_num || !shape.inputs)
+        usage(argv[0]);
+
+    host_tx_apdus_t apdus = { 0 };
+    host_tx_generate(&shape, &apdus);
+
+    farm_t farm = { &apdus, NULL, NULL, devices_num, threads_num, sessions };
+    farm.devices = calloc(devices_num, sizeof(bytecoin_host_device_t));
+    farm.expected = calloc(devices_num, sizeof(uint64_t));
+    worker_t* workers = calloc(threads_num, sizeof(worker_t));
+    if (!farm.devices || !farm.expected || !workers)
+    {
+        fprintf(stderr, "out of memory\n");
+        return 1;
+    }
+
+    // the reference: one device after the other on this thread
+    uint32_t failures = 0;
+    uint8_t seed[32];
+    const uint64_t reference_started = now_ns();
+    for (uint32_t d = 0; d < devices_num; ++d)
+    {
+        device_seed(d, seed);
+        bytecoin_host_device_init(&farm.devices[d], seed);
+        farm.expected[d] = sign(&farm.devices[d], &apdus, &failures);
+    }
+    const uint64_t reference_ns = now_ns() - reference_started;
+
+    const uint64_t farm_started = now_ns();
+    for (uint32_t t = 0; t < threads_num; ++t)
+    {
+        workers[t].farm = &farm;
+        workers[t].index = t;
+        if (pthread_create(&workers[t].thread, NULL, worker_run, &workers[t]))
+        {
+            fprintf(stderr, "cannot start thread %u\n", t);
+            return 1;
+        }
+    }
+    uint32_t mismatches = 0;
+    for (uint32_t t = 0; t < threads_num; ++t)
+    {
+        pthread_join(workers[t].thread, NULL);
+        mismatches += workers[t].mismatches;
+        failures += workers[t].failures;
+    }
+    const uint64_t farm_ns = now_ns() - farm_started;
+
+    const uint64_t signed_txs = (uint64_t)devices_num * sessions;
+    printf("devices %u, threads %u, sessions per device %u, APDUs per session %zu\n",
+           devices_num, threads_num, sessions, apdus.count);
+    printf("single thread: %.3f ms per session\n", reference_ns / 1e6 / devices_num);
+    printf("farm: %.1f sessions/s, %.2fx the single thread\n",
+           signed_txs * 1e9 / farm_ns, (double)reference_ns * sessions / farm_ns);
+    printf("failed sessions %u, sessions differing from the reference %u\n", failures, mismatches);
+
+    host_tx_apdus_free(&apdus);
+    free(workers);
+    free(farm.expected);
+    free(farm.devices);
+    return failures || mismatches ? 1 : 0;
+}
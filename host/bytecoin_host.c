@@ -0,0 +1,394 @@
+/*******************************************************************************
+*   Bytecoin Wallet for Ledger Nano S
+*   (c) 2018 - 2019 The Bytecoin developers
+*
+*  Licensed under the Apache License, Version 2.0 (the "License");
+*  you may not use this file except in compliance with the License.
+*  You may obtain a copy of the License at
+*
+*      http://www.apache.org/licenses/LICENSE-2.0
+*
+*  Unless required by applicable law or agreed to in writing, software
+*  distributed under the License is distributed on an "AS IS" BASIS,
+*  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+*  See the License for the specific language governing permissions and
+*  limitations under the License.
+********************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "os.h"
+#include "bytecoin_host.h"
+#include "bytecoin_vars.h"
+#include "bytecoin_dispatch.h"
+#include "bytecoin_ledger_api.h"
+#include "bytecoin_stats.h"
+
+// HID report: channel (2), tag (1), sequence (2), the first one also carries the APDU length (2)
+#define HID_REPORT_SIZE         64
+#define HID_FIRST_PAYLOAD_SIZE  (HID_REPORT_SIZE - 7)
+#define HID_NEXT_PAYLOAD_SIZE   (HID_REPORT_SIZE - 5)
+
+__thread host_io_counters_t G_host_io;
+
+bytecoin_host_device_t G_host_device;
+
+// the device whose main loop runs on the thread, io_exchange works on it
+static __thread bytecoin_host_device_t* G_running_device;
+
+size_t host_hid_frames(size_t apdu_len)
+{
+    if (apdu_len <= HID_FIRST_PAYLOAD_SIZE)
+        return 1;
+    return 1 + (apdu_len - HID_FIRST_PAYLOAD_SIZE + HID_NEXT_PAYLOAD_SIZE - 1) / HID_NEXT_PAYLOAD_SIZE;
+}
+
+const char* host_ins_name(uint8_t ins)
+{
+    switch (ins)
+    {
+    case INS_RESET:                 return "reset";
+    case INS_GET_APP_INFO:          return "get_ledger_app_info";
+    case INS_GET_WALLET_KEYS:       return "get_wallet_keys";
+    case INS_SCAN_OUTPUTS:          return "scan_outputs";
+    case INS_GENERATE_KEYIMAGE:     return "generate_keyimage";
+    case INS_GENERATE_OUTPUT_SEED:  return "generate_output_seed";
+    case INS_EXPORT_VIEW_ONLY:      return "export_view_only";
+    case INS_SIG_START:             return "sig_start";
+    case INS_SIG_ADD_INPUT_START:   return "sig_add_input_start";
+    case INS_SIG_ADD_INPUT_INDEXES: return "sig_add_input_indexes";
+    case INS_SIG_ADD_INPUT_FINISH:  return "sig_add_input_finish";
+    case INS_SIG_ADD_INPUT:         return "sig_add_input";
+    case INS_SIG_ADD_INPUT_VARINTS: return "sig_add_input_varints";
+    case INS_SIG_ADD_OUPUT:         return "sig_add_output";
+    case INS_SIG_ADD_OUTPUTS:       return "sig_add_outputs";
+    case INS_SIG_ADD_EXTRA:         return "sig_add_extra";
+    case INS_SIG_PREFIX:            return "sig_prefix";
+    case INS_SIG_STEP_A:            return "sig_step_a";
+    case INS_SIG_STEP_A_MORE_DATA:  return "sig_step_a_more_data";
+    case INS_SIG_STEP_A_INPUTS:     return "sig_step_a_inputs";
+    case INS_SIG_GET_C0:            return "sig_get_c0";
+    case INS_SIG_STEP_B:            return "sig_step_b";
+    case INS_SIG_STEP_B_INPUTS:     return "sig_step_b_inputs";
+    case INS_SIG_STEP_A_TOKEN:      return "sig_step_a_token";
+    case INS_SIG_STEP_B_TOKEN:      return "sig_step_b_token";
+    case INS_SIG_PROOF_START:       return "sig_proof_start";
+    case INS_GET_STATS:             return "get_stats";
+    case INS_GET_CRYPTO_COUNTERS:   return "get_crypto_counters";
+    case INS_GET_RESPONSE:          return "get_response";
+    case INS_BATCH:                 return "batch";
+    case INS_GET_LAST_RESPONSE:     return "get_last_response";
+    default:                        return "unknown";
+    }
+}
+
+#ifdef BYTECOIN_CRYPTO_COUNTERS
+const char* host_crypto_op_name(int op)
+{
+    static const char* const names[CRYPTO_OP_COUNT] = {
+        [CRYPTO_OP_DECOMPRESS_POINT]     = "decompress_point",
+        [CRYPTO_OP_COMPRESS_POINT]       = "compress_point",
+        [CRYPTO_OP_ECMUL]                = "ecmul",
+        [CRYPTO_OP_D_ECMUL]              = "d_ecmul",
+        [CRYPTO_OP_ECADD]                = "ecadd",
+        [CRYPTO_OP_D_ECADD]              = "d_ecadd",
+        [CRYPTO_OP_ECSUB]                = "ecsub",
+        [CRYPTO_OP_ECMUL_8]              = "ecmul_8",
+        [CRYPTO_OP_INVERT32]             = "invert32",
+        [CRYPTO_OP_REDUCE32]             = "reduce32",
+        [CRYPTO_OP_REDUCE64]             = "reduce64",
+        [CRYPTO_OP_GE_FROMFE_FROMBYTES]  = "ge_fromfe_frombytes",
+        [CRYPTO_OP_FE_MATH]              = "fe_math",
+        [CRYPTO_OP_KECCAK_PERMUTATION]   = "keccak_permutation",
+    };
+    return op >= 0 && op < CRYPTO_OP_COUNT ? names[op] : "unknown";
+}
+#endif
+
+void bytecoin_host_device_init(bytecoin_host_device_t* device, const uint8_t seed[32])
+{
+    os_memset(device, 0, sizeof(bytecoin_host_device_t));
+    if (seed)
+        os_host_set_seed(seed);
+    init_vstate(&device->state, device->io_apdu_buffer);
+}
+
+bytecoin_host_device_t* bytecoin_host_device_of(bytecoin_v_state_t* state)
+{
+    return (bytecoin_host_device_t*)((uint8_t*)state - offsetof(bytecoin_host_device_t, state));
+}
+
+void bytecoin_host_init(void)
+{
+    bytecoin_host_device_init(&G_host_device, NULL);
+}
+
+unsigned short io_exchange(unsigned char channel_and_flags, unsigned short tx_len)
+{
+    bytecoin_host_device_t* device = G_running_device;
+    if (!device)
+    {
+        fprintf(stderr, "io_exchange called outside of bytecoin_host_device_run\n");
+        abort();
+    }
+    const bytecoin_host_transport_t* transport = device->transport;
+    if (tx_len)
+    {
+        G_host_io.hid_frames += host_hid_frames(tx_len);
+        G_host_io.bytes += tx_len;
+        transport->on_response(transport->ctx, device->io_apdu_buffer, tx_len);
+    }
+    if (channel_and_flags & IO_RETURN_AFTER_TX)
+        return 0;
+    if (channel_and_flags & IO_ASYNCH_REPLY)
+        bytecoin_host_ui_process(device);
+
+    os_memset(device->io_apdu_buffer, 0, sizeof(io_call_params_t));
+    const size_t rx = transport->next_command(transport->ctx, device->io_apdu_buffer, sizeof(device->io_apdu_buffer));
+    if (rx == 0)
+        longjmp(device->exit, 1);
+    G_host_io.exchanges += 1;
+    G_host_io.hid_frames += host_hid_frames(rx);
+    G_host_io.bytes += rx;
+    return rx;
+}
+
+void bytecoin_host_device_run(bytecoin_host_device_t* device, const bytecoin_host_transport_t* transport)
+{
+    if (G_running_device)
+    {
+        fprintf(stderr, "a device already runs on this thread\n");
+        abort();
+    }
+    device->transport = transport;
+    G_running_device = device;
+#ifdef BYTECOIN_CRYPTO_COUNTERS
+    G_crypto_counters = device->crypto_counters;
+#endif
+    // the response to the last command has been delivered already
+    reset_io_buffer(&device->state.io_buffer);
+    if (!setjmp(device->exit))
+        bytecoin_main(&device->state);
+    try_context_set(NULL);
+#ifdef BYTECOIN_CRYPTO_COUNTERS
+    device->crypto_counters = G_crypto_counters;
+#endif
+    G_running_device = NULL;
+    device->transport = NULL;
+}
+
+void bytecoin_host_run(const bytecoin_host_transport_t* transport)
+{
+    bytecoin_host_device_run(&G_host_device, transport);
+}
+
+typedef struct single_exchange_s
+{
+    const uint8_t* cmd;
+    size_t cmd_len;
+    uint8_t* resp;
+    size_t resp_size;
+    size_t resp_len;
+} single_exchange_t;
+
+static
+size_t single_next_command(void* ctx, uint8_t* buf, size_t size)
+{
+    single_exchange_t* ex = ctx;
+    const size_t len = ex->cmd_len;
+    if (!len || len > size)
+        return 0;
+    os_memmove(buf, ex->cmd, len);
+    ex->cmd_len = 0;
+    return len;
+}
+
+static
+void single_on_response(void* ctx, const uint8_t* buf, size_t len)
+{
+    single_exchange_t* ex = ctx;
+    ex->resp_len = len < ex->resp_size ? len : ex->resp_size;
+    os_memmove(ex->resp, buf, ex->resp_len);
+}
+
+size_t bytecoin_host_device_exchange(bytecoin_host_device_t* device, const uint8_t* cmd, size_t cmd_len, uint8_t* resp, size_t resp_size)
+{
+    single_exchange_t ex = { cmd, cmd_len, resp, resp_size, 0 };
+    const bytecoin_host_transport_t transport = { single_next_command, single_on_response, &ex };
+    bytecoin_host_device_run(device, &transport);
+    return ex.resp_len;
+}
+
+size_t bytecoin_host_exchange(const uint8_t* cmd, size_t cmd_len, uint8_t* resp, size_t resp_size)
+{
+    return bytecoin_host_device_exchange(&G_host_device, cmd, cmd_len, resp, resp_size);
+}
+
+void host_apdu_begin(host_apdu_t* apdu, uint8_t ins, uint8_t p1, uint8_t p2)
+{
+    apdu->data[0] = BYTECOIN_CLA;
+    apdu->data[1] = ins;
+    apdu->data[2] = p1;
+    apdu->data[3] = p2;
+    apdu->data[4] = 0;
+    apdu->length = 5;
+}
+
+static
+uint8_t* host_apdu_reserve(host_apdu_t* apdu, size_t len)
+{
+    if (apdu->length + len > sizeof(apdu->data))
+    {
+        fprintf(stderr, "APDU 0x%02x is too long\n", apdu->data[1]);
+        abort();
+    }
+    uint8_t* p = apdu->data + apdu->length;
+    apdu->length += len;
+    apdu->data[4] = (uint8_t)(apdu->length - 5);
+    return p;
+}
+
+void host_apdu_put_var(host_apdu_t* apdu, uint64_t var, size_t len)
+{
+    uint8_t* p = host_apdu_reserve(apdu, len);
+    for (size_t i = 0; i < len; ++i)
+        p[i] = (uint8_t)(var >> ((len - i - 1) * 8));
+}
+
+void host_apdu_put_bytes(host_apdu_t* apdu, const void* buf, size_t len)
+{
+    os_memmove(host_apdu_reserve(apdu, len), buf, len);
+}
+
+void host_apdu_put_point(host_apdu_t* apdu, const elliptic_curve_point_t* P)
+{
+    host_apdu_put_bytes(apdu, P->data, sizeof(P->data));
+}
+
+void host_apdu_put_scalar(host_apdu_t* apdu, const elliptic_curve_scalar_t* s)
+{
+    reverse(host_apdu_reserve(apdu, sizeof(s->data)), s->data, sizeof(s->data));
+}
+
+static
+void put_U8(host_apdu_t* apdu, uint8_t field, size_t max)
+{
+    host_apdu_put_var(apdu, field, sizeof(field));
+}
+
+static
+void put_U32(host_apdu_t* apdu, uint32_t field, size_t max)
+{
+    host_apdu_put_var(apdu, field, sizeof(field));
+}
+
+static
+void put_U64(host_apdu_t* apdu, uint64_t field, size_t max)
+{
+    host_apdu_put_var(apdu, field, sizeof(field));
+}
+
+static
+void put_HASH(host_apdu_t* apdu, const hash_t* field, size_t max)
+{
+    host_apdu_put_bytes(apdu, field->data, sizeof(field->data));
+}
+
+static
+void put_POINT(host_apdu_t* apdu, const elliptic_curve_point_t* field, size_t max)
+{
+    host_apdu_put_point(apdu, field);
+}
+
+static
+void put_SCALAR(host_apdu_t* apdu, const elliptic_curve_scalar_t* field, size_t max)
+{
+    host_apdu_put_scalar(apdu, field);
+}
+
+static
+void put_count(host_apdu_t* apdu, size_t count, size_t max)
+{
+    if (count > max)
+    {
+        fprintf(stderr, "APDU 0x%02x: %zu items, at most %zu fit\n", apdu->data[1], count, max);
+        abort();
+    }
+    host_apdu_put_var(apdu, count, 1);
+}
+
+static
+void put_BYTES(host_apdu_t* apdu, bytecoin_bytes_t field, size_t max)
+{
+    put_count(apdu, field.length, max);
+    host_apdu_put_bytes(apdu, field.data, field.length);
+}
+
+static
+void put_POINTS(host_apdu_t* apdu, bytecoin_points_t field, size_t max)
+{
+    put_count(apdu, field.count, max);
+    host_apdu_put_bytes(apdu, field.items, field.count * sizeof(field.items[0]));
+}
+
+static
+void put_U32S(host_apdu_t* apdu, bytecoin_u32s_t field, size_t max)
+{
+    put_count(apdu, field.count, max);
+    host_apdu_put_bytes(apdu, field.data, 4 * field.count);
+}
+
+static
+void put_VARINTS(host_apdu_t* apdu, bytecoin_varints_t field, size_t max)
+{
+    put_count(apdu, field.count, max);
+    host_apdu_put_bytes(apdu, field.data, field.length);
+}
+
+#define PUT_FIELD(type, name, max) put_##type(apdu, cmd->name, max);
+
+#define DEFINE_ENCODER(name, ins, fields, states) \
+void host_apdu_encode_##name(host_apdu_t* apdu, const bytecoin_##name##_cmd_t* cmd) \
+{ \
+    host_apdu_begin(apdu, ins, 0, 0); \
+    fields(PUT_FIELD) \
+}
+BYTECOIN_APDU_COMMANDS(DEFINE_ENCODER)
+
+#define DEFINE_EMPTY_ENCODER(name, ins, states) \
+void host_apdu_encode_##name(host_apdu_t* apdu) \
+{ \
+    host_apdu_begin(apdu, ins, 0, 0); \
+}
+BYTECOIN_APDU_EMPTY_COMMANDS(DEFINE_EMPTY_ENCODER)
+
+uint16_t host_response_sw(const uint8_t* resp, size_t len)
+{
+    if (len < 2)
+        return 0;
+    return (uint16_t)((resp[len - 2] << 8) | resp[len - 1]);
+}
+
+bool host_sw_ok(uint16_t sw)
+{
+    return sw == SW_NO_ERROR || (sw & 0xFF00) == SW_BYTES_REMAINING_00;
+}
+
+int host_batch_parse(const uint8_t* resp, size_t len, host_batch_item_t* items, size_t max_items)
+{
+    if (host_response_sw(resp, len) != SW_NO_ERROR)
+        return -1;
+    len -= 2;
+    size_t count = 0;
+    for (size_t pos = 0; pos < len; ++count)
+    {
+        if (count == max_items || len - pos < 3 || len - pos - 3 < resp[pos])
+            return -1;
+        items[count].data = resp + pos + 1;
+        items[count].length = resp[pos];
+        pos += 1 + resp[pos];
+        items[count].sw = (uint16_t)((resp[pos] << 8) | resp[pos + 1]);
+        pos += 2;
+    }
+    return (int)count;
+}
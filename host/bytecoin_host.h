@@ -0,0 +1,178 @@
+/*******************************************************************************
+*   Bytecoin Wallet for Ledger Nano S
+*   (c) 2018 - 2019 The Bytecoin developers
+*
+*  Licensed under the Apache License, Version 2.0 (the "License");
+*  you may not use this file except in compliance with the License.
+*  You may obtain a copy of the License at
+*
+*      http://www.apache.org/licenses/LICENSE-2.0
+*
+*  Unless required by applicable law or agreed to in writing, software
+*  distributed under the License is distributed on an "AS IS" BASIS,
+*  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+*  See the License for the specific language governing permissions and
+*  limitations under the License.
+********************************************************************************/
+
+#ifndef BYTECOIN_HOST_H
+#define BYTECOIN_HOST_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include <setjmp.h>
+#include "os.h"
+#include "bytecoin_crypto.h"
+#include "bytecoin_vars.h"
+#include "bytecoin_stats.h"
+#include "bytecoin_apdu_schema.h"
+
+// Feeds command APDUs to the emulated device and collects its responses.
+typedef struct bytecoin_host_transport_s
+{
+    // writes the next command APDU to buf and returns its length,
+    // returns 0 when there are no more commands
+    size_t (*next_command)(void* ctx, uint8_t* buf, size_t size);
+    // called with every response APDU: data followed by the status word
+    void (*on_response)(void* ctx, const uint8_t* buf, size_t len);
+    void* ctx;
+} bytecoin_host_transport_t;
+
+#define HOST_UI_MAX_STEPS 16
+#define HOST_UI_MAX_LINES 3
+
+typedef enum host_ui_action_e
+{
+    HOST_UI_APPROVE = 0,
+    HOST_UI_REJECT,
+} host_ui_action_t;
+
+// what the emulated user presses on a confirmation screen, and after how long
+typedef struct host_ui_step_s
+{
+    host_ui_action_t action;
+    uint32_t delay_ms;
+} host_ui_step_t;
+
+// a confirmation screen as the user saw it
+typedef struct host_ui_screen_s
+{
+    const char* name;
+    char lines[HOST_UI_MAX_LINES][BYTECOIN_ADDRESS_LENGTH + 32]; // "label: value"
+    size_t lines_count;
+    host_ui_step_t step;
+    uint64_t render_ns; // formatting the text, as the preprocessors of bytecoin_ui.c do
+} host_ui_screen_t;
+
+// The emulated user of a device. The steps are taken one per confirmation
+// and the last one repeats; without steps every confirmation is approved
+// at once. on_screen, if set, receives every screen once it is decided.
+typedef struct host_ui_s
+{
+    int pending; // what bytecoin_host_ui.c displays
+    host_ui_step_t steps[HOST_UI_MAX_STEPS];
+    size_t steps_count;
+    size_t next_step;
+    void (*on_screen)(void* ctx, const host_ui_screen_t* screen);
+    void* ctx;
+} host_ui_t;
+
+// parses steps like "approve", "reject:250" or "approve:1000,reject" (delays
+// in ms), returns false if the script is malformed
+bool host_ui_set_script(host_ui_t* ui, const char* script);
+
+// One emulated wallet. Devices share nothing, a thread runs one device at a
+// time and any number of threads may run devices concurrently.
+typedef struct bytecoin_host_device_s
+{
+    bytecoin_v_state_t state;
+    uint8_t io_apdu_buffer[IO_APDU_BUFFER_SIZE];
+    host_ui_t ui; // set after bytecoin_host_device_init()
+    const bytecoin_host_transport_t* transport;
+    jmp_buf exit;
+#ifdef BYTECOIN_CRYPTO_COUNTERS
+    // G_crypto_counters of the thread while the device does not run
+    bytecoin_crypto_counters_t crypto_counters;
+#endif
+} bytecoin_host_device_t;
+
+// USB traffic of the emulated devices of the calling thread, counted by io_exchange
+typedef struct host_io_counters_s
+{
+    uint64_t exchanges;  // command APDUs received, including GET RESPONSE
+    uint64_t hid_frames; // 64-byte HID reports in both directions
+    uint64_t bytes;      // APDU bytes in both directions
+} host_io_counters_t;
+
+extern __thread host_io_counters_t G_host_io;
+
+// number of 64-byte HID reports carrying an APDU of the given length
+size_t host_hid_frames(size_t apdu_len);
+
+// name of the bytecoin_apdu.c handler of the instruction
+const char* host_ins_name(uint8_t ins);
+
+#ifdef BYTECOIN_CRYPTO_COUNTERS
+const char* host_crypto_op_name(int op);
+#endif
+
+// derives the wallet of the device from seed, NULL keeps the seed of the thread
+void bytecoin_host_device_init(bytecoin_host_device_t* device, const uint8_t seed[32]);
+
+// runs the app main loop of the device until the transport has no more commands
+void bytecoin_host_device_run(bytecoin_host_device_t* device, const bytecoin_host_transport_t* transport);
+
+// sends one command APDU and returns the length of the response copied to resp
+size_t bytecoin_host_device_exchange(bytecoin_host_device_t* device, const uint8_t* cmd, size_t cmd_len, uint8_t* resp, size_t resp_size);
+
+bytecoin_host_device_t* bytecoin_host_device_of(bytecoin_v_state_t* state);
+
+// the device of the single-wallet tools
+extern bytecoin_host_device_t G_host_device;
+
+void bytecoin_host_init(void);
+void bytecoin_host_run(const bytecoin_host_transport_t* transport);
+size_t bytecoin_host_exchange(const uint8_t* cmd, size_t cmd_len, uint8_t* resp, size_t resp_size);
+
+// called when the app of device waits for the user, see bytecoin_host_ui.c
+void bytecoin_host_ui_process(bytecoin_host_device_t* device);
+
+typedef struct host_apdu_s
+{
+    uint8_t data[5 + 255];
+    size_t length;
+} host_apdu_t;
+
+void host_apdu_begin(host_apdu_t* apdu, uint8_t ins, uint8_t p1, uint8_t p2);
+void host_apdu_put_var(host_apdu_t* apdu, uint64_t var, size_t len);
+void host_apdu_put_bytes(host_apdu_t* apdu, const void* buf, size_t len);
+void host_apdu_put_point(host_apdu_t* apdu, const elliptic_curve_point_t* P);
+void host_apdu_put_scalar(host_apdu_t* apdu, const elliptic_curve_scalar_t* s);
+
+// host_apdu_encode_<name>() of every command of bytecoin_apdu_schema.h, the
+// fields are written the way bytecoin_parse_<name>() reads them
+#define HOST_APDU_ENCODER_DECLARE(name, ins, fields, states) \
+    void host_apdu_encode_##name(host_apdu_t* apdu, const bytecoin_##name##_cmd_t* cmd);
+BYTECOIN_APDU_COMMANDS(HOST_APDU_ENCODER_DECLARE)
+
+#define HOST_APDU_EMPTY_ENCODER_DECLARE(name, ins, states) \
+    void host_apdu_encode_##name(host_apdu_t* apdu);
+BYTECOIN_APDU_EMPTY_COMMANDS(HOST_APDU_EMPTY_ENCODER_DECLARE)
+
+uint16_t host_response_sw(const uint8_t* resp, size_t len);
+// SW_NO_ERROR, or 61xx when the rest of the response follows INS_GET_RESPONSE
+bool host_sw_ok(uint16_t sw);
+
+typedef struct host_batch_item_s
+{
+    const uint8_t* data;
+    size_t length;
+    uint16_t sw;
+} host_batch_item_t;
+
+// splits the response of INS_BATCH into its items, returns their number or -1
+// if the response is malformed
+int host_batch_parse(const uint8_t* resp, size_t len, host_batch_item_t* items, size_t max_items);
+
+#endif // BYTECOIN_HOST_H
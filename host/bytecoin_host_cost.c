@@ -0,0 +1,115 @@
+/*******************************************************************************
+*   Bytecoin Wallet for Ledger Nano S
+*   (c) 2018 - 2019 The Bytecoin developers
+*
+*  Licensed under the Apache License, Version 2.0 (the "License");
+*  you may not use this file except in compliance with the License.
+*  You may obtain a copy of the License at
+*
+*      http://www.apache.org/licenses/LICENSE-2.0
+*
+*  Unless required by applicable law or agreed to in writing, software
+*  distributed under the License is distributed on an "AS IS" BASIS,
+*  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+*  See the License for the specific language governing permissions and
+*  limitations under the License.
+********************************************************************************/
+
+#include <stdlib.h>
+#include <string.h>
+#include "bytecoin_host_cost.h"
+
+#define HID_FRAME_NAME "hid_frame"
+#define EXCHANGE_NAME  "exchange"
+
+void host_cost_model_init(host_cost_model_t* model)
+{
+    static const double syscall_us[HOST_SYSCALL_COUNT] = {
+        [HOST_SYSCALL_ECFP_ADD_POINT]          = 1200,
+        [HOST_SYSCALL_ECFP_SCALAR_MULT]        = 22000,
+        [HOST_SYSCALL_EDWARD_COMPRESS_POINT]   = 700,
+        [HOST_SYSCALL_EDWARD_DECOMPRESS_POINT] = 3500,
+        [HOST_SYSCALL_MATH_ADDM]               = 90,
+        [HOST_SYSCALL_MATH_SUBM]               = 90,
+        [HOST_SYSCALL_MATH_MULTM]              = 150,
+        [HOST_SYSCALL_MATH_MODM]               = 130,
+        [HOST_SYSCALL_MATH_POWM]               = 3000,
+        [HOST_SYSCALL_MATH_INVPRIMEM]          = 3000,
+        [HOST_SYSCALL_MATH_IS_ZERO]            = 40,
+        [HOST_SYSCALL_RNG]                     = 150,
+        [HOST_SYSCALL_DERIVE_NODE_BIP32]       = 60000,
+    };
+    memcpy(model->syscall_us, syscall_us, sizeof(syscall_us));
+    model->hid_frame_us = 1000;
+    model->exchange_us = 1500;
+}
+
+static
+double* find_cost(host_cost_model_t* model, const char* name)
+{
+    if (!strcmp(name, HID_FRAME_NAME))
+        return &model->hid_frame_us;
+    if (!strcmp(name, EXCHANGE_NAME))
+        return &model->exchange_us;
+    for (int i = 0; i < HOST_SYSCALL_COUNT; ++i)
+        if (!strcmp(name, host_syscall_name(i)))
+            return &model->syscall_us[i];
+    return NULL;
+}
+
+bool host_cost_model_load(host_cost_model_t* model, const char* path)
+{
+    FILE* file = fopen(path, "r");
+    if (!file)
+    {
+        perror(path);
+        return false;
+    }
+    char line[256];
+    unsigned line_number = 0;
+    bool ok = true;
+    while (ok && fgets(line, sizeof(line), file))
+    {
+        ++line_number;
+        char* comment = strchr(line, '#');
+        if (comment)
+            *comment = 0;
+        char name[64];
+        double value;
+        const int fields = sscanf(line, "%63s %lf", name, &value);
+        if (fields <= 0)
+            continue;
+        double* cost = fields == 2 ? find_cost(model, name) : NULL;
+        if (!cost)
+        {
+            fprintf(stderr, "%s:%u: expected \"name microseconds\" with a known name\n", path, line_number);
+            ok = false;
+            break;
+        }
+        *cost = value;
+    }
+    fclose(file);
+    return ok;
+}
+
+void host_cost_model_print(const host_cost_model_t* model, FILE* file)
+{
+    fprintf(file, "# device time in microseconds\n");
+    for (int i = 0; i < HOST_SYSCALL_COUNT; ++i)
+        fprintf(file, "%-28s %g\n", host_syscall_name(i), model->syscall_us[i]);
+    fprintf(file, "%-28s %g\n", HID_FRAME_NAME, model->hid_frame_us);
+    fprintf(file, "%-28s %g\n", EXCHANGE_NAME, model->exchange_us);
+}
+
+double host_cost_syscalls_us(const host_cost_model_t* model, const host_syscall_counters_t* counters)
+{
+    double us = 0;
+    for (int i = 0; i < HOST_SYSCALL_COUNT; ++i)
+        us += model->syscall_us[i] * counters->calls[i];
+    return us;
+}
+
+double host_cost_io_us(const host_cost_model_t* model, const host_io_counters_t* counters)
+{
+    return model->hid_frame_us * counters->hid_frames + model->exchange_us * counters->exchanges;
+}
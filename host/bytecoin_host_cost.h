@@ -0,0 +1,45 @@
+/*******************************************************************************
+*   Bytecoin Wallet for Ledger Nano S
+*   (c) 2018 - 2019 The Bytecoin developers
+*
+*  Licensed under the Apache License, Version 2.0 (the "License");
+*  you may not use this file except in compliance with the License.
+*  You may obtain a copy of the License at
+*
+*      http://www.apache.org/licenses/LICENSE-2.0
+*
+*  Unless required by applicable law or agreed to in writing, software
+*  distributed under the License is distributed on an "AS IS" BASIS,
+*  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+*  See the License for the specific language governing permissions and
+*  limitations under the License.
+********************************************************************************/
+
+#ifndef BYTECOIN_HOST_COST_H
+#define BYTECOIN_HOST_COST_H
+
+#include <stdio.h>
+#include <stdbool.h>
+#include "host_syscalls.h"
+#include "bytecoin_host.h"
+
+// Device time charged for every syscall and USB transfer, in microseconds.
+typedef struct host_cost_model_s
+{
+    double syscall_us[HOST_SYSCALL_COUNT];
+    double hid_frame_us; // per 64-byte HID report in either direction
+    double exchange_us;  // fixed per command APDU: io_exchange, dispatch, seproxyhal events
+} host_cost_model_t;
+
+// rough Nano S figures, to be replaced by measured ones with host_cost_model_load
+void host_cost_model_init(host_cost_model_t* model);
+
+// reads "name value" lines, names as printed by host_cost_model_print, # starts a comment
+bool host_cost_model_load(host_cost_model_t* model, const char* path);
+
+void host_cost_model_print(const host_cost_model_t* model, FILE* file);
+
+double host_cost_syscalls_us(const host_cost_model_t* model, const host_syscall_counters_t* counters);
+double host_cost_io_us(const host_cost_model_t* model, const host_io_counters_t* counters);
+
+#endif // BYTECOIN_HOST_COST_H
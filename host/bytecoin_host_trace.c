@@ -0,0 +1,195 @@
+/*******************************************************************************
+*   Bytecoin Wallet for Ledger Nano S
+*   (c) 2018 - 2019 The Bytecoin developers
+*
+*  Licensed under the Apache License, Version 2.0 (the "License");
+*  you may not use this file except in compliance with the License.
+*  You may obtain a copy of the License at
+*
+*      http://www.apache.org/licenses/LICENSE-2.0
+*
+*  Unless required by applicable law or agreed to in writing, software
+*  distributed under the License is distributed on an "AS IS" BASIS,
+*  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+*  See the License for the specific language governing permissions and
+*  limitations under the License.
+********************************************************************************/
+
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "bytecoin_host_trace.h"
+#include "bytecoin_host.h"
+
+host_trace_entry_t* host_trace_add(host_trace_t* trace, const uint8_t* command, size_t len)
+{
+    if (len > sizeof(trace->entries[0].command))
+        return NULL;
+    if (trace->count == trace->capacity)
+    {
+        trace->capacity = trace->capacity ? 2 * trace->capacity : 64;
+        trace->entries = realloc(trace->entries, trace->capacity * sizeof(trace->entries[0]));
+        if (!trace->entries)
+        {
+            fprintf(stderr, "out of memory\n");
+            abort();
+        }
+    }
+    host_trace_entry_t* entry = &trace->entries[trace->count++];
+    os_memset(entry, 0, sizeof(*entry));
+    os_memmove(entry->command, command, len);
+    entry->command_length = (uint16_t)len;
+    return entry;
+}
+
+void host_trace_free(host_trace_t* trace)
+{
+    free(trace->entries);
+    trace->entries = NULL;
+    trace->count = 0;
+    trace->capacity = 0;
+}
+
+static
+int hex_digit(char c)
+{
+    if (c >= '0' && c <= '9')
+        return c - '0';
+    if (c >= 'a' && c <= 'f')
+        return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F')
+        return c - 'A' + 10;
+    return -1;
+}
+
+// returns the number of bytes or -1 if the hex string is invalid or too long
+static
+int parse_hex(const char* hex, size_t hex_len, uint8_t* buf, size_t size)
+{
+    if (hex_len % 2 || hex_len / 2 > size)
+        return -1;
+    for (size_t i = 0; i < hex_len / 2; ++i)
+    {
+        const int hi = hex_digit(hex[2 * i]);
+        const int lo = hex_digit(hex[2 * i + 1]);
+        if (hi < 0 || lo < 0)
+            return -1;
+        buf[i] = (uint8_t)(hi << 4 | lo);
+    }
+    return (int)(hex_len / 2);
+}
+
+bool host_trace_load(host_trace_t* trace, const char* path)
+{
+    FILE* file = fopen(path, "r");
+    if (!file)
+    {
+        perror(path);
+        return false;
+    }
+    char line[2 * IO_APDU_BUFFER_SIZE + 64];
+    unsigned line_number = 0;
+    bool ok = true;
+    while (ok && fgets(line, sizeof(line), file))
+    {
+        ++line_number;
+        const bool is_command = strstr(line, "=>") != NULL;
+        const char* arrow = is_command ? strstr(line, "=>") : strstr(line, "<=");
+        if (line[strspn(line, " \t\r\n")] == '#' || !arrow)
+            continue;
+
+        const char* hex = arrow + 2 + strspn(arrow + 2, " \t");
+        const size_t hex_len = strspn(hex, "0123456789abcdefABCDEF");
+        uint8_t buf[IO_APDU_BUFFER_SIZE];
+        const int len = parse_hex(hex, hex_len, buf, sizeof(buf));
+        if (is_command)
+            ok = len >= 5 && host_trace_add(trace, buf, len) != NULL;
+        else if (len >= 2 && trace->count && !trace->entries[trace->count - 1].response_length)
+        {
+            host_trace_entry_t* entry = &trace->entries[trace->count - 1];
+            os_memmove(entry->response, buf, len);
+            entry->response_length = (uint16_t)len;
+            entry->elapsed_ns = strtoull(hex + hex_len, NULL, 10) * 1000;
+        }
+        else
+            ok = false;
+        if (!ok)
+            fprintf(stderr, "%s:%u: malformed exchange\n", path, line_number);
+    }
+    fclose(file);
+    return ok;
+}
+
+static
+void print_hex(FILE* file, const uint8_t* buf, size_t len)
+{
+    for (size_t i = 0; i < len; ++i)
+        fprintf(file, "%02x", buf[i]);
+}
+
+void host_trace_save(const host_trace_t* trace, FILE* file)
+{
+    for (size_t i = 0; i < trace->count; ++i)
+    {
+        const host_trace_entry_t* entry = &trace->entries[i];
+        fprintf(file, "=> ");
+        print_hex(file, entry->command, entry->command_length);
+        fprintf(file, "\n");
+        if (!entry->response_length)
+            continue;
+        fprintf(file, "<= ");
+        print_hex(file, entry->response, entry->response_length);
+        if (entry->elapsed_ns)
+            fprintf(file, " %llu", (unsigned long long)((entry->elapsed_ns + 500) / 1000));
+        fprintf(file, "\n");
+    }
+}
+
+typedef struct trace_run_s
+{
+    const host_trace_t* trace;
+    host_trace_t* result;
+    size_t next;
+    uint64_t started_ns;
+} trace_run_t;
+
+static
+uint64_t now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+}
+
+static
+size_t run_next_command(void* ctx, uint8_t* buf, size_t size)
+{
+    trace_run_t* run = ctx;
+    if (run->next == run->trace->count)
+        return 0;
+    const host_trace_entry_t* entry = &run->trace->entries[run->next++];
+    if (entry->command_length > size)
+        return 0;
+    os_memmove(buf, entry->command, entry->command_length);
+    host_trace_add(run->result, entry->command, entry->command_length);
+    run->started_ns = now_ns();
+    return entry->command_length;
+}
+
+static
+void run_on_response(void* ctx, const uint8_t* buf, size_t len)
+{
+    const uint64_t ns = now_ns();
+    trace_run_t* run = ctx;
+    host_trace_entry_t* entry = &run->result->entries[run->result->count - 1];
+    entry->elapsed_ns = ns - run->started_ns;
+    entry->response_length = (uint16_t)(len < sizeof(entry->response) ? len : sizeof(entry->response));
+    os_memmove(entry->response, buf, entry->response_length);
+}
+
+void host_trace_run(const host_trace_t* trace, host_trace_t* result)
+{
+    trace_run_t run = { trace, result, 0, 0 };
+    const bytecoin_host_transport_t transport = { run_next_command, run_on_response, &run };
+    bytecoin_host_run(&transport);
+}
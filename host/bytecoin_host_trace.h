@@ -0,0 +1,60 @@
+/*******************************************************************************
+*   Bytecoin Wallet for Ledger Nano S
+*   (c) 2018 - 2019 The Bytecoin developers
+*
+*  Licensed under the Apache License, Version 2.0 (the "License");
+*  you may not use this file except in compliance with the License.
+*  You may obtain a copy of the License at
+*
+*      http://www.apache.org/licenses/LICENSE-2.0
+*
+*  Unless required by applicable law or agreed to in writing, software
+*  distributed under the License is distributed on an "AS IS" BASIS,
+*  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+*  See the License for the specific language governing permissions and
+*  limitations under the License.
+********************************************************************************/
+
+#ifndef BYTECOIN_HOST_TRACE_H
+#define BYTECOIN_HOST_TRACE_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "os.h"
+
+// An APDU trace is a text file of exchanges:
+//
+//   # comment
+//   => 003a00001c...          command
+//   <= 9000 1234              response with the status word, time in microseconds
+//
+// The response line and the time are optional. An optional word before the
+// arrow is ignored, so "HID => ..." logs of ledgerblue can be read as is.
+typedef struct host_trace_entry_s
+{
+    uint8_t command[5 + 255];
+    uint8_t response[IO_APDU_BUFFER_SIZE];
+    uint16_t command_length;
+    uint16_t response_length; // 0 if not recorded
+    uint64_t elapsed_ns;      // 0 if not recorded
+} host_trace_entry_t;
+
+typedef struct host_trace_s
+{
+    host_trace_entry_t* entries;
+    size_t count;
+    size_t capacity;
+} host_trace_t;
+
+host_trace_entry_t* host_trace_add(host_trace_t* trace, const uint8_t* command, size_t len);
+void host_trace_free(host_trace_t* trace);
+
+bool host_trace_load(host_trace_t* trace, const char* path);
+void host_trace_save(const host_trace_t* trace, FILE* file);
+
+// feeds the commands of the trace to dispatch() and records the responses
+// and the time spent on each one in result
+void host_trace_run(const host_trace_t* trace, host_trace_t* result);
+
+#endif // BYTECOIN_HOST_TRACE_H
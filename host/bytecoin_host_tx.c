@@ -0,0 +1,638 @@
+/*******************************************************************************
+*   Bytecoin Wallet for Ledger Nano S
+*   (c) 2018 - 2019 The Bytecoin developers
+*
+*  Licensed under the Apache License, Version 2.0 (the "License");
+*  you may not use this file except in compliance with the License.
+*  You may obtain a copy of the License at
+*
+*      http://www.apache.org/licenses/LICENSE-2.0
+*
+*  Unless required by applicable law or agreed to in writing, software
+*  distributed under the License is distributed on an "AS IS" BASIS,
+*  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+*  See the License for the specific language governing permissions and
+*  limitations under the License.
+********************************************************************************/
+
+// Synthetic signing sessions. Ring members, amounts and the data the wallet
+// hashes after step A are made up: the device only hashes them, so their
+// values do not change the amount of work, only their sizes do.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "os.h"
+#include "bytecoin_host_tx.h"
+#include "bytecoin_crypto.h"
+#include "bytecoin_ledger_api.h"
+#include "bytecoin_apdu.h"
+#include "bytecoin_io.h"
+#include "bytecoin_wallet.h"
+
+#define HOST_TX_INPUT_AMOUNT  1000000
+#define HOST_TX_OUTPUT_AMOUNT 1000
+
+static const char* const phase_names[HOST_TX_PHASE_COUNT] = {
+    "sync",
+    "sig_start",
+    "inputs",
+    "outputs",
+    "extra",
+    "step_a",
+    "get_c0",
+    "step_b",
+};
+
+const char* host_tx_phase_name(host_tx_phase_t phase)
+{
+    return phase < HOST_TX_PHASE_COUNT ? phase_names[phase] : "unknown";
+}
+
+static
+host_apdu_t* append(host_tx_apdus_t* apdus, host_tx_phase_t phase, uint8_t ins)
+{
+    if (apdus->count == apdus->capacity)
+    {
+        apdus->capacity = apdus->capacity ? 2 * apdus->capacity : 64;
+        apdus->items = realloc(apdus->items, apdus->capacity * sizeof(apdus->items[0]));
+        if (!apdus->items)
+        {
+            fprintf(stderr, "out of memory\n");
+            abort();
+        }
+    }
+    host_tx_apdu_t* item = &apdus->items[apdus->count++];
+    item->phase = phase;
+    host_apdu_begin(&item->apdu, ins, 0, 0);
+    return &item->apdu;
+}
+
+typedef struct input_secret_s
+{
+    uint8_t output_secret_hash_arg[32 + 4]; // a transaction hash followed by the output index
+    uint32_t address_index;
+} input_secret_t;
+
+static
+void get_input_secret(const host_tx_shape_t* shape, uint32_t input, input_secret_t* secret)
+{
+    hash_t tx_hash;
+    fast_hash(&input, sizeof(input), &tx_hash);
+    os_memmove(secret->output_secret_hash_arg, tx_hash.data, sizeof(tx_hash.data));
+    for (int k = 0; k < 4; ++k)
+        secret->output_secret_hash_arg[32 + k] = (uint8_t)(input >> (24 - 8 * k));
+    secret->address_index = shape->addresses ? input % shape->addresses : 0;
+}
+
+#define INPUT_SECRET_ARG(secret) { (secret).output_secret_hash_arg, sizeof((secret).output_secret_hash_arg) }
+
+// sig_add_extra or sig_step_a_more_data with size bytes of fill, in as many
+// commands as needed
+static
+void put_chunks(host_tx_apdus_t* apdus, host_tx_phase_t phase, uint8_t ins, uint32_t size, uint8_t fill)
+{
+    uint8_t chunk[BYTECOIN_MAX_BUFFER_SIZE];
+    os_memset(chunk, fill, sizeof(chunk));
+    while (size)
+    {
+        const uint8_t len = size < sizeof(chunk) ? size : sizeof(chunk);
+        const bytecoin_bytes_t bytes = { chunk, len };
+        host_apdu_t* apdu = append(apdus, phase, ins);
+        if (ins == INS_SIG_ADD_EXTRA)
+        {
+            const bytecoin_sig_add_extra_cmd_t cmd = { bytes };
+            host_apdu_encode_sig_add_extra(apdu, &cmd);
+        }
+        else
+        {
+            const bytecoin_sig_step_a_more_data_cmd_t cmd = { bytes };
+            host_apdu_encode_sig_step_a_more_data(apdu, &cmd);
+        }
+        size -= len;
+    }
+}
+
+// one command chained over at least two APDUs, each holding a whole number of
+// units; the handler consumes every APDU as it arrives. A single APDU would
+// not be chained and take the format of a plain command.
+static
+void put_chained(host_tx_apdus_t* apdus, host_tx_phase_t phase, uint8_t ins, const uint8_t* data, size_t size, size_t unit)
+{
+    size_t max_len = 255 - 255 % unit;
+    if (size <= max_len)
+        max_len = (size / unit + 1) / 2 * unit;
+    for (size_t pos = 0; pos < size; pos += max_len)
+    {
+        const size_t len = size - pos < max_len ? size - pos : max_len;
+        host_apdu_t* apdu = append(apdus, phase, ins);
+        if (pos + len < size)
+            apdu->data[0] |= CHAINING_BIT;
+        host_apdu_put_bytes(apdu, data + pos, len);
+    }
+}
+
+static
+uint32_t ring_index(uint32_t input, uint32_t j)
+{
+    return j == 0 ? 1000000 + input : 1 + 7 * j;
+}
+
+// appends len bytes to the chained command whose last APDU is *apdu, in a new
+// APDU when they do not fit
+static
+host_apdu_t* put_chained_part(host_tx_apdus_t* apdus, host_apdu_t* apdu, uint8_t ins, const void* data, size_t len)
+{
+    if (apdu->length + len > sizeof(apdu->data))
+    {
+        apdu->data[0] |= CHAINING_BIT;
+        apdu = append(apdus, HOST_TX_PHASE_INPUTS, ins);
+    }
+    host_apdu_put_bytes(apdu, data, len);
+    return apdu;
+}
+
+// one sig_add_input or sig_add_input_varints per input. A chained one has the
+// layout of a plain one cut after whole indexes, with the key image arguments
+// in the last APDU.
+static
+void put_combined_input(const host_tx_shape_t* shape, uint32_t input, host_tx_apdus_t* apdus)
+{
+    const uint32_t ring_size = shape->mixins + 1;
+    const uint8_t ins = shape->varints ? INS_SIG_ADD_INPUT_VARINTS : INS_SIG_ADD_INPUT;
+    uint8_t indexes[5 * BYTECOIN_MAX_RING_SIZE];
+    uint8_t index_lengths[BYTECOIN_MAX_RING_SIZE];
+    size_t length = 0;
+    for (uint32_t j = 0; j < ring_size; ++j)
+    {
+        const uint32_t index = ring_index(input, j);
+        const size_t before = length;
+        if (shape->varints)
+            length += encode_varint(index, indexes + length);
+        else for (int k = 0; k < 4; ++k)
+            indexes[length++] = (uint8_t)(index >> (24 - 8 * k));
+        index_lengths[j] = length - before;
+    }
+    input_secret_t secret;
+    get_input_secret(shape, input, &secret);
+
+    const size_t tail = 1 + sizeof(secret.output_secret_hash_arg) + 4;
+    if (8 + 1 + length + tail <= 255)
+    {
+        host_apdu_t* apdu = append(apdus, HOST_TX_PHASE_INPUTS, ins);
+        if (shape->varints)
+        {
+            const bytecoin_sig_add_input_varints_cmd_t cmd = { HOST_TX_INPUT_AMOUNT, { indexes, length, ring_size }, INPUT_SECRET_ARG(secret), secret.address_index };
+            host_apdu_encode_sig_add_input_varints(apdu, &cmd);
+        }
+        else
+        {
+            const bytecoin_sig_add_input_cmd_t cmd = { HOST_TX_INPUT_AMOUNT, { indexes, ring_size }, INPUT_SECRET_ARG(secret), secret.address_index };
+            host_apdu_encode_sig_add_input(apdu, &cmd);
+        }
+        return;
+    }
+
+    host_apdu_t* apdu = append(apdus, HOST_TX_PHASE_INPUTS, ins);
+    host_apdu_put_var(apdu, HOST_TX_INPUT_AMOUNT, 8);
+    host_apdu_put_var(apdu, ring_size, 1);
+    const uint8_t* index = indexes;
+    for (uint32_t j = 0; j < ring_size; index += index_lengths[j++])
+        apdu = put_chained_part(apdus, apdu, ins, index, index_lengths[j]);
+    uint8_t arguments[1 + sizeof(secret.output_secret_hash_arg) + 4];
+    arguments[0] = sizeof(secret.output_secret_hash_arg);
+    os_memmove(arguments + 1, secret.output_secret_hash_arg, sizeof(secret.output_secret_hash_arg));
+    for (int k = 0; k < 4; ++k)
+        arguments[1 + sizeof(secret.output_secret_hash_arg) + k] = (uint8_t)(secret.address_index >> (24 - 8 * k));
+    put_chained_part(apdus, apdu, ins, arguments, sizeof(arguments));
+}
+
+static
+void put_u32(uint8_t* buf, size_t* length, uint32_t value)
+{
+    for (int k = 0; k < 4; ++k)
+        buf[(*length)++] = (uint8_t)(value >> (24 - 8 * k));
+}
+
+// the template of sig_prefix up to the extra size, cut at 255 bytes and
+// earlier when more outputs would be derived after one APDU than a response holds
+static
+void put_prefix(
+        const host_tx_shape_t* shape,
+        const elliptic_curve_point_t* dst_address_s,
+        const elliptic_curve_point_t* dst_address_s_v,
+        host_tx_apdus_t* apdus)
+{
+    input_secret_t secret;
+    const uint32_t ring_size = shape->mixins + 1;
+    uint8_t* prefix = malloc(3 * 10 + shape->inputs * (1 + 10 + 5 + 5 * ring_size + 1 + sizeof(secret.output_secret_hash_arg) + 4) + shape->outputs * (1 + 10 + 2 + 2 * 32));
+    size_t* ready = malloc(shape->outputs * sizeof(size_t)); // where each output can be derived
+    size_t length = 0;
+
+    length += encode_varint(1, prefix + length); // version
+    length += encode_varint(0, prefix + length); // unlock time
+    length += encode_varint(shape->inputs, prefix + length);
+    const size_t inputs_start = length;
+    for (uint32_t i = 0; i < shape->inputs; ++i)
+    {
+        prefix[length++] = BYTECOIN_INPUT_KEY_TAG;
+        length += encode_varint(HOST_TX_INPUT_AMOUNT, prefix + length);
+        length += encode_varint(ring_size, prefix + length);
+        for (uint32_t j = 0; j < ring_size; ++j)
+            length += encode_varint(ring_index(i, j), prefix + length);
+        get_input_secret(shape, i, &secret);
+        prefix[length++] = sizeof(secret.output_secret_hash_arg);
+        os_memmove(prefix + length, secret.output_secret_hash_arg, sizeof(secret.output_secret_hash_arg));
+        length += sizeof(secret.output_secret_hash_arg);
+        put_u32(prefix, &length, secret.address_index);
+    }
+    const size_t outputs_start = length;
+    length += encode_varint(shape->outputs, prefix + length);
+    for (uint32_t i = 0; i < shape->outputs; ++i)
+    {
+        prefix[length++] = BYTECOIN_OUTPUT_KEY_TAG;
+        length += encode_varint(HOST_TX_OUTPUT_AMOUNT, prefix + length);
+        const bool change = (shape->outputs > 1 && i + 1 == shape->outputs);
+        prefix[length++] = change;
+        if (change)
+            put_u32(prefix, &length, 0);
+        else
+        {
+            prefix[length++] = 1; // unlinkable address
+            os_memmove(prefix + length, dst_address_s->data, sizeof(dst_address_s->data));
+            length += sizeof(dst_address_s->data);
+            os_memmove(prefix + length, dst_address_s_v->data, sizeof(dst_address_s_v->data));
+            length += sizeof(dst_address_s_v->data);
+        }
+        ready[i] = length;
+    }
+    length += encode_varint(shape->extra_size, prefix + length);
+    ready[shape->outputs - 1] = length; // the last output waits for the extra size
+
+    // an APDU may complete at most BYTECOIN_PREFIX_OUTPUTS outputs, it ends
+    // after the last of them when more would be complete
+    uint32_t next = 0;
+    for (size_t pos = 0; pos < length;)
+    {
+        size_t end = length - pos < 255 ? length : pos + 255;
+        for (uint32_t derived = 0; next < shape->outputs && ready[next] <= end; ++derived, ++next)
+            if (derived == BYTECOIN_PREFIX_OUTPUTS)
+            {
+                end = ready[next - 1];
+                break;
+            }
+        const host_tx_phase_t phase = pos >= outputs_start ? HOST_TX_PHASE_OUTPUTS : pos >= inputs_start ? HOST_TX_PHASE_INPUTS : HOST_TX_PHASE_START;
+        host_apdu_t* apdu = append(apdus, phase, INS_SIG_PREFIX);
+        if (end < length)
+            apdu->data[0] |= CHAINING_BIT;
+        host_apdu_put_bytes(apdu, prefix + pos, end - pos);
+        pos = end;
+    }
+    free(ready);
+    free(prefix);
+}
+
+// the commands from first on finish an input and answer its token
+static
+void request_token(const host_tx_shape_t* shape, host_tx_apdus_t* apdus, size_t first)
+{
+    for (size_t k = first; shape->tokens && k < apdus->count; ++k)
+        apdus->items[k].apdu.data[2] = P1_INPUT_TOKEN;
+}
+
+bool host_tx_answers_token(const host_apdu_t* apdu)
+{
+    const uint8_t ins = apdu->data[1];
+    if (apdu->data[2] != P1_INPUT_TOKEN || (apdu->data[0] & CHAINING_BIT))
+        return false;
+    return ins == INS_SIG_ADD_INPUT_FINISH || ins == INS_SIG_ADD_INPUT || ins == INS_SIG_ADD_INPUT_VARINTS;
+}
+
+uint8_t* host_tx_token(host_apdu_t* apdu)
+{
+    const uint8_t ins = apdu->data[1];
+    // the token is the first field, after its length
+    return (ins == INS_SIG_STEP_A_TOKEN || ins == INS_SIG_STEP_B_TOKEN) ? apdu->data + 5 + 1 : NULL;
+}
+
+void host_tx_generate(const host_tx_shape_t* shape, host_tx_apdus_t* apdus)
+{
+    static const uint8_t no_token[BYTECOIN_INPUT_TOKEN_SIZE];
+    input_secret_t secret;
+
+    if (!shape->streamed)
+    {
+        const bytecoin_sig_start_cmd_t start = { 1, 0, shape->inputs, shape->outputs, shape->extra_size };
+        host_apdu_encode_sig_start(append(apdus, HOST_TX_PHASE_START, INS_SIG_START), &start);
+    }
+
+    for (uint32_t i = 0; !shape->streamed && i < shape->inputs; ++i)
+    {
+        const uint32_t ring_size = shape->mixins + 1;
+        if (shape->combined && ring_size <= BYTECOIN_MAX_RING_SIZE)
+        {
+            const size_t first = apdus->count;
+            put_combined_input(shape, i, apdus);
+            request_token(shape, apdus, first);
+            continue;
+        }
+        const bytecoin_sig_add_input_start_cmd_t input_start = { HOST_TX_INPUT_AMOUNT, ring_size };
+        host_apdu_encode_sig_add_input_start(append(apdus, HOST_TX_PHASE_INPUTS, INS_SIG_ADD_INPUT_START), &input_start);
+
+        // relative global indexes, as the wallet sends them
+        if (shape->chained && ring_size > BYTECOIN_MAX_OUTPUT_INDEXES)
+        {
+            uint8_t* indexes = malloc(4 * ring_size);
+            for (uint32_t j = 0; j < ring_size; ++j)
+            {
+                const uint32_t index = ring_index(i, j);
+                for (int k = 0; k < 4; ++k)
+                    indexes[4 * j + k] = (uint8_t)(index >> (24 - 8 * k));
+            }
+            put_chained(apdus, HOST_TX_PHASE_INPUTS, INS_SIG_ADD_INPUT_INDEXES, indexes, 4 * ring_size, 4);
+            free(indexes);
+        }
+        else for (uint32_t j = 0; j < ring_size; j += BYTECOIN_MAX_OUTPUT_INDEXES)
+        {
+            const uint8_t len = ring_size - j < BYTECOIN_MAX_OUTPUT_INDEXES ? ring_size - j : BYTECOIN_MAX_OUTPUT_INDEXES;
+            uint8_t indexes[4 * BYTECOIN_MAX_OUTPUT_INDEXES];
+            for (uint32_t k = 0; k < len; ++k)
+                for (int b = 0; b < 4; ++b)
+                    indexes[4 * k + b] = (uint8_t)(ring_index(i, j + k) >> (24 - 8 * b));
+            const bytecoin_sig_add_input_indexes_cmd_t cmd = { { indexes, len } };
+            host_apdu_encode_sig_add_input_indexes(append(apdus, HOST_TX_PHASE_INPUTS, INS_SIG_ADD_INPUT_INDEXES), &cmd);
+        }
+
+        get_input_secret(shape, i, &secret);
+        const bytecoin_sig_add_input_finish_cmd_t finish = { INPUT_SECRET_ARG(secret), secret.address_index };
+        host_apdu_encode_sig_add_input_finish(append(apdus, HOST_TX_PHASE_INPUTS, INS_SIG_ADD_INPUT_FINISH), &finish);
+        request_token(shape, apdus, apdus->count - 1);
+    }
+
+    elliptic_curve_scalar_t s;
+    elliptic_curve_point_t dst_address_s;
+    elliptic_curve_point_t dst_address_s_v;
+    hash_to_scalar("S", 1, &s);
+    ecmul_G(&s, &dst_address_s);
+    hash_to_scalar("V", 1, &s);
+    ecmul_G(&s, &dst_address_s_v);
+    if (shape->streamed)
+        put_prefix(shape, &dst_address_s, &dst_address_s_v, apdus);
+    for (uint32_t i = 0; !shape->streamed && shape->grouped && i < shape->outputs; i += BYTECOIN_MAX_ADD_OUTPUTS)
+    {
+        const uint32_t count = shape->outputs - i < BYTECOIN_MAX_ADD_OUTPUTS ? shape->outputs - i : BYTECOIN_MAX_ADD_OUTPUTS;
+        uint8_t outputs[BYTECOIN_MAX_ADD_OUTPUTS * BYTECOIN_SIG_ADD_OUTPUTS_ITEM_SIZE];
+        for (uint32_t k = 0; k < count; ++k)
+        {
+            uint8_t* item = outputs + k * BYTECOIN_SIG_ADD_OUTPUTS_ITEM_SIZE;
+            item[0] = (shape->outputs > 1 && i + k + 1 == shape->outputs); // change
+            for (int b = 0; b < 8; ++b)
+                item[1 + b] = (uint8_t)((uint64_t)HOST_TX_OUTPUT_AMOUNT >> (56 - 8 * b));
+            os_memset(item + 9, 0, 4); // change address index
+        }
+        const bytecoin_sig_add_outputs_cmd_t cmd = {
+            .dst_address_tag = 1, // unlinkable address
+            .dst_address_s   = &dst_address_s,
+            .dst_address_s_v = &dst_address_s_v,
+            .outputs         = { outputs, count * BYTECOIN_SIG_ADD_OUTPUTS_ITEM_SIZE },
+        };
+        host_apdu_encode_sig_add_outputs(append(apdus, HOST_TX_PHASE_OUTPUTS, INS_SIG_ADD_OUTPUTS), &cmd);
+        // the device answers the other outputs on request
+        for (uint32_t k = BYTECOIN_ADD_OUTPUTS_PER_RESPONSE; k < count; k += BYTECOIN_ADD_OUTPUTS_PER_RESPONSE)
+            host_apdu_encode_get_response(append(apdus, HOST_TX_PHASE_OUTPUTS, INS_GET_RESPONSE));
+    }
+    for (uint32_t i = 0; !shape->streamed && !shape->grouped && i < shape->outputs; ++i)
+    {
+        const bool change = (shape->outputs > 1 && i + 1 == shape->outputs);
+        const bytecoin_sig_add_output_cmd_t output = {
+            .change               = change,
+            .amount               = HOST_TX_OUTPUT_AMOUNT,
+            .change_address_index = 0,
+            .dst_address_tag      = 1, // unlinkable address
+            .dst_address_s        = &dst_address_s,
+            .dst_address_s_v      = &dst_address_s_v,
+        };
+        host_apdu_encode_sig_add_output(append(apdus, HOST_TX_PHASE_OUTPUTS, INS_SIG_ADD_OUPUT), &output);
+    }
+
+    if (shape->chained && shape->extra_size > BYTECOIN_MAX_BUFFER_SIZE)
+    {
+        uint8_t* extra = malloc(shape->extra_size);
+        os_memset(extra, 0x01, shape->extra_size);
+        put_chained(apdus, HOST_TX_PHASE_EXTRA, INS_SIG_ADD_EXTRA, extra, shape->extra_size, 1);
+        free(extra);
+    }
+    else
+        put_chunks(apdus, HOST_TX_PHASE_EXTRA, INS_SIG_ADD_EXTRA, shape->extra_size, 0x01);
+    if (!shape->extra_size)
+    {
+        // an empty chunk still finishes the prefix
+        const bytecoin_sig_add_extra_cmd_t empty = { { NULL, 0 } };
+        host_apdu_encode_sig_add_extra(append(apdus, HOST_TX_PHASE_EXTRA, INS_SIG_ADD_EXTRA), &empty);
+    }
+
+    const uint32_t ring_data = 2 * 32 * shape->mixins;
+    for (uint32_t i = 0; shape->grouped_steps && i < shape->inputs;)
+    {
+        // the ring data of an input goes with it as far as it fits, the rest
+        // of the last input follows as sig_step_a_more_data
+        uint8_t inputs[BYTECOIN_MAX_STEP_INPUTS];
+        size_t length = 0;
+        uint32_t rest = 0;
+        for (uint32_t k = 0; k < BYTECOIN_STEP_A_INPUTS_PER_RESPONSE && i < shape->inputs && !rest; ++k, ++i)
+        {
+            if (length + 1 + sizeof(secret.output_secret_hash_arg) + 4 + 1 > sizeof(inputs))
+                break;
+            get_input_secret(shape, i, &secret);
+            inputs[length++] = sizeof(secret.output_secret_hash_arg);
+            os_memmove(inputs + length, secret.output_secret_hash_arg, sizeof(secret.output_secret_hash_arg));
+            length += sizeof(secret.output_secret_hash_arg);
+            for (int b = 0; b < 4; ++b)
+                inputs[length++] = (uint8_t)(secret.address_index >> (24 - 8 * b));
+            const size_t room = sizeof(inputs) - length - 1;
+            const uint8_t len = ring_data < room ? ring_data : room;
+            inputs[length++] = len;
+            os_memset(inputs + length, 0x02, len);
+            length += len;
+            rest = ring_data - len;
+        }
+        const bytecoin_sig_step_a_inputs_cmd_t cmd = { { inputs, length } };
+        host_apdu_encode_sig_step_a_inputs(append(apdus, HOST_TX_PHASE_STEP_A, INS_SIG_STEP_A_INPUTS), &cmd);
+        put_chunks(apdus, HOST_TX_PHASE_STEP_A, INS_SIG_STEP_A_MORE_DATA, rest, 0x02);
+    }
+    for (uint32_t i = 0; !shape->grouped_steps && i < shape->inputs; ++i)
+    {
+        get_input_secret(shape, i, &secret);
+        const bytecoin_sig_step_a_cmd_t step_a = { INPUT_SECRET_ARG(secret), secret.address_index };
+        const bytecoin_sig_step_a_token_cmd_t step_a_token = { { no_token, sizeof(no_token) } };
+        if (shape->tokens)
+            host_apdu_encode_sig_step_a_token(append(apdus, HOST_TX_PHASE_STEP_A, INS_SIG_STEP_A_TOKEN), &step_a_token);
+        else
+            host_apdu_encode_sig_step_a(append(apdus, HOST_TX_PHASE_STEP_A, INS_SIG_STEP_A), &step_a);
+        // the wallet hashes the commitments of the other ring members after step A
+        put_chunks(apdus, HOST_TX_PHASE_STEP_A, INS_SIG_STEP_A_MORE_DATA, ring_data, 0x02);
+    }
+
+    host_apdu_encode_sig_get_c0(append(apdus, HOST_TX_PHASE_GET_C0, INS_SIG_GET_C0));
+    const size_t first_step_b = apdus->count;
+
+    for (uint32_t i = 0; shape->grouped_steps && i < shape->inputs;)
+    {
+        uint8_t inputs[BYTECOIN_MAX_STEP_INPUTS];
+        size_t length = 0;
+        for (uint32_t k = 0; k < BYTECOIN_STEP_B_INPUTS_PER_RESPONSE && i < shape->inputs; ++k, ++i)
+        {
+            elliptic_curve_scalar_t my_c;
+            hash_to_scalar(&i, sizeof(i), &my_c);
+            get_input_secret(shape, i, &secret);
+            inputs[length++] = sizeof(secret.output_secret_hash_arg);
+            os_memmove(inputs + length, secret.output_secret_hash_arg, sizeof(secret.output_secret_hash_arg));
+            length += sizeof(secret.output_secret_hash_arg);
+            for (int b = 0; b < 4; ++b)
+                inputs[length++] = (uint8_t)(secret.address_index >> (24 - 8 * b));
+            reverse(inputs + length, my_c.data, sizeof(my_c.data));
+            length += sizeof(my_c.data);
+        }
+        const bytecoin_sig_step_b_inputs_cmd_t cmd = { { inputs, length } };
+        host_apdu_encode_sig_step_b_inputs(append(apdus, HOST_TX_PHASE_STEP_B, INS_SIG_STEP_B_INPUTS), &cmd);
+    }
+    for (uint32_t i = 0; !shape->grouped_steps && i < shape->inputs; ++i)
+    {
+        elliptic_curve_scalar_t my_c;
+        hash_to_scalar(&i, sizeof(i), &my_c);
+        get_input_secret(shape, i, &secret);
+        const bytecoin_sig_step_b_cmd_t step_b = { INPUT_SECRET_ARG(secret), secret.address_index, &my_c };
+        const bytecoin_sig_step_b_token_cmd_t step_b_token = { { no_token, sizeof(no_token) }, &my_c };
+        if (shape->tokens)
+            host_apdu_encode_sig_step_b_token(append(apdus, HOST_TX_PHASE_STEP_B, INS_SIG_STEP_B_TOKEN), &step_b_token);
+        else
+            host_apdu_encode_sig_step_b(append(apdus, HOST_TX_PHASE_STEP_B, INS_SIG_STEP_B), &step_b);
+    }
+    for (size_t k = first_step_b; shape->key_stream && k < apdus->count; ++k)
+        apdus->items[k].apdu.data[2] = P1_STEP_B_KEY_STREAM;
+}
+
+void host_tx_decrypt_step_b(const hash_t* e_key, uint32_t input, bool key_stream, const uint8_t* response, elliptic_curve_scalar_t scalars[3])
+{
+    // the encryption of zero is the key stream
+    static const uint8_t names[3][2] = { { 'r', 'r' }, { 'r', 's' }, { 'r', 'a' } };
+    const elliptic_curve_scalar_t zeros[3] = { { { 0 } } };
+    hash_t key_stream_of[3];
+    if (key_stream)
+        encrypt_scalars(e_key, zeros, input, key_stream_of);
+    for (int k = 0; k < 3; ++k)
+    {
+        if (!key_stream)
+            encrypt_scalar(e_key, &zeros[k], input, names[k], &key_stream_of[k]);
+        for (size_t j = 0; j < sizeof(scalars[k].data); ++j)
+            scalars[k].data[sizeof(scalars[k].data) - j - 1] = response[32 * k + j] ^ key_stream_of[k].data[j];
+    }
+}
+
+void host_tx_generate_sync(uint32_t scans, uint32_t keyimages, uint32_t addresses, host_tx_apdus_t* apdus)
+{
+    host_apdu_encode_get_app_info(append(apdus, HOST_TX_PHASE_SYNC, INS_GET_APP_INFO));
+    host_apdu_encode_get_wallet_keys(append(apdus, HOST_TX_PHASE_SYNC, INS_GET_WALLET_KEYS));
+
+    for (uint32_t i = 0; i < scans; ++i)
+    {
+        elliptic_curve_point_t keys[BYTECOIN_MAX_SCAN_OUTPUTS];
+        for (uint32_t j = 0; j < BYTECOIN_MAX_SCAN_OUTPUTS; ++j)
+        {
+            const uint32_t n = i * BYTECOIN_MAX_SCAN_OUTPUTS + j;
+            elliptic_curve_scalar_t s;
+            hash_to_scalar(&n, sizeof(n), &s);
+            ecmul_G(&s, &keys[j]);
+        }
+        const bytecoin_scan_outputs_cmd_t scan = { { keys, BYTECOIN_MAX_SCAN_OUTPUTS } };
+        host_apdu_encode_scan_outputs(append(apdus, HOST_TX_PHASE_SYNC, INS_SCAN_OUTPUTS), &scan);
+    }
+
+    const host_tx_shape_t shape = { .addresses = addresses };
+    for (uint32_t i = 0; i < keyimages; ++i)
+    {
+        input_secret_t secret;
+        get_input_secret(&shape, i, &secret);
+        const bytecoin_generate_keyimage_cmd_t keyimage = { INPUT_SECRET_ARG(secret), secret.address_index };
+        host_apdu_encode_generate_keyimage(append(apdus, HOST_TX_PHASE_SYNC, INS_GENERATE_KEYIMAGE), &keyimage);
+    }
+}
+
+typedef struct batch_s
+{
+    uint8_t data[255];
+    size_t length;
+    size_t responses; // worst case
+    size_t items;
+    host_tx_phase_t phase;
+    const host_apdu_t* single; // the only item, sent as is
+} batch_t;
+
+static
+void flush_batch(batch_t* batch, host_tx_apdus_t* batched)
+{
+    if (batch->items == 1)
+        append(batched, batch->phase, 0)[0] = *batch->single;
+    else if (batch->items > 1)
+        host_apdu_put_bytes(append(batched, batch->phase, INS_BATCH), batch->data, batch->length);
+    batch->length = 0;
+    batch->responses = 0;
+    batch->items = 0;
+}
+
+static
+bool is_batchable(const host_tx_apdus_t* apdus, size_t i)
+{
+    const host_apdu_t* apdu = &apdus->items[i].apdu;
+    const uint8_t ins = apdu->data[1];
+    if (apdu->data[0] != BYTECOIN_CLA || apdu->data[2] || apdu->data[3])
+        return false;
+    // the last APDU of a chained command
+    if (i > 0 && (apdus->items[i - 1].apdu.data[0] & CHAINING_BIT))
+        return false;
+    if (bytecoin_batch_max_response(ins) == BYTECOIN_BATCH_NOT_BATCHABLE)
+        return false;
+    // the last output waits for the user
+    if (ins == INS_SIG_ADD_OUPUT && (i + 1 == apdus->count || apdus->items[i + 1].apdu.data[1] != INS_SIG_ADD_OUPUT))
+        return false;
+    return true;
+}
+
+void host_tx_batch(const host_tx_apdus_t* apdus, host_tx_apdus_t* batched)
+{
+    batch_t batch = { .items = 0 };
+    for (size_t i = 0; i < apdus->count; ++i)
+    {
+        const host_tx_apdu_t* item = &apdus->items[i];
+        const uint8_t lc = item->apdu.data[4];
+        if (!is_batchable(apdus, i))
+        {
+            flush_batch(&batch, batched);
+            append(batched, item->phase, 0)[0] = item->apdu;
+            continue;
+        }
+        // the device keeps the responses in front of the commands, see bytecoin_apdu_batch
+        const size_t length = batch.length + 2 + lc;
+        const size_t responses = batch.responses + 3 + bytecoin_batch_max_response(item->apdu.data[1]);
+        const size_t room = BYTECOIN_IO_BUFFER_SIZE - length < BYTECOIN_BATCH_MAX_RESPONSE ? BYTECOIN_IO_BUFFER_SIZE - length : BYTECOIN_BATCH_MAX_RESPONSE;
+        if (batch.items && (item->phase != batch.phase || length > sizeof(batch.data) || responses > room))
+            flush_batch(&batch, batched);
+
+        batch.data[batch.length++] = item->apdu.data[1];
+        batch.data[batch.length++] = lc;
+        os_memmove(batch.data + batch.length, item->apdu.data + 5, lc);
+        batch.length += lc;
+        batch.responses += 3 + bytecoin_batch_max_response(item->apdu.data[1]);
+        batch.phase = item->phase;
+        batch.single = &item->apdu;
+        batch.items += 1;
+    }
+    flush_batch(&batch, batched);
+}
+
+void host_tx_apdus_free(host_tx_apdus_t* apdus)
+{
+    free(apdus->items);
+    apdus->items = NULL;
+    apdus->count = 0;
+    apdus->capacity = 0;
+}
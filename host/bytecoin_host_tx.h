@@ -0,0 +1,100 @@
+/*******************************************************************************
+*   Bytecoin Wallet for Ledger Nano S
+*   (c) 2018 - 2019 The Bytecoin developers
+*
+*  Licensed under the Apache License, Version 2.0 (the "License");
+*  you may not use this file except in compliance with the License.
+*  You may obtain a copy of the License at
+*
+*      http://www.apache.org/licenses/LICENSE-2.0
+*
+*  Unless required by applicable law or agreed to in writing, software
+*  distributed under the License is distributed on an "AS IS" BASIS,
+*  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+*  See the License for the specific language governing permissions and
+*  limitations under the License.
+********************************************************************************/
+
+#ifndef BYTECOIN_HOST_TX_H
+#define BYTECOIN_HOST_TX_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include "bytecoin_host.h"
+
+// Shape of a synthetic transaction signed by the host tools.
+typedef struct host_tx_shape_s
+{
+    uint32_t inputs;    // 1..65535
+    uint32_t mixins;    // ring size minus one, per input
+    uint32_t outputs;   // the last output is change when there is more than one
+    uint32_t extra_size;
+    uint32_t addresses; // inputs are spread round robin over this many wallet addresses
+    bool chained;       // ring indexes and extra too long for one APDU are chained
+    bool combined;      // every input is one INS_SIG_ADD_INPUT, chained when its ring needs it
+    bool varints;       // combined inputs carry their indexes as varints, INS_SIG_ADD_INPUT_VARINTS
+    bool grouped;       // up to BYTECOIN_MAX_ADD_OUTPUTS outputs per INS_SIG_ADD_OUTPUTS
+    bool grouped_steps; // several inputs per INS_SIG_STEP_A_INPUTS and INS_SIG_STEP_B_INPUTS
+    bool streamed;      // the prefix up to the extra size as one chained INS_SIG_PREFIX
+    bool tokens;        // inputs answer tokens, steps A and B take them, not with streamed or grouped_steps
+    bool key_stream;    // step B asks for P1_STEP_B_KEY_STREAM
+} host_tx_shape_t;
+
+typedef enum host_tx_phase_e
+{
+    HOST_TX_PHASE_SYNC = 0,     // wallet commands outside of signing
+    HOST_TX_PHASE_START,
+    HOST_TX_PHASE_INPUTS,
+    HOST_TX_PHASE_OUTPUTS,
+    HOST_TX_PHASE_EXTRA,
+    HOST_TX_PHASE_STEP_A,
+    HOST_TX_PHASE_GET_C0,
+    HOST_TX_PHASE_STEP_B,
+    HOST_TX_PHASE_COUNT
+} host_tx_phase_t;
+
+typedef struct host_tx_apdu_s
+{
+    host_apdu_t apdu;
+    host_tx_phase_t phase;
+} host_tx_apdu_t;
+
+typedef struct host_tx_apdus_s
+{
+    host_tx_apdu_t* items;
+    size_t count;
+    size_t capacity;
+} host_tx_apdus_t;
+
+const char* host_tx_phase_name(host_tx_phase_t phase);
+
+// Appends the complete APDU sequence signing a transaction of the given shape,
+// from INS_SIG_START to the last INS_SIG_STEP_B. The sequence does not depend
+// on the responses but for the input tokens, so it can be generated up front
+// and replayed.
+void host_tx_generate(const host_tx_shape_t* shape, host_tx_apdus_t* apdus);
+
+// Appends the APDUs of a wallet sync: get_wallet_keys, scans of
+// BYTECOIN_MAX_SCAN_OUTPUTS outputs each and key images of the found ones.
+void host_tx_generate_sync(uint32_t scans, uint32_t keyimages, uint32_t addresses, host_tx_apdus_t* apdus);
+
+// With shape->tokens the commands of steps A and B carry zeros in place of the
+// token of their input: the wallet puts in the token the input answered, in
+// the order of the inputs. host_tx_token() is where it goes, NULL for the
+// other commands.
+bool host_tx_answers_token(const host_apdu_t* apdu);
+uint8_t* host_tx_token(host_apdu_t* apdu);
+
+// The scalars sig_my_rr, sig_rs and sig_ra of an input from the 3 * 32 bytes
+// step B answered for it and the e_key of the last input.
+void host_tx_decrypt_step_b(const hash_t* e_key, uint32_t input, bool key_stream, const uint8_t* response, elliptic_curve_scalar_t scalars[3]);
+
+// Packs consecutive commands of the same phase into INS_BATCH APDUs. Only as
+// many commands go into one APDU as the device runs in full whatever the
+// responses are, so the result does not depend on the responses.
+void host_tx_batch(const host_tx_apdus_t* apdus, host_tx_apdus_t* batched);
+
+void host_tx_apdus_free(host_tx_apdus_t* apdus);
+
+#endif // BYTECOIN_HOST_TX_H
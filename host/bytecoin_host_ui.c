@@ -0,0 +1,217 @@
+/*******************************************************************************
+*   Bytecoin Wallet for Ledger Nano S
+*   (c) 2018 - 2019 The Bytecoin developers
+*
+*  Licensed under the Apache License, Version 2.0 (the "License");
+*  you may not use this file except in compliance with the License.
+*  You may obtain a copy of the License at
+*
+*      http://www.apache.org/licenses/LICENSE-2.0
+*
+*  Unless required by applicable law or agreed to in writing, software
+*  distributed under the License is distributed on an "AS IS" BASIS,
+*  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+*  See the License for the specific language governing permissions and
+*  limitations under the License.
+********************************************************************************/
+
+// Stand-in for bytecoin_ui.c: there is no screen on the host. Every
+// confirmation renders the text the device would display and is decided by
+// the script of the device, see host_ui_t. The reply is sent exactly the way
+// the button handlers of bytecoin_ui.c do.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "os.h"
+#include "bytecoin_ui.h"
+#include "bytecoin_ui_text.h"
+#include "bytecoin_vars.h"
+#include "bytecoin_apdu.h"
+#include "bytecoin_dispatch.h"
+#include "bytecoin_ledger_api.h"
+#include "bytecoin_host.h"
+
+typedef enum host_ui_pending_e
+{
+    HOST_UI_IDLE = 0,
+    HOST_UI_EXPORT_VIEW_ONLY,
+    HOST_UI_VIEW_OUTGOING_ADDRESSES,
+    HOST_UI_CONFIRM_TX,
+} host_ui_pending_t;
+
+static const char* const confirm_tx_labels[UI_CONFIRM_TX_ITEMS] = {
+    "Recipient address", "Amount", "Fee"
+};
+
+void init_ui_data(ui_data_t* ui_data)
+{
+    os_memset(ui_data, 0, sizeof(ui_data_t));
+    ui_data->string_is_valid = false;
+}
+
+void ui_init(void)
+{
+}
+
+int user_confirm_export_view_only(bytecoin_v_state_t* state)
+{
+    bytecoin_host_device_of(state)->ui.pending = HOST_UI_EXPORT_VIEW_ONLY;
+    return 0;
+}
+
+int user_confirm_view_outgoing_addresses(bytecoin_v_state_t* state)
+{
+    bytecoin_host_device_of(state)->ui.pending = HOST_UI_VIEW_OUTGOING_ADDRESSES;
+    return 0;
+}
+
+int user_confirm_tx(bytecoin_v_state_t* state)
+{
+    state->ui_data.string_is_valid = false;
+    bytecoin_host_device_of(state)->ui.pending = HOST_UI_CONFIRM_TX;
+    return 0;
+}
+
+bool host_ui_set_script(host_ui_t* ui, const char* script)
+{
+    ui->steps_count = 0;
+    ui->next_step = 0;
+    while (*script)
+    {
+        if (ui->steps_count == HOST_UI_MAX_STEPS)
+            return false;
+        host_ui_step_t* step = &ui->steps[ui->steps_count++];
+        if (!strncmp(script, "approve", 7))
+        {
+            step->action = HOST_UI_APPROVE;
+            script += 7;
+        }
+        else if (!strncmp(script, "reject", 6))
+        {
+            step->action = HOST_UI_REJECT;
+            script += 6;
+        }
+        else
+            return false;
+        step->delay_ms = 0;
+        if (*script == ':')
+        {
+            char* end;
+            step->delay_ms = strtoul(script + 1, &end, 10);
+            if (end == script + 1)
+                return false;
+            script = end;
+        }
+        if (*script == ',')
+            ++script;
+        else if (*script)
+            return false;
+    }
+    return true;
+}
+
+static
+uint64_t now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+}
+
+static
+void render(bytecoin_v_state_t* state, host_ui_pending_t pending, host_ui_screen_t* screen)
+{
+    os_memset(screen, 0, sizeof(*screen));
+    const uint64_t started = now_ns();
+    switch (pending)
+    {
+    case HOST_UI_EXPORT_VIEW_ONLY:
+        screen->name = "export_view_only";
+        snprintf(screen->lines[screen->lines_count++], sizeof(screen->lines[0]), "Export view wallet?");
+        break;
+    case HOST_UI_VIEW_OUTGOING_ADDRESSES:
+        screen->name = "view_outgoing_addresses";
+        snprintf(screen->lines[screen->lines_count++], sizeof(screen->lines[0]), "Allow to view outgoing addrs.?");
+        break;
+    case HOST_UI_CONFIRM_TX:
+        screen->name = "confirm_tx";
+        for (ui_confirm_tx_item_t item = 0; item < UI_CONFIRM_TX_ITEMS; ++item)
+        {
+            // formatted in the buffer of the device, like the menu preprocessor does
+            ui_confirm_tx_text(&state->sig_state, item, state->ui_data.address_str, sizeof(state->ui_data.address_str));
+            snprintf(screen->lines[screen->lines_count++], sizeof(screen->lines[0]), "%s: %s",
+                     confirm_tx_labels[item], state->ui_data.address_str);
+        }
+        break;
+    default:
+        break;
+    }
+    screen->render_ns = now_ns() - started;
+}
+
+static
+host_ui_step_t next_step(host_ui_t* ui)
+{
+    const host_ui_step_t approve = { HOST_UI_APPROVE, 0 };
+    if (!ui->steps_count)
+        return approve;
+    const host_ui_step_t step = ui->steps[ui->next_step];
+    if (ui->next_step + 1 < ui->steps_count)
+        ui->next_step += 1;
+    return step;
+}
+
+static
+void reply(bytecoin_v_state_t* state, uint16_t sw)
+{
+    finish_response(state, sw);
+    io_do(&state->prev_io_call_params, &state->io_buffer, IO_RETURN_AFTER_TX);
+}
+
+void bytecoin_host_ui_process(bytecoin_host_device_t* device)
+{
+    bytecoin_v_state_t* state = &device->state;
+    host_ui_t* ui = &device->ui;
+    if (ui->pending == HOST_UI_IDLE)
+    {
+        fprintf(stderr, "the app waits for the user but nothing is displayed\n");
+        abort();
+    }
+    while (ui->pending != HOST_UI_IDLE)
+    {
+        const host_ui_pending_t pending = ui->pending;
+        ui->pending = HOST_UI_IDLE;
+
+        host_ui_screen_t screen;
+        render(state, pending, &screen);
+        screen.step = next_step(ui);
+        if (screen.step.delay_ms)
+        {
+            const struct timespec delay = { screen.step.delay_ms / 1000, (screen.step.delay_ms % 1000) * 1000000L };
+            nanosleep(&delay, NULL);
+        }
+        if (ui->on_screen)
+            ui->on_screen(ui->ctx, &screen);
+
+        const bool approved = (screen.step.action == HOST_UI_APPROVE);
+        switch (pending)
+        {
+        case HOST_UI_EXPORT_VIEW_ONLY:
+            if (approved)
+                user_confirm_view_outgoing_addresses(state);
+            else
+                reply(state, SW_SECURITY_STATUS_NOT_SATISFIED);
+            break;
+        case HOST_UI_VIEW_OUTGOING_ADDRESSES:
+            reply(state, bytecoin_apdu_export_view_only_final(state, approved));
+            break;
+        case HOST_UI_CONFIRM_TX:
+            reply(state, approved ? bytecoin_apdu_sig_add_output_final(state) : SW_SECURITY_STATUS_NOT_SATISFIED);
+            break;
+        default:
+            break;
+        }
+    }
+}
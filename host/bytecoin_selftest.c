@@ -0,0 +1,1106 @@
+/*******************************************************************************
+*   Bytecoin Wallet for Ledger Nano S
+*   (c) 2018 - 2019 The Bytecoin developers
+*
+*  Licensed under the Apache License, Version 2.0 (the "License");
+*  you may not use this file except in compliance with the License.
+*  You may obtain a copy of the License at
+*
+*      http://www.apache.org/licenses/LICENSE-2.0
+*
+*  Unless required by applicable law or agreed to in writing, software
+*  distributed under the License is distributed on an "AS IS" BASIS,
+*  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+*  See the License for the specific language governing permissions and
+*  limitations under the License.
+********************************************************************************/
+
+// Known-answer and consistency checks of the software SDK stand-in, followed
+// by a complete signing session through dispatch().
+
+#include <stdio.h>
+#include <string.h>
+#include "os.h"
+#include "bytecoin_host.h"
+#include "bytecoin_host_tx.h"
+#include "bytecoin_crypto.h"
+#include "bytecoin_fe.h"
+#include "bytecoin_keys.h"
+#include "bytecoin_ledger_api.h"
+#include "bytecoin_stats.h"
+
+static int G_failures;
+
+#define CHECK(cond) \
+    do { if (!(cond)) { ++G_failures; fprintf(stderr, "%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #cond); } } while (0)
+
+static
+void from_hex(const char* hex, uint8_t* buf, size_t len)
+{
+    for (size_t i = 0; i < len; ++i)
+    {
+        unsigned int byte;
+        sscanf(hex + 2 * i, "%2x", &byte);
+        buf[i] = (uint8_t)byte;
+    }
+}
+
+static
+bool equals_hex(const uint8_t* buf, size_t len, const char* hex)
+{
+    uint8_t expected[64];
+    from_hex(hex, expected, len);
+    return os_memcmp(buf, expected, len) == 0;
+}
+
+static
+void scalar_from_u64(uint64_t value, elliptic_curve_scalar_t* s)
+{
+    os_memset(s->data, 0, sizeof(s->data));
+    for (size_t i = 0; i < 8; ++i)
+        s->data[sizeof(s->data) - 1 - i] = (uint8_t)(value >> (8 * i));
+}
+
+static
+void test_keccak(void)
+{
+    hash_t h;
+    fast_hash("", 0, &h);
+    CHECK(equals_hex(h.data, 32, "c5d2460186f7233c927e7db2dcc703c0e500b653ca82273b7bfad8045d85a470"));
+}
+
+static
+void test_points(void)
+{
+    elliptic_curve_scalar_t one;
+    scalar_from_u64(1, &one);
+
+    elliptic_curve_point_t G;
+    ecmul_G(&one, &G);
+    CHECK(equals_hex(G.data, 32, "5866666666666666666666666666666666666666666666666666666666666666"));
+
+    elliptic_curve_point_t H;
+    ecmul_H(&one, &H);
+    CHECK(equals_hex(H.data, 32, "8b655970153799af2aeadc9ff1add0ea6c7251d54154cfa92c173a0dd39c1f94"));
+
+    elliptic_curve_scalar_t a, b, sum;
+    hash_to_scalar("a", 1, &a);
+    hash_to_scalar("b", 1, &b);
+    ecaddm(&a, &b, &sum);
+
+    elliptic_curve_point_t aG, bG, sumG, added, subtracted;
+    ecmul_G(&a, &aG);
+    ecmul_G(&b, &bG);
+    ecmul_G(&sum, &sumG);
+    ecadd(&aG, &bG, &added);
+    CHECK(os_memcmp(added.data, sumG.data, 32) == 0);
+    ecsub(&sumG, &bG, &subtracted);
+    CHECK(os_memcmp(subtracted.data, aG.data, 32) == 0);
+
+    elliptic_curve_point_t aG_plus_G, G_plus_aG;
+    ecadd_G(&aG, &aG_plus_G);
+    ecadd(&G, &aG, &G_plus_aG);
+    CHECK(os_memcmp(aG_plus_G.data, G_plus_aG.data, 32) == 0);
+
+    elliptic_curve_scalar_t eight;
+    scalar_from_u64(8, &eight);
+    elliptic_curve_point_t times8, mul8;
+    ecmul_8(&aG, &times8);
+    ecmul(&aG, &eight, &mul8);
+    CHECK(os_memcmp(times8.data, mul8.data, 32) == 0);
+
+    elliptic_curve_point_t abG, baG;
+    ecmul(&aG, &b, &abG);
+    ecmul(&bG, &a, &baG);
+    CHECK(os_memcmp(abG.data, baG.data, 32) == 0);
+}
+
+static
+void test_scalars(void)
+{
+    elliptic_curve_scalar_t a, inv_a, product, one;
+    hash_to_scalar("c", 1, &a);
+    invert32(&a, &inv_a);
+    ecmulm(&a, &inv_a, &product);
+    scalar_from_u64(1, &one);
+    CHECK(os_memcmp(product.data, one.data, 32) == 0);
+
+    elliptic_curve_scalar_t diff;
+    ecsubm(&a, &a, &diff);
+    CHECK(cx_math_is_zero(diff.data, sizeof(diff.data)));
+}
+
+static
+void test_hash_to_point(void)
+{
+    // the result must be a valid point of the prime order subgroup
+    static const uint8_t C_ORDER[] = {
+        0x10, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        0x14, 0xDE, 0xF9, 0xDE, 0xA2, 0xF7, 0x9C, 0xD6, 0x58, 0x12, 0x63, 0x1A, 0x5C, 0xF5, 0xD3, 0xED
+    };
+    elliptic_curve_scalar_t l;
+    os_memmove(l.data, C_ORDER, sizeof(l.data));
+
+    for (uint8_t i = 0; i < 8; ++i)
+    {
+        elliptic_curve_point_t p;
+        elliptic_curve_point_t good;
+        elliptic_curve_point_t identity;
+        fast_hash(&i, sizeof(i), (hash_t*)&p);
+        hash_point_to_good_point(&p, &good);
+        ecmul(&good, &l, &identity);
+        CHECK(equals_hex(identity.data, 32, "0100000000000000000000000000000000000000000000000000000000000000"));
+    }
+}
+
+static
+uint16_t exchange(const host_apdu_t* apdu, uint8_t* resp, size_t* resp_len)
+{
+    uint8_t buf[512];
+    const size_t len = bytecoin_host_exchange(apdu->data, apdu->length, buf, sizeof(buf));
+    if (resp)
+        os_memmove(resp, buf, len);
+    if (resp_len)
+        *resp_len = len;
+    return host_response_sw(buf, len);
+}
+
+static const uint8_t G_arg[] = { 's', 'e', 'l', 'f', 't', 'e', 's', 't' };
+
+typedef enum input_form_e
+{
+    INPUT_START_INDEXES_FINISH,
+    INPUT_COMBINED,
+    INPUT_COMBINED_CHAINED,
+    INPUT_VARINTS,
+} input_form_t;
+
+// one input of 1000 to an unlinkable address (400) and change (400), returns the
+// status word of the last output, which waits for the user, and the response
+// to the first output when first_output is not NULL
+static
+uint16_t add_inputs_and_outputs(input_form_t form, uint8_t* first_output)
+{
+    const uint8_t* arg = G_arg;
+    const size_t arg_size = sizeof(G_arg);
+    elliptic_curve_scalar_t s;
+    elliptic_curve_point_t address_s, address_s_v;
+    hash_to_scalar("S", 1, &s);
+    ecmul_G(&s, &address_s);
+    hash_to_scalar("V", 1, &s);
+    ecmul_G(&s, &address_s_v);
+
+    host_apdu_t apdu;
+    uint8_t resp[512];
+    size_t resp_len;
+    uint16_t sw = 0;
+
+    host_apdu_begin(&apdu, INS_SIG_START, 0, 0);
+    host_apdu_put_var(&apdu, 1, 4);  // version
+    host_apdu_put_var(&apdu, 0, 8);  // unlock time
+    host_apdu_put_var(&apdu, 1, 4);  // inputs
+    host_apdu_put_var(&apdu, 2, 4);  // outputs
+    host_apdu_put_var(&apdu, 3, 4);  // extra
+    CHECK(exchange(&apdu, NULL, NULL) == SW_NO_ERROR);
+
+    if (form == INPUT_START_INDEXES_FINISH)
+    {
+        host_apdu_begin(&apdu, INS_SIG_ADD_INPUT_START, 0, 0);
+        host_apdu_put_var(&apdu, 1000, 8);
+        host_apdu_put_var(&apdu, 2, 4);
+        CHECK(exchange(&apdu, NULL, NULL) == SW_NO_ERROR);
+
+        host_apdu_begin(&apdu, INS_SIG_ADD_INPUT_INDEXES, 0, 0);
+        host_apdu_put_var(&apdu, 2, 1);
+        host_apdu_put_var(&apdu, 5, 4);
+        host_apdu_put_var(&apdu, 300, 4);
+        CHECK(exchange(&apdu, NULL, NULL) == SW_NO_ERROR);
+
+        host_apdu_begin(&apdu, INS_SIG_ADD_INPUT_FINISH, 0, 0);
+    }
+    else if (form == INPUT_VARINTS)
+    {
+        host_apdu_begin(&apdu, INS_SIG_ADD_INPUT_VARINTS, 0, 0);
+        host_apdu_put_var(&apdu, 1000, 8);
+        host_apdu_put_var(&apdu, 2, 1);
+        host_apdu_put_bytes(&apdu, "\x05\xac\x02", 3); // 5 and 300
+    }
+    else
+    {
+        host_apdu_begin(&apdu, INS_SIG_ADD_INPUT, 0, 0);
+        host_apdu_put_var(&apdu, 1000, 8);
+        host_apdu_put_var(&apdu, 2, 1);
+        host_apdu_put_var(&apdu, 5, 4);
+        if (form == INPUT_COMBINED_CHAINED)
+        {
+            // the second index and the key image arguments in the last APDU
+            apdu.data[0] |= CHAINING_BIT;
+            CHECK(exchange(&apdu, NULL, NULL) == SW_NO_ERROR);
+            host_apdu_begin(&apdu, INS_SIG_ADD_INPUT, 0, 0);
+        }
+        host_apdu_put_var(&apdu, 300, 4);
+    }
+    host_apdu_put_var(&apdu, arg_size, 1);
+    host_apdu_put_bytes(&apdu, arg, arg_size);
+    host_apdu_put_var(&apdu, 0, 4);
+    CHECK(exchange(&apdu, NULL, NULL) == SW_NO_ERROR);
+
+    for (int i = 0; i < 2; ++i)
+    {
+        host_apdu_begin(&apdu, INS_SIG_ADD_OUPUT, 0, 0);
+        host_apdu_put_var(&apdu, i, 1);     // change
+        host_apdu_put_var(&apdu, 400, 8);
+        host_apdu_put_var(&apdu, 0, 4);     // change address index
+        host_apdu_put_var(&apdu, 1, 1);     // unlinkable
+        host_apdu_put_point(&apdu, &address_s);
+        host_apdu_put_point(&apdu, &address_s_v);
+        sw = exchange(&apdu, resp, &resp_len);
+        if (i == 0)
+            CHECK(sw == SW_NO_ERROR && resp_len == 65 + 2);
+        if (i == 0 && first_output)
+            os_memmove(first_output, resp, 65);
+    }
+    return sw;
+}
+
+static
+void test_signing(void)
+{
+    const uint8_t* arg = G_arg;
+    const size_t arg_size = sizeof(G_arg);
+    host_apdu_t apdu;
+    uint8_t resp[512];
+    size_t resp_len;
+
+    host_apdu_begin(&apdu, INS_GET_APP_INFO, 0, 0);
+    CHECK(exchange(&apdu, resp, &resp_len) == SW_NO_ERROR);
+    CHECK(resp_len > 5 && resp[0] == BYTECOIN_VERSION_M);
+
+    uint8_t output[65], combined_output[65];
+    CHECK(add_inputs_and_outputs(INPUT_START_INDEXES_FINISH, output) == SW_NO_ERROR);
+
+    // the extra chained over two APDUs, without the length
+    host_apdu_begin(&apdu, INS_SIG_ADD_EXTRA, 0, 0);
+    apdu.data[0] |= CHAINING_BIT;
+    host_apdu_put_bytes(&apdu, "x", 1);
+    CHECK(exchange(&apdu, NULL, NULL) == SW_NO_ERROR);
+    host_apdu_begin(&apdu, INS_SIG_ADD_EXTRA, 0, 0);
+    host_apdu_put_bytes(&apdu, "yz", 2);
+    CHECK(exchange(&apdu, NULL, NULL) == SW_NO_ERROR);
+
+    host_apdu_begin(&apdu, INS_SIG_STEP_A, 0, 0);
+    host_apdu_put_var(&apdu, arg_size, 1);
+    host_apdu_put_bytes(&apdu, arg, arg_size);
+    host_apdu_put_var(&apdu, 0, 4);
+    CHECK(exchange(&apdu, resp, &resp_len) == SW_NO_ERROR);
+    CHECK(resp_len == 3 * 32 + 2);
+
+    host_apdu_begin(&apdu, INS_SIG_STEP_A_MORE_DATA, 0, 0);
+    host_apdu_put_var(&apdu, 32, 1);
+    host_apdu_put_bytes(&apdu, resp, 32);
+    CHECK(exchange(&apdu, NULL, NULL) == SW_NO_ERROR);
+
+    host_apdu_begin(&apdu, INS_SIG_GET_C0, 0, 0);
+    CHECK(exchange(&apdu, resp, &resp_len) == SW_NO_ERROR);
+    CHECK(resp_len == 32 + 2);
+
+    elliptic_curve_scalar_t my_c;
+    hash_to_scalar("c", 1, &my_c);
+    host_apdu_begin(&apdu, INS_SIG_STEP_B, 0, 0);
+    host_apdu_put_var(&apdu, arg_size, 1);
+    host_apdu_put_bytes(&apdu, arg, arg_size);
+    host_apdu_put_var(&apdu, 0, 4);
+    host_apdu_put_scalar(&apdu, &my_c);
+    CHECK(exchange(&apdu, resp, &resp_len) == SW_NO_ERROR);
+    CHECK(resp_len == 4 * 32 + 2);
+    CHECK(!cx_math_is_zero(resp + 3 * 32, 32)); // e_key is released after the last input
+
+    // out of order call is rejected and does not break the main loop
+    host_apdu_begin(&apdu, INS_SIG_GET_C0, 0, 0);
+    CHECK(exchange(&apdu, NULL, NULL) == SW_COMMAND_NOT_ALLOWED);
+    host_apdu_begin(&apdu, 0x10, 0, 0);
+    CHECK(exchange(&apdu, NULL, NULL) == SW_INS_NOT_SUPPORTED);
+
+    // the handlers that do not stream get a chained command whole
+    uint8_t whole[512], chained[512];
+    size_t whole_len, chained_len;
+    const bytecoin_generate_keyimage_cmd_t keyimage = { { G_arg, sizeof(G_arg) }, 0 };
+    host_apdu_encode_generate_keyimage(&apdu, &keyimage);
+    CHECK(exchange(&apdu, whole, &whole_len) == SW_NO_ERROR);
+    host_apdu_t piece;
+    host_apdu_begin(&piece, INS_GENERATE_KEYIMAGE, 0, 0);
+    piece.data[0] |= CHAINING_BIT;
+    host_apdu_put_bytes(&piece, apdu.data + 5, 3);
+    CHECK(exchange(&piece, chained, &chained_len) == SW_NO_ERROR && chained_len == 2);
+    host_apdu_begin(&piece, INS_GENERATE_KEYIMAGE, 0, 0);
+    host_apdu_put_bytes(&piece, apdu.data + 5 + 3, apdu.length - 5 - 3);
+    CHECK(exchange(&piece, chained, &chained_len) == SW_NO_ERROR);
+    CHECK(chained_len == whole_len && !memcmp(whole, chained, whole_len));
+
+    // an APDU that would reach the bytes gathered before fails, a failure ends the chain
+    const uint8_t zeros[255] = { 0 };
+    host_apdu_begin(&piece, INS_GENERATE_KEYIMAGE, 0, 0);
+    piece.data[0] |= CHAINING_BIT;
+    host_apdu_put_bytes(&piece, zeros, 100);
+    CHECK(exchange(&piece, NULL, NULL) == SW_NO_ERROR);
+    host_apdu_begin(&piece, INS_GENERATE_KEYIMAGE, 0, 0);
+    host_apdu_put_bytes(&piece, zeros, 255);
+    CHECK(exchange(&piece, NULL, NULL) == SW_NOT_ENOUGH_MEMORY);
+    CHECK(exchange(&apdu, chained, &chained_len) == SW_NO_ERROR);
+    CHECK(chained_len == whole_len && !memcmp(whole, chained, whole_len));
+
+    // sig_add_input hashes the input the same way, whole, chained or with varints
+    CHECK(add_inputs_and_outputs(INPUT_COMBINED, combined_output) == SW_NO_ERROR);
+    CHECK(!memcmp(output, combined_output, sizeof(output)));
+    CHECK(add_inputs_and_outputs(INPUT_COMBINED_CHAINED, combined_output) == SW_NO_ERROR);
+    CHECK(!memcmp(output, combined_output, sizeof(output)));
+    CHECK(add_inputs_and_outputs(INPUT_VARINTS, combined_output) == SW_NO_ERROR);
+    CHECK(!memcmp(output, combined_output, sizeof(output)));
+
+    // an index has one encoding only, 85 00 is not 5
+    const bytecoin_sig_start_cmd_t start = { 1, 0, 1, 1, 0 };
+    host_apdu_encode_sig_start(&apdu, &start);
+    CHECK(exchange(&apdu, NULL, NULL) == SW_NO_ERROR);
+    host_apdu_begin(&apdu, INS_SIG_ADD_INPUT_VARINTS, 0, 0);
+    host_apdu_put_var(&apdu, 1000, 8);
+    host_apdu_put_var(&apdu, 1, 1);
+    host_apdu_put_bytes(&apdu, "\x85\x00", 2);
+    host_apdu_put_var(&apdu, sizeof(G_arg), 1);
+    host_apdu_put_bytes(&apdu, G_arg, sizeof(G_arg));
+    host_apdu_put_var(&apdu, 0, 4);
+    CHECK(exchange(&apdu, NULL, NULL) == SW_WRONG_DATA);
+}
+
+// a transaction of one input and count outputs of 100, the last is change
+static
+void start_outputs(uint32_t count)
+{
+    host_apdu_t apdu;
+    const bytecoin_sig_start_cmd_t start = { 1, 0, 1, count, 0 };
+    host_apdu_encode_sig_start(&apdu, &start);
+    CHECK(exchange(&apdu, NULL, NULL) == SW_NO_ERROR);
+    const uint8_t indexes[4] = { 0, 0, 0, 5 };
+    const bytecoin_sig_add_input_cmd_t input = { 1000, { indexes, 1 }, { G_arg, sizeof(G_arg) }, 0 };
+    host_apdu_encode_sig_add_input(&apdu, &input);
+    CHECK(exchange(&apdu, NULL, NULL) == SW_NO_ERROR);
+}
+
+static
+void test_add_outputs(void)
+{
+    elliptic_curve_scalar_t s;
+    elliptic_curve_point_t address_s, address_s_v;
+    hash_to_scalar("S", 1, &s);
+    ecmul_G(&s, &address_s);
+    hash_to_scalar("V", 1, &s);
+    ecmul_G(&s, &address_s_v);
+
+    host_apdu_t apdu;
+    uint8_t single[5 * 65], resp[512];
+    size_t resp_len;
+
+    start_outputs(5);
+    for (int i = 0; i < 5; ++i)
+    {
+        const bytecoin_sig_add_output_cmd_t output = { i == 4, 100, 0, 1, &address_s, &address_s_v };
+        host_apdu_encode_sig_add_output(&apdu, &output);
+        CHECK(exchange(&apdu, resp, &resp_len) == SW_NO_ERROR && resp_len == 65 + 2);
+        os_memmove(single + 65 * i, resp, 65);
+    }
+
+    // three outputs answer the command, the other two INS_GET_RESPONSE
+    start_outputs(5);
+    uint8_t items[5 * BYTECOIN_SIG_ADD_OUTPUTS_ITEM_SIZE] = { 0 };
+    for (int i = 0; i < 5; ++i)
+    {
+        items[i * BYTECOIN_SIG_ADD_OUTPUTS_ITEM_SIZE] = (i == 4);
+        items[i * BYTECOIN_SIG_ADD_OUTPUTS_ITEM_SIZE + 8] = 100;
+    }
+    const bytecoin_sig_add_outputs_cmd_t outputs = { 1, &address_s, &address_s_v, { items, sizeof(items) } };
+    host_apdu_encode_sig_add_outputs(&apdu, &outputs);
+    CHECK(exchange(&apdu, resp, &resp_len) == (SW_BYTES_REMAINING_00 | 2 * 65));
+    CHECK(resp_len == 3 * 65 + 2 && !memcmp(resp, single, 3 * 65));
+    host_apdu_encode_get_response(&apdu);
+    CHECK(exchange(&apdu, resp, &resp_len) == SW_NO_ERROR);
+    CHECK(resp_len == 2 * 65 + 2 && !memcmp(resp, single + 3 * 65, 2 * 65));
+    CHECK(exchange(&apdu, NULL, NULL) == SW_CONDITIONS_NOT_SATISFIED);
+}
+
+// a transaction of two inputs and one output up to step A, the inputs answer
+// their tokens unless tokens is NULL
+static
+void start_step_a(uint8_t (*tokens)[BYTECOIN_INPUT_TOKEN_SIZE])
+{
+    uint8_t resp[512];
+    size_t resp_len;
+    host_apdu_t apdu;
+    const bytecoin_sig_start_cmd_t start = { 1, 0, 2, 1, 0 };
+    host_apdu_encode_sig_start(&apdu, &start);
+    CHECK(exchange(&apdu, NULL, NULL) == SW_NO_ERROR);
+    const uint8_t indexes[4] = { 0, 0, 0, 5 };
+    for (uint32_t i = 0; i < 2; ++i)
+    {
+        const bytecoin_sig_add_input_cmd_t input = { 1000, { indexes, 1 }, { G_arg, sizeof(G_arg) }, i };
+        host_apdu_encode_sig_add_input(&apdu, &input);
+        if (tokens)
+            apdu.data[2] = P1_INPUT_TOKEN;
+        CHECK(exchange(&apdu, resp, &resp_len) == SW_NO_ERROR);
+        CHECK(resp_len == (tokens ? BYTECOIN_INPUT_TOKEN_SIZE : 0) + 2);
+        if (tokens)
+            os_memmove(tokens[i], resp, BYTECOIN_INPUT_TOKEN_SIZE);
+    }
+    elliptic_curve_scalar_t s;
+    elliptic_curve_point_t address_s, address_s_v;
+    hash_to_scalar("S", 1, &s);
+    ecmul_G(&s, &address_s);
+    hash_to_scalar("V", 1, &s);
+    ecmul_G(&s, &address_s_v);
+    const bytecoin_sig_add_output_cmd_t output = { 0, 2000, 0, 1, &address_s, &address_s_v };
+    host_apdu_encode_sig_add_output(&apdu, &output);
+    CHECK(exchange(&apdu, NULL, NULL) == SW_NO_ERROR);
+    const bytecoin_sig_add_extra_cmd_t extra = { { NULL, 0 } };
+    host_apdu_encode_sig_add_extra(&apdu, &extra);
+    CHECK(exchange(&apdu, NULL, NULL) == SW_NO_ERROR);
+}
+
+static
+void test_step_a_inputs(void)
+{
+    host_apdu_t apdu;
+    uint8_t single[2 * 3 * 32 + 32], resp[512];
+    size_t resp_len;
+    const uint8_t ring[3] = { 1, 2, 3 };
+
+    start_step_a(NULL);
+    for (uint32_t i = 0; i < 2; ++i)
+    {
+        const bytecoin_sig_step_a_cmd_t step_a = { { G_arg, sizeof(G_arg) }, i };
+        host_apdu_encode_sig_step_a(&apdu, &step_a);
+        CHECK(exchange(&apdu, resp, &resp_len) == SW_NO_ERROR && resp_len == 3 * 32 + 2);
+        os_memmove(single + 3 * 32 * i, resp, 3 * 32);
+        const bytecoin_sig_step_a_more_data_cmd_t more = { { ring, sizeof(ring) } };
+        host_apdu_encode_sig_step_a_more_data(&apdu, &more);
+        CHECK(exchange(&apdu, NULL, NULL) == SW_NO_ERROR);
+    }
+    host_apdu_encode_sig_get_c0(&apdu);
+    CHECK(exchange(&apdu, resp, &resp_len) == SW_NO_ERROR);
+    os_memmove(single + 2 * 3 * 32, resp, 32);
+
+    // the same hashes with the ring data of the second input split
+    start_step_a(NULL);
+    uint8_t inputs[64] = { 0 };
+    size_t length = 0;
+    for (uint32_t i = 0; i < 2; ++i)
+    {
+        inputs[length++] = sizeof(G_arg);
+        os_memmove(inputs + length, G_arg, sizeof(G_arg));
+        length += sizeof(G_arg);
+        inputs[length + 3] = i;
+        length += 4;
+        const uint8_t len = i ? 1 : sizeof(ring);
+        inputs[length++] = len;
+        os_memmove(inputs + length, ring, len);
+        length += len;
+    }
+    const bytecoin_sig_step_a_inputs_cmd_t cmd = { { inputs, length } };
+    host_apdu_encode_sig_step_a_inputs(&apdu, &cmd);
+    CHECK(exchange(&apdu, resp, &resp_len) == SW_NO_ERROR);
+    CHECK(resp_len == 2 * 3 * 32 + 2 && !memcmp(resp, single, 2 * 3 * 32));
+    const bytecoin_sig_step_a_more_data_cmd_t more = { { ring + 1, sizeof(ring) - 1 } };
+    host_apdu_encode_sig_step_a_more_data(&apdu, &more);
+    CHECK(exchange(&apdu, NULL, NULL) == SW_NO_ERROR);
+    host_apdu_encode_sig_get_c0(&apdu);
+    CHECK(exchange(&apdu, resp, &resp_len) == SW_NO_ERROR && !memcmp(resp, single + 2 * 3 * 32, 32));
+
+    // a cut input and more inputs than remain are rejected before anything is hashed
+    start_step_a(NULL);
+    const bytecoin_sig_step_a_inputs_cmd_t cut = { { inputs, length - 4 } };
+    host_apdu_encode_sig_step_a_inputs(&apdu, &cut);
+    CHECK((exchange(&apdu, NULL, NULL) & 0xFF00) == SW_WRONG_LENGTH);
+    const bytecoin_sig_step_a_inputs_cmd_t first = { { inputs, 1 + sizeof(G_arg) + 4 + 1 + sizeof(ring) } };
+    host_apdu_encode_sig_step_a_inputs(&apdu, &first);
+    CHECK(exchange(&apdu, NULL, NULL) == SW_NO_ERROR);
+    host_apdu_encode_sig_step_a_inputs(&apdu, &cmd);
+    CHECK(exchange(&apdu, NULL, NULL) == SW_WRONG_DATA);
+    start_step_a(NULL);
+    host_apdu_encode_sig_step_a_inputs(&apdu, &cmd);
+    CHECK(exchange(&apdu, NULL, NULL) == SW_NO_ERROR);
+    host_apdu_encode_sig_get_c0(&apdu);
+    CHECK(exchange(&apdu, NULL, NULL) == SW_NO_ERROR);
+}
+
+// the same transaction up to step B, without ring data
+static
+void start_step_b(void)
+{
+    start_step_a(NULL);
+    host_apdu_t apdu;
+    uint8_t inputs[2 * (1 + sizeof(G_arg) + 4 + 1)] = { 0 };
+    for (uint32_t i = 0; i < 2; ++i)
+    {
+        uint8_t* input = inputs + i * sizeof(inputs) / 2;
+        input[0] = sizeof(G_arg);
+        os_memmove(input + 1, G_arg, sizeof(G_arg));
+        input[1 + sizeof(G_arg) + 3] = i;
+    }
+    const bytecoin_sig_step_a_inputs_cmd_t cmd = { { inputs, sizeof(inputs) } };
+    host_apdu_encode_sig_step_a_inputs(&apdu, &cmd);
+    CHECK(exchange(&apdu, NULL, NULL) == SW_NO_ERROR);
+    host_apdu_encode_sig_get_c0(&apdu);
+    CHECK(exchange(&apdu, NULL, NULL) == SW_NO_ERROR);
+}
+
+static
+void test_step_b_inputs(void)
+{
+    host_apdu_t apdu;
+    uint8_t single[2 * 3 * 32 + 32], resp[512];
+    size_t resp_len;
+    elliptic_curve_scalar_t my_c[2];
+    hash_to_scalar("c", 1, &my_c[0]);
+    hash_to_scalar("d", 1, &my_c[1]);
+
+    start_step_b();
+    for (uint32_t i = 0; i < 2; ++i)
+    {
+        const bytecoin_sig_step_b_cmd_t step_b = { { G_arg, sizeof(G_arg) }, i, &my_c[i] };
+        host_apdu_encode_sig_step_b(&apdu, &step_b);
+        CHECK(exchange(&apdu, resp, &resp_len) == SW_NO_ERROR && resp_len == 4 * 32 + 2);
+        os_memmove(single + 3 * 32 * i, resp, 3 * 32);
+    }
+    os_memmove(single + 2 * 3 * 32, resp + 3 * 32, 32);
+    CHECK(!cx_math_is_zero(single + 2 * 3 * 32, 32));
+
+    // the same scalars, e_key once after the last input
+    start_step_b();
+    uint8_t inputs[2 * (1 + sizeof(G_arg) + 4 + 32)] = { 0 };
+    for (uint32_t i = 0; i < 2; ++i)
+    {
+        uint8_t* input = inputs + i * sizeof(inputs) / 2;
+        input[0] = sizeof(G_arg);
+        os_memmove(input + 1, G_arg, sizeof(G_arg));
+        input[1 + sizeof(G_arg) + 3] = i;
+        reverse(input + 1 + sizeof(G_arg) + 4, my_c[i].data, 32);
+    }
+    const bytecoin_sig_step_b_inputs_cmd_t cmd = { { inputs, sizeof(inputs) } };
+    host_apdu_encode_sig_step_b_inputs(&apdu, &cmd);
+    CHECK(exchange(&apdu, resp, &resp_len) == SW_NO_ERROR);
+    CHECK(resp_len == sizeof(single) + 2 && !memcmp(resp, single, sizeof(single)));
+    CHECK(exchange(&apdu, NULL, NULL) == SW_COMMAND_NOT_ALLOWED);
+
+    // one key stream per input encrypts the same scalars
+    hash_t e_key;
+    os_memmove(e_key.data, single + 2 * 3 * 32, sizeof(e_key.data));
+    start_step_b();
+    apdu.data[2] = P1_STEP_B_KEY_STREAM;
+    CHECK(exchange(&apdu, resp, &resp_len) == SW_NO_ERROR);
+    CHECK(resp_len == sizeof(single) + 2 && !memcmp(resp + 2 * 3 * 32, e_key.data, sizeof(e_key.data)));
+    for (uint32_t i = 0; i < 2; ++i)
+    {
+        elliptic_curve_scalar_t scalars[3], streamed[3];
+        host_tx_decrypt_step_b(&e_key, i, false, single + 3 * 32 * i, scalars);
+        host_tx_decrypt_step_b(&e_key, i, true, resp + 3 * 32 * i, streamed);
+        CHECK(memcmp(single + 3 * 32 * i, resp + 3 * 32 * i, 3 * 32) && !memcmp(scalars, streamed, sizeof(scalars)));
+    }
+}
+
+static
+void test_input_tokens(void)
+{
+    host_apdu_t apdu;
+    uint8_t tokens[2][BYTECOIN_INPUT_TOKEN_SIZE];
+    uint8_t single[2 * 3 * 32 + 32 + 2 * 4 * 32], resp[512];
+    size_t resp_len;
+    elliptic_curve_scalar_t my_c;
+    hash_to_scalar("c", 1, &my_c);
+
+    start_step_a(NULL);
+    for (uint32_t i = 0; i < 2; ++i)
+    {
+        const bytecoin_sig_step_a_cmd_t step_a = { { G_arg, sizeof(G_arg) }, i };
+        host_apdu_encode_sig_step_a(&apdu, &step_a);
+        CHECK(exchange(&apdu, resp, &resp_len) == SW_NO_ERROR);
+        os_memmove(single + 3 * 32 * i, resp, 3 * 32);
+    }
+    host_apdu_encode_sig_get_c0(&apdu);
+    CHECK(exchange(&apdu, resp, &resp_len) == SW_NO_ERROR);
+    os_memmove(single + 2 * 3 * 32, resp, 32);
+    for (uint32_t i = 0; i < 2; ++i)
+    {
+        const bytecoin_sig_step_b_cmd_t step_b = { { G_arg, sizeof(G_arg) }, i, &my_c };
+        host_apdu_encode_sig_step_b(&apdu, &step_b);
+        CHECK(exchange(&apdu, resp, &resp_len) == SW_NO_ERROR);
+        os_memmove(single + 2 * 3 * 32 + 32 + 4 * 32 * i, resp, 4 * 32);
+    }
+
+    // the tokens give the same scalars, a token is only good for its input
+    start_step_a(tokens);
+    for (uint32_t i = 0; i < 2; ++i)
+    {
+        const bytecoin_sig_step_a_token_cmd_t other = { { tokens[1 - i], BYTECOIN_INPUT_TOKEN_SIZE } };
+        host_apdu_encode_sig_step_a_token(&apdu, &other);
+        CHECK(exchange(&apdu, NULL, NULL) == SW_WRONG_DATA);
+        tokens[i][0] ^= 1;
+        const bytecoin_sig_step_a_token_cmd_t tampered = { { tokens[i], BYTECOIN_INPUT_TOKEN_SIZE } };
+        host_apdu_encode_sig_step_a_token(&apdu, &tampered);
+        CHECK(exchange(&apdu, NULL, NULL) == SW_WRONG_DATA);
+        tokens[i][0] ^= 1;
+        const bytecoin_sig_step_a_token_cmd_t step_a = { { tokens[i], BYTECOIN_INPUT_TOKEN_SIZE } };
+        host_apdu_encode_sig_step_a_token(&apdu, &step_a);
+        CHECK(exchange(&apdu, resp, &resp_len) == SW_NO_ERROR);
+        CHECK(resp_len == 3 * 32 + 2 && !memcmp(resp, single + 3 * 32 * i, 3 * 32));
+    }
+    host_apdu_encode_sig_get_c0(&apdu);
+    CHECK(exchange(&apdu, resp, &resp_len) == SW_NO_ERROR && !memcmp(resp, single + 2 * 3 * 32, 32));
+    for (uint32_t i = 0; i < 2; ++i)
+    {
+        const bytecoin_sig_step_b_token_cmd_t step_b = { { tokens[i], BYTECOIN_INPUT_TOKEN_SIZE }, &my_c };
+        host_apdu_encode_sig_step_b_token(&apdu, &step_b);
+        CHECK(exchange(&apdu, resp, &resp_len) == SW_NO_ERROR);
+        CHECK(resp_len == 4 * 32 + 2 && !memcmp(resp, single + 2 * 3 * 32 + 32 + 4 * 32 * i, 4 * 32));
+    }
+}
+
+// the transaction of start_outputs(5) as an INS_SIG_PREFIX template
+static
+size_t put_prefix_template(uint8_t* prefix, const elliptic_curve_point_t* address_s, const elliptic_curve_point_t* address_s_v)
+{
+    size_t length = 0;
+    os_memmove(prefix, "\x01\x00\x01\x02\xe8\x07\x01\x05", 8); // version .. amount, ring of one
+    length += 8;
+    prefix[length++] = sizeof(G_arg);
+    os_memmove(prefix + length, G_arg, sizeof(G_arg));
+    length += sizeof(G_arg);
+    os_memset(prefix + length, 0, 4);
+    length += 4;
+    prefix[length++] = 5;
+    for (int i = 0; i < 5; ++i)
+    {
+        prefix[length++] = BYTECOIN_OUTPUT_KEY_TAG;
+        prefix[length++] = 100;
+        prefix[length++] = (i == 4);
+        if (i == 4)
+        {
+            os_memset(prefix + length, 0, 4);
+            length += 4;
+            continue;
+        }
+        prefix[length++] = 1;
+        os_memmove(prefix + length, address_s->data, 32);
+        os_memmove(prefix + length + 32, address_s_v->data, 32);
+        length += 2 * 32;
+    }
+    prefix[length++] = 0; // extra size
+    return length;
+}
+
+static
+uint16_t send_prefix(const uint8_t* data, size_t len, bool last, uint8_t* resp, size_t* resp_len)
+{
+    host_apdu_t apdu;
+    host_apdu_begin(&apdu, INS_SIG_PREFIX, 0, 0);
+    if (!last)
+        apdu.data[0] |= CHAINING_BIT;
+    host_apdu_put_bytes(&apdu, data, len);
+    return exchange(&apdu, resp, resp_len);
+}
+
+static
+void test_sig_prefix(void)
+{
+    elliptic_curve_scalar_t s;
+    elliptic_curve_point_t address_s, address_s_v;
+    hash_to_scalar("S", 1, &s);
+    ecmul_G(&s, &address_s);
+    hash_to_scalar("V", 1, &s);
+    ecmul_G(&s, &address_s_v);
+
+    host_apdu_t apdu;
+    uint8_t single[5 * 65], resp[512], prefix[320];
+    size_t resp_len;
+
+    start_outputs(5);
+    for (int i = 0; i < 5; ++i)
+    {
+        const bytecoin_sig_add_output_cmd_t output = { i == 4, 100, 0, 1, &address_s, &address_s_v };
+        host_apdu_encode_sig_add_output(&apdu, &output);
+        CHECK(exchange(&apdu, resp, &resp_len) == SW_NO_ERROR);
+        os_memmove(single + 65 * i, resp, 65);
+    }
+    const size_t length = put_prefix_template(prefix, &address_s, &address_s_v);
+    const size_t outputs = 8 + 1 + sizeof(G_arg) + 4 + 1;
+
+    // a varint must be minimal, the last APDU must end the template
+    CHECK(send_prefix((const uint8_t*)"\x81\x00", 2, false, NULL, NULL) == SW_WRONG_DATA);
+    CHECK(send_prefix(prefix, 5, true, NULL, NULL) == SW_WRONG_LENGTH);
+
+    // a piece completes at most BYTECOIN_PREFIX_OUTPUTS outputs, the next
+    // APDU starts a new stream
+    CHECK(send_prefix(prefix, outputs + 67, false, resp, &resp_len) == SW_NO_ERROR && resp_len == 2);
+    CHECK(send_prefix(prefix + outputs + 67, 3 * 68 + 1, false, NULL, NULL) == SW_NOT_ENOUGH_MEMORY);
+
+    // cut inside the input amount and inside the fourth output, the last
+    // output waits for the extra size
+    CHECK(send_prefix(prefix, 5, false, resp, &resp_len) == SW_NO_ERROR && resp_len == 2);
+    CHECK(send_prefix(prefix + 5, outputs + 3 * 68 + 10 - 5, false, resp, &resp_len) == SW_NO_ERROR);
+    CHECK(resp_len == 3 * 65 + 2 && !memcmp(resp, single, 3 * 65));
+    CHECK(send_prefix(prefix + outputs + 3 * 68 + 10, length - 1 - (outputs + 3 * 68 + 10), false, resp, &resp_len) == SW_NO_ERROR);
+    CHECK(resp_len == 65 + 2 && !memcmp(resp, single + 3 * 65, 65));
+    CHECK(send_prefix(prefix + length - 1, 1, true, resp, &resp_len) == SW_NO_ERROR);
+    CHECK(resp_len == 65 + 2 && !memcmp(resp, single + 4 * 65, 65));
+    const bytecoin_sig_add_extra_cmd_t extra = { { NULL, 0 } };
+    host_apdu_encode_sig_add_extra(&apdu, &extra);
+    CHECK(exchange(&apdu, NULL, NULL) == SW_NO_ERROR);
+}
+
+static
+uint32_t read_u32(const uint8_t* p)
+{
+    return (uint32_t)p[0] << 24 | (uint32_t)p[1] << 16 | (uint32_t)p[2] << 8 | p[3];
+}
+
+#ifdef BYTECOIN_STATS
+static
+void test_stats(void)
+{
+    host_apdu_t apdu;
+    uint8_t resp[512];
+    size_t resp_len;
+
+    // every full page is reset and skipped by the next call
+    host_apdu_begin(&apdu, INS_GET_STATS, 1, 0);
+    do
+        CHECK(exchange(&apdu, NULL, &resp_len) == SW_NO_ERROR);
+    while (resp_len == (0xFE - 2) / 15 * 15 + 2);
+
+    size_t app_info_len;
+    host_apdu_begin(&apdu, INS_GET_APP_INFO, 0, 0);
+    CHECK(exchange(&apdu, NULL, &app_info_len) == SW_NO_ERROR);
+    CHECK(exchange(&apdu, NULL, NULL) == SW_NO_ERROR);
+    host_apdu_begin(&apdu, INS_SIG_GET_C0, 0, 0);
+    CHECK(exchange(&apdu, NULL, NULL) == SW_COMMAND_NOT_ALLOWED);
+
+    // get_stats of the reset, sig_get_c0 and get_app_info in INS order
+    host_apdu_begin(&apdu, INS_GET_STATS, 0, INS_SIG_START);
+    CHECK(exchange(&apdu, resp, &resp_len) == SW_NO_ERROR);
+    CHECK(resp_len == 3 * 15 + 2);
+    const uint8_t* c0 = resp;
+    CHECK(c0[0] == INS_SIG_GET_C0 && read_u32(c0 + 1) == 1 && c0[5] == 0 && c0[6] == 1);
+    CHECK(read_u32(c0 + 7) == 0 && read_u32(c0 + 11) == 2);
+    const uint8_t* app_info = c0 + 15;
+    CHECK(app_info[0] == INS_GET_APP_INFO && read_u32(app_info + 1) == 2 && app_info[6] == 0);
+    CHECK(read_u32(app_info + 11) == 2 * app_info_len);
+    const uint8_t* get_stats = app_info + 15;
+    CHECK(get_stats[0] == INS_GET_STATS && read_u32(get_stats + 1) == 1);
+
+    // only the instructions in use have a slot, in INS order
+    CHECK(stats_slot(0x40) == 0 && stats_slot(INS_RESET) == 0);
+    for (uint8_t slot = 2; slot < BYTECOIN_STATS_SLOTS; ++slot)
+        CHECK(stats_slot_ins(slot - 1) < stats_slot_ins(slot) && stats_slot(stats_slot_ins(slot)) == slot);
+}
+#endif
+
+#ifdef BYTECOIN_CRYPTO_COUNTERS
+// the count of op in the previous command
+static
+uint16_t previous_crypto_count(uint8_t op)
+{
+    host_apdu_t apdu;
+    uint8_t resp[512];
+    size_t resp_len;
+    host_apdu_begin(&apdu, INS_GET_CRYPTO_COUNTERS, 0, 0);
+    CHECK(exchange(&apdu, resp, &resp_len) == SW_NO_ERROR);
+    return (uint16_t)(resp[1 + 2 * op] << 8 | resp[2 + 2 * op]);
+}
+
+// the step A and step B commands of a transaction of inputs_num inputs that
+// found the secrets of their input without running op
+static
+void count_input_cache_hits(uint32_t inputs_num, uint8_t op, uint32_t hits[2])
+{
+    host_apdu_t apdu;
+    const bytecoin_sig_start_cmd_t start = { 1, 0, inputs_num, 1, 0 };
+    host_apdu_encode_sig_start(&apdu, &start);
+    CHECK(exchange(&apdu, NULL, NULL) == SW_NO_ERROR);
+    const uint8_t indexes[4] = { 0, 0, 0, 5 };
+    for (uint32_t i = 0; i < inputs_num; ++i)
+    {
+        const bytecoin_sig_add_input_cmd_t input = { 1000, { indexes, 1 }, { G_arg, sizeof(G_arg) }, i };
+        host_apdu_encode_sig_add_input(&apdu, &input);
+        CHECK(exchange(&apdu, NULL, NULL) == SW_NO_ERROR);
+    }
+    elliptic_curve_scalar_t s;
+    elliptic_curve_point_t address_s, address_s_v;
+    hash_to_scalar("S", 1, &s);
+    ecmul_G(&s, &address_s);
+    hash_to_scalar("V", 1, &s);
+    ecmul_G(&s, &address_s_v);
+    const bytecoin_sig_add_output_cmd_t output = { 0, 1000 * inputs_num, 0, 1, &address_s, &address_s_v };
+    host_apdu_encode_sig_add_output(&apdu, &output);
+    CHECK(exchange(&apdu, NULL, NULL) == SW_NO_ERROR);
+    const bytecoin_sig_add_extra_cmd_t extra = { { NULL, 0 } };
+    host_apdu_encode_sig_add_extra(&apdu, &extra);
+    CHECK(exchange(&apdu, NULL, NULL) == SW_NO_ERROR);
+
+    hits[0] = hits[1] = 0;
+    for (uint32_t i = 0; i < inputs_num; ++i)
+    {
+        const bytecoin_sig_step_a_cmd_t step_a = { { G_arg, sizeof(G_arg) }, i };
+        host_apdu_encode_sig_step_a(&apdu, &step_a);
+        CHECK(exchange(&apdu, NULL, NULL) == SW_NO_ERROR);
+        hits[0] += !previous_crypto_count(op);
+    }
+    host_apdu_encode_sig_get_c0(&apdu);
+    CHECK(exchange(&apdu, NULL, NULL) == SW_NO_ERROR);
+    hash_to_scalar("c", 1, &s);
+    for (uint32_t i = 0; i < inputs_num; ++i)
+    {
+        const bytecoin_sig_step_b_cmd_t step_b = { { G_arg, sizeof(G_arg) }, i, &s };
+        host_apdu_encode_sig_step_b(&apdu, &step_b);
+        CHECK(exchange(&apdu, NULL, NULL) == SW_NO_ERROR);
+        hits[1] += !previous_crypto_count(op);
+    }
+}
+
+static
+void test_crypto_counters(void)
+{
+    host_apdu_t apdu;
+    uint8_t resp[512];
+    size_t resp_len;
+
+    host_apdu_begin(&apdu, INS_GENERATE_KEYIMAGE, 0, 0);
+    host_apdu_put_var(&apdu, 4, 1);
+    host_apdu_put_bytes(&apdu, "test", 4);
+    host_apdu_put_var(&apdu, 0, 4);
+    CHECK(exchange(&apdu, NULL, NULL) == SW_NO_ERROR);
+
+    host_apdu_begin(&apdu, INS_GET_CRYPTO_COUNTERS, 0, 0);
+    CHECK(exchange(&apdu, resp, &resp_len) == SW_NO_ERROR);
+    CHECK(resp_len == 1 + 2 * CRYPTO_OP_COUNT + 2 && resp[0] == CRYPTO_OP_COUNT);
+    const uint8_t* ge_fromfe = resp + 1 + 2 * CRYPTO_OP_GE_FROMFE_FROMBYTES;
+    CHECK(ge_fromfe[0] == 0 && ge_fromfe[1] == 1);
+
+    // counts of the previous command, which is the first query
+    CHECK(exchange(&apdu, resp, &resp_len) == SW_NO_ERROR);
+    CHECK(cx_math_is_zero(resp + 1, 2 * CRYPTO_OP_COUNT));
+
+    // step A finds the secrets of the inputs, unless their arguments changed
+    start_step_a(NULL);
+    for (uint32_t i = 0; i < 2; ++i)
+    {
+        const bytecoin_sig_step_a_cmd_t step_a = { { G_arg, sizeof(G_arg) }, i ? 7 : 0 };
+        host_apdu_encode_sig_step_a(&apdu, &step_a);
+        CHECK(exchange(&apdu, NULL, NULL) == SW_NO_ERROR);
+        host_apdu_begin(&apdu, INS_GET_CRYPTO_COUNTERS, 0, 0);
+        CHECK(exchange(&apdu, resp, &resp_len) == SW_NO_ERROR);
+        const uint8_t* invert32 = resp + 1 + 2 * CRYPTO_OP_INVERT32;
+        CHECK(invert32[0] == 0 && invert32[1] == i);
+    }
+
+    // every input up to the size of the cache, in both steps
+    uint32_t hits[2];
+    count_input_cache_hits(3, CRYPTO_OP_INVERT32, hits);
+    CHECK(hits[0] == 3 && hits[1] == 3);
+    count_input_cache_hits(8, CRYPTO_OP_INVERT32, hits);
+    CHECK(hits[0] == BYTECOIN_INPUT_CACHE_SIZE && hits[1] == BYTECOIN_INPUT_CACHE_SIZE);
+
+    // nor does step A hash their points to the curve again, each input
+    // having its own key by its address index
+    count_input_cache_hits(3, CRYPTO_OP_GE_FROMFE_FROMBYTES, hits);
+    CHECK(hits[0] == 3);
+    count_input_cache_hits(8, CRYPTO_OP_GE_FROMFE_FROMBYTES, hits);
+    CHECK(hits[0] == BYTECOIN_INPUT_CACHE_SIZE);
+
+    // an output to a simple address hashes no point to the curve
+    start_outputs(2);
+    elliptic_curve_scalar_t s;
+    elliptic_curve_point_t address_s, address_s_v;
+    hash_to_scalar("S", 1, &s);
+    ecmul_G(&s, &address_s);
+    hash_to_scalar("V", 1, &s);
+    ecmul_G(&s, &address_s_v);
+    for (uint8_t tag = 0; tag < 2; ++tag)
+    {
+        const bytecoin_sig_add_output_cmd_t output = { tag, 100, 0, tag, &address_s, &address_s_v };
+        host_apdu_encode_sig_add_output(&apdu, &output);
+        CHECK(exchange(&apdu, NULL, NULL) == SW_NO_ERROR);
+        host_apdu_begin(&apdu, INS_GET_CRYPTO_COUNTERS, 0, 0);
+        CHECK(exchange(&apdu, resp, &resp_len) == SW_NO_ERROR);
+        CHECK(ge_fromfe[0] == 0 && ge_fromfe[1] == tag);
+    }
+}
+#endif
+
+static
+void record_screen(void* ctx, const host_ui_screen_t* screen)
+{
+    *(host_ui_screen_t*)ctx = *screen;
+}
+
+static
+void test_ui(void)
+{
+    host_ui_t* ui = &G_host_device.ui;
+    host_ui_screen_t screen;
+    ui->on_screen = record_screen;
+    ui->ctx = &screen;
+
+    CHECK(!host_ui_set_script(ui, "approve:x"));
+    CHECK(!host_ui_set_script(ui, "press"));
+    CHECK(host_ui_set_script(ui, "reject:1,approve"));
+    CHECK(ui->steps_count == 2 && ui->steps[0].delay_ms == 1);
+
+    os_memset(&screen, 0, sizeof(screen));
+    CHECK(add_inputs_and_outputs(INPUT_START_INDEXES_FINISH, NULL) == SW_SECURITY_STATUS_NOT_SATISFIED);
+    CHECK(screen.name && !strcmp(screen.name, "confirm_tx") && screen.lines_count == 3);
+    CHECK(!strncmp(screen.lines[0], "Recipient address: bcnZ", 23));
+    CHECK(!strcmp(screen.lines[1], "Amount: 0.00000400 BCN"));
+    CHECK(!strcmp(screen.lines[2], "Fee: 0.00000200 BCN"));
+    CHECK(screen.step.action == HOST_UI_REJECT);
+
+    // a rejected transaction is started over, the next step approves it
+    CHECK(add_inputs_and_outputs(INPUT_START_INDEXES_FINISH, NULL) == SW_NO_ERROR);
+    CHECK(screen.step.action == HOST_UI_APPROVE);
+
+    host_ui_set_script(ui, "");
+    ui->on_screen = NULL;
+}
+
+static
+void test_schema(void)
+{
+    host_apdu_t apdu;
+    uint8_t plain[512], trailing[512];
+    size_t plain_len, trailing_len;
+
+    // bytes after the fields are ignored, as before the schema
+    host_apdu_encode_get_app_info(&apdu);
+    CHECK(exchange(&apdu, plain, &plain_len) == SW_NO_ERROR);
+    host_apdu_put_var(&apdu, 0, 1);
+    CHECK(exchange(&apdu, trailing, &trailing_len) == SW_NO_ERROR);
+    CHECK(trailing_len == plain_len && !memcmp(plain, trailing, plain_len));
+
+    // the signing state comes before the payload
+    host_apdu_begin(&apdu, INS_SIG_STEP_B, 0, 0);
+    CHECK(exchange(&apdu, NULL, NULL) == SW_COMMAND_NOT_ALLOWED);
+
+    // a count over the maximum, the encoders refuse to write it
+    host_apdu_begin(&apdu, INS_SCAN_OUTPUTS, 0, 0);
+    host_apdu_put_var(&apdu, BYTECOIN_MAX_SCAN_OUTPUTS + 1, 1);
+    CHECK(exchange(&apdu, NULL, NULL) == SW_NOT_ENOUGH_MEMORY);
+}
+
+static
+void test_last_response(void)
+{
+    host_apdu_t apdu;
+    uint8_t first[512], again[512];
+    size_t first_len, again_len;
+
+    // the sequence numbers restart after a reset
+    host_apdu_encode_reset(&apdu);
+    CHECK(exchange(&apdu, NULL, NULL) == SW_NO_ERROR);
+    const bytecoin_generate_keyimage_cmd_t keyimage = { { G_arg, sizeof(G_arg) }, 0 };
+    host_apdu_encode_generate_keyimage(&apdu, &keyimage);
+    CHECK(exchange(&apdu, first, &first_len) == SW_NO_ERROR);
+
+    host_apdu_encode_get_last_response(&apdu);
+    apdu.data[3] = 1;
+    CHECK(exchange(&apdu, again, &again_len) == SW_NO_ERROR);
+    CHECK(again_len == first_len && !memcmp(first, again, first_len));
+    apdu.data[3] = 2;
+    CHECK(exchange(&apdu, NULL, NULL) == SW_WRONG_DATA);
+
+    // the response waits at the end of the io buffer, past a failed request
+    // and out of reach of a full APDU
+    apdu.data[3] = 1;
+    for (int i = 0; i < 255; ++i)
+        host_apdu_put_var(&apdu, i, 1);
+    CHECK(exchange(&apdu, again, &again_len) == SW_NO_ERROR);
+    CHECK(again_len == first_len && !memcmp(first, again, first_len));
+
+    // too long to be kept
+    const elliptic_curve_point_t keys[BYTECOIN_MAX_SCAN_OUTPUTS] = { { { 0 } } };
+    const bytecoin_scan_outputs_cmd_t scan = { { keys, BYTECOIN_MAX_SCAN_OUTPUTS } };
+    host_apdu_encode_scan_outputs(&apdu, &scan);
+    exchange(&apdu, NULL, NULL);
+    host_apdu_encode_get_last_response(&apdu);
+    apdu.data[3] = 2;
+    CHECK(exchange(&apdu, NULL, NULL) == SW_CONDITIONS_NOT_SATISFIED);
+}
+
+static
+void test_batch(void)
+{
+    host_apdu_t apdu;
+    uint8_t single[512], resp[512];
+    size_t single_len, resp_len;
+    host_batch_item_t items[8];
+
+    host_apdu_begin(&apdu, INS_GET_APP_INFO, 0, 0);
+    CHECK(exchange(&apdu, single, &single_len) == SW_NO_ERROR);
+
+    // the responses are those of the single commands
+    host_apdu_begin(&apdu, INS_BATCH, 0, 0);
+    host_apdu_put_bytes(&apdu, "\x52\x00\x52\x00", 4); // get_app_info twice
+    CHECK(exchange(&apdu, resp, &resp_len) == SW_NO_ERROR);
+    CHECK(host_batch_parse(resp, resp_len, items, 8) == 2);
+    for (int i = 0; i < 2; ++i)
+    {
+        CHECK(items[i].sw == SW_NO_ERROR && items[i].length == single_len - 2);
+        CHECK(!memcmp(items[i].data, single, single_len - 2));
+    }
+
+    // stops after the failed sig_get_c0
+    host_apdu_begin(&apdu, INS_BATCH, 0, 0);
+    host_apdu_put_bytes(&apdu, "\x52\x00\x4c\x00\x52\x00", 6);
+    CHECK(exchange(&apdu, resp, &resp_len) == SW_NO_ERROR);
+    CHECK(host_batch_parse(resp, resp_len, items, 8) == 2);
+    CHECK(items[1].sw == SW_COMMAND_NOT_ALLOWED && items[1].length == 0);
+
+    // the export asks the user, it cannot be batched
+    host_apdu_begin(&apdu, INS_BATCH, 0, 0);
+    host_apdu_put_var(&apdu, INS_EXPORT_VIEW_ONLY, 1);
+    host_apdu_put_var(&apdu, 0, 1);
+    CHECK(exchange(&apdu, resp, &resp_len) == SW_NO_ERROR);
+    CHECK(host_batch_parse(resp, resp_len, items, 8) == 1 && items[0].sw == SW_COMMAND_NOT_ALLOWED);
+
+    host_apdu_begin(&apdu, INS_BATCH, 0, 0);
+    host_apdu_put_bytes(&apdu, "\x52\x02\x00", 3);
+    CHECK(exchange(&apdu, NULL, NULL) == SW_WRONG_LENGTH);
+}
+
+int main(void)
+{
+    bytecoin_host_init();
+
+    test_keccak();
+    test_points();
+    test_scalars();
+    test_hash_to_point();
+    test_signing();
+    test_ui();
+    test_schema();
+    test_last_response();
+    test_batch();
+    test_add_outputs();
+    test_step_a_inputs();
+    test_step_b_inputs();
+    test_input_tokens();
+    test_sig_prefix();
+#ifdef BYTECOIN_STATS
+    test_stats();
+#endif
+#ifdef BYTECOIN_CRYPTO_COUNTERS
+    test_crypto_counters();
+#endif
+
+    if (G_failures)
+    {
+        fprintf(stderr, "%d check(s) failed\n", G_failures);
+        return 1;
+    }
+    printf("all checks passed\n");
+    return 0;
+}
@@ -0,0 +1,214 @@
+/*******************************************************************************
+*   Bytecoin Wallet for Ledger Nano S
+*   (c) 2018 - 2019 The Bytecoin developers
+*
+*  Licensed under the Apache License, Version 2.0 (the "License");
+*  you may not use this file except in compliance with the License.
+*  You may obtain a copy of the License at
+*
+*      http://www.apache.org/licenses/LICENSE-2.0
+*
+*  Unless required by applicable law or agreed to in writing, software
+*  distributed under the License is distributed on an "AS IS" BASIS,
+*  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+*  See the License for the specific language governing permissions and
+*  limitations under the License.
+********************************************************************************/
+
+// Records and replays APDU traces, see bytecoin_host_trace.h for the format.
+//
+//   bytecoin_trace record [--scans N] [--keyimages N] [--inputs N] [--mixins N]
+//                         [--outputs N] [--extra N] [--addresses N]
+//       writes the trace of a synthetic sync and signing session to stdout
+//
+//   bytecoin_trace replay [--seed HEX] [--output FILE] TRACE
+//       feeds TRACE to dispatch(), reports every response that differs from
+//       the recorded one and compares the time spent per handler, exits with
+//       1 if any response differs. --output writes the replayed trace, e.g. to
+//       rebase a trace captured on a device with a different seed.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "os.h"
+#include "bytecoin_host.h"
+#include "bytecoin_host_trace.h"
+#include "bytecoin_host_tx.h"
+
+typedef struct handler_time_s
+{
+    uint64_t calls;
+    uint64_t recorded_ns;
+    uint64_t replayed_ns;
+} handler_time_t;
+
+static
+void usage(void)
+{
+    fprintf(stderr, "usage: bytecoin_trace record [--scans N] [--keyimages N] [--inputs N] [--mixins N] [--outputs N] [--extra N] [--addresses N]\n"
+                    "       bytecoin_trace replay [--seed HEX] [--output FILE] TRACE\n");
+    exit(2);
+}
+
+static
+int record(int argc, char** argv)
+{
+    uint32_t scans = 10;
+    uint32_t keyimages = 10;
+    host_tx_shape_t shape = { 2, 10, 2, 64, 1 };
+
+    for (int i = 0; i < argc; i += 2)
+    {
+        if (i + 1 == argc)
+            usage();
+        const uint32_t value = strtoul(argv[i + 1], NULL, 10);
+        if (!strcmp(argv[i], "--scans"))
+            scans = value;
+        else if (!strcmp(argv[i], "--keyimages"))
+            keyimages = value;
+        else if (!strcmp(argv[i], "--inputs"))
+            shape.inputs = value;
+        else if (!strcmp(argv[i], "--mixins"))
+            shape.mixins = value;
+        else if (!strcmp(argv[i], "--outputs"))
+            shape.outputs = value;
+        else if (!strcmp(argv[i], "--extra"))
+            shape.extra_size = value;
+        else if (!strcmp(argv[i], "--addresses"))
+            shape.addresses = value;
+        else
+            usage();
+    }
+
+    host_tx_apdus_t apdus = { 0 };
+    host_tx_generate_sync(scans, keyimages, shape.addresses, &apdus);
+    host_tx_generate(&shape, &apdus);
+
+    host_trace_t commands = { 0 };
+    for (size_t i = 0; i < apdus.count; ++i)
+        host_trace_add(&commands, apdus.items[i].apdu.data, apdus.items[i].apdu.length);
+    host_tx_apdus_free(&apdus);
+
+    host_trace_t trace = { 0 };
+    bytecoin_host_init();
+    host_trace_run(&commands, &trace);
+
+    printf("# bytecoin_trace record --scans %u --keyimages %u --inputs %u --mixins %u --outputs %u --extra %u --addresses %u\n",
+           scans, keyimages, shape.inputs, shape.mixins, shape.outputs, shape.extra_size, shape.addresses);
+    host_trace_save(&trace, stdout);
+    host_trace_free(&commands);
+    host_trace_free(&trace);
+    return 0;
+}
+
+static
+void print_diff(size_t index, const host_trace_entry_t* expected, const host_trace_entry_t* actual)
+{
+    fprintf(stderr, "exchange #%zu (%s) differs\n  expected ", index, host_ins_name(expected->command[1]));
+    for (size_t i = 0; i < expected->response_length; ++i)
+        fprintf(stderr, "%02x", expected->response[i]);
+    fprintf(stderr, "\n  actual   ");
+    for (size_t i = 0; i < actual->response_length; ++i)
+        fprintf(stderr, "%02x", actual->response[i]);
+    fprintf(stderr, "\n");
+}
+
+static
+int replay(int argc, char** argv)
+{
+    const char* path = NULL;
+    const char* output = NULL;
+    for (int i = 0; i < argc; ++i)
+    {
+        if (!strcmp(argv[i], "--output") && i + 1 < argc)
+            output = argv[++i];
+        else if (!strcmp(argv[i], "--seed") && i + 1 < argc)
+        {
+            const char* hex = argv[++i];
+            unsigned char seed[32];
+            if (strlen(hex) != 2 * sizeof(seed))
+                usage();
+            for (size_t j = 0; j < sizeof(seed); ++j)
+            {
+                unsigned int byte;
+                if (sscanf(hex + 2 * j, "%2x", &byte) != 1)
+                    usage();
+                seed[j] = (unsigned char)byte;
+            }
+            os_host_set_seed(seed);
+        }
+        else if (!path && argv[i][0] != '-')
+            path = argv[i];
+        else
+            usage();
+    }
+    if (!path)
+        usage();
+
+    host_trace_t expected = { 0 };
+    if (!host_trace_load(&expected, path))
+        return 1;
+
+    host_trace_t actual = { 0 };
+    bytecoin_host_init();
+    host_trace_run(&expected, &actual);
+
+    size_t compared = 0;
+    size_t differences = 0;
+    static handler_time_t handlers[256];
+    for (size_t i = 0; i < actual.count; ++i)
+    {
+        const host_trace_entry_t* e = &expected.entries[i];
+        const host_trace_entry_t* a = &actual.entries[i];
+        handler_time_t* handler = &handlers[a->command[1]];
+        handler->calls += 1;
+        handler->recorded_ns += e->elapsed_ns;
+        handler->replayed_ns += a->elapsed_ns;
+        if (!e->response_length)
+            continue;
+        ++compared;
+        if (e->response_length != a->response_length || os_memcmp(e->response, a->response, a->response_length))
+        {
+            ++differences;
+            print_diff(i, e, a);
+        }
+    }
+
+    printf("handler,calls,recorded_ms,replayed_ms\n");
+    for (int ins = 0; ins < 256; ++ins)
+        if (handlers[ins].calls)
+            printf("%s,%llu,%.3f,%.3f\n", host_ins_name(ins), (unsigned long long)handlers[ins].calls,
+                   handlers[ins].recorded_ns / 1e6, handlers[ins].replayed_ns / 1e6);
+    printf("# %zu exchanges replayed, %zu responses compared, %zu differ\n", actual.count, compared, differences);
+
+    if (output)
+    {
+        FILE* file = fopen(output, "w");
+        if (!file)
+        {
+            perror(output);
+            return 1;
+        }
+        host_trace_save(&actual, file);
+        fclose(file);
+    }
+
+    const bool complete = (actual.count == expected.count);
+    if (!complete)
+        fprintf(stderr, "the replay stopped after %zu of %zu exchanges\n", actual.count, expected.count);
+    host_trace_free(&expected);
+    host_trace_free(&actual);
+    return (differences || !complete) ? 1 : 0;
+}
+
+int main(int argc, char** argv)
+{
+    if (argc < 2)
+        usage();
+    if (!strcmp(argv[1], "record"))
+        return record(argc - 2, argv + 2);
+    if (!strcmp(argv[1], "replay"))
+        return replay(argc - 2, argv + 2);
+    usage();
+    return 2;
+}
@@ -0,0 +1,595 @@
+/*******************************************************************************
+*   Bytecoin Wallet for Ledger Nano S
+*   (c) 2018 - 2019 The Bytecoin developers
+*
+*  Licensed under the Apache License, Version 2.0 (the "License");
+*  you may not use this file except in compliance with the License.
+*  You may obtain a copy of the License at
+*
+*      http://www.apache.org/licenses/LICENSE-2.0
+*
+*  Unless required by applicable law or agreed to in writing, software
+*  distributed under the License is distributed on an "AS IS" BASIS,
+*  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+*  See the License for the specific language governing permissions and
+*  limitations under the License.
+********************************************************************************/
+
+// Software implementation of the cx_* calls used by the app. It favours
+// simplicity over speed and is NOT constant time: it exists so that the app
+// core can be exercised and measured on a host, never to hold real keys.
+
+#include "os.h"
+#include "cx.h"
+#include "host_syscalls.h"
+
+typedef struct bn_s
+{
+    uint32_t v[8]; // little-endian limbs
+} bn_t;
+
+typedef struct ge_s
+{
+    bn_t X;
+    bn_t Y;
+    bn_t Z;
+    bn_t T;
+} ge_t;
+
+// 2^255 - 19
+static const bn_t FE_P = {{
+    0xffffffed, 0xffffffff, 0xffffffff, 0xffffffff, 0xffffffff, 0xffffffff, 0xffffffff, 0x7fffffff
+}};
+
+// 2 * d, d = -121665 / 121666
+static const bn_t FE_D2 = {{
+    0x26b2f159, 0xebd69b94, 0x8283b156, 0x00e0149a, 0xeef3d130, 0x198e80f2, 0x56dffce7, 0x2406d9dc
+}};
+
+static const bn_t FE_D = {{
+    0x135978a3, 0x75eb4dca, 0x4141d8ab, 0x00700a4d, 0x7779e898, 0x8cc74079, 0x2b6ffe73, 0x52036cee
+}};
+
+static const bn_t FE_SQRTM1 = {{
+    0x4a0ea0b0, 0xc4ee1b27, 0xad2fe478, 0x2f431806, 0x3dfbd7a7, 0x2b4d0099, 0x4fc1df0b, 0x2b832480
+}};
+
+static const bn_t BN_ZERO = {{ 0 }};
+static const bn_t BN_ONE  = {{ 1 }};
+
+static
+void bn_from_be(bn_t* r, const unsigned char* buf, unsigned int len)
+{
+    if (len > 32)
+        THROW(INVALID_PARAMETER);
+    os_memset(r, 0, sizeof(*r));
+    for (unsigned int i = 0; i < len; ++i)
+        r->v[i / 4] |= (uint32_t)buf[len - 1 - i] << (8 * (i % 4));
+}
+
+static
+void bn_to_be(unsigned char* buf, unsigned int len, const bn_t* a)
+{
+    for (unsigned int i = 0; i < len; ++i)
+        buf[len - 1 - i] = (i < 32) ? (unsigned char)(a->v[i / 4] >> (8 * (i % 4))) : 0;
+}
+
+static
+int bn_cmp(const bn_t* a, const bn_t* b)
+{
+    for (int i = 7; i >= 0; --i)
+        if (a->v[i] != b->v[i])
+            return a->v[i] < b->v[i] ? -1 : 1;
+    return 0;
+}
+
+static
+int bn_is_zero(const bn_t* a)
+{
+    return bn_cmp(a, &BN_ZERO) == 0;
+}
+
+static
+uint32_t bn_add(bn_t* r, const bn_t* a, const bn_t* b)
+{
+    uint64_t c = 0;
+    for (int i = 0; i < 8; ++i)
+    {
+        c += (uint64_t)a->v[i] + b->v[i];
+        r->v[i] = (uint32_t)c;
+        c >>= 32;
+    }
+    return (uint32_t)c;
+}
+
+static
+uint32_t bn_sub(bn_t* r, const bn_t* a, const bn_t* b)
+{
+    int64_t c = 0;
+    for (int i = 0; i < 8; ++i)
+    {
+        c += (int64_t)a->v[i] - b->v[i];
+        r->v[i] = (uint32_t)c;
+        c >>= 32;
+    }
+    return (uint32_t)(c & 1);
+}
+
+static
+void bn_shr1(bn_t* a, uint32_t top_bit)
+{
+    for (int i = 0; i < 7; ++i)
+        a->v[i] = (a->v[i] >> 1) | (a->v[i + 1] << 31);
+    a->v[7] = (a->v[7] >> 1) | (top_bit << 31);
+}
+
+static
+void bn_mul_wide(uint32_t t[16], const bn_t* a, const bn_t* b)
+{
+    os_memset(t, 0, 16 * sizeof(t[0]));
+    for (int i = 0; i < 8; ++i)
+    {
+        uint64_t c = 0;
+        for (int j = 0; j < 8; ++j)
+        {
+            c += (uint64_t)a->v[i] * b->v[j] + t[i + j];
+            t[i + j] = (uint32_t)c;
+            c >>= 32;
+        }
+        t[i + 8] = (uint32_t)c;
+    }
+}
+
+// r = big-endian buf mod m, one bit at a time
+static
+void bn_mod_be(bn_t* r, const unsigned char* buf, unsigned int len, const bn_t* m)
+{
+    os_memset(r, 0, sizeof(*r));
+    for (unsigned int i = 0; i < len; ++i)
+        for (int bit = 7; bit >= 0; --bit)
+        {
+            const uint32_t carry = r->v[7] >> 31;
+            for (int k = 7; k > 0; --k)
+                r->v[k] = (r->v[k] << 1) | (r->v[k - 1] >> 31);
+            r->v[0] = (r->v[0] << 1) | ((buf[i] >> bit) & 1);
+            if (carry || bn_cmp(r, m) >= 0)
+                bn_sub(r, r, m);
+        }
+}
+
+static
+void bn_mod_wide(bn_t* r, const uint32_t t[16], const bn_t* m)
+{
+    unsigned char buf[64];
+    for (int i = 0; i < 64; ++i)
+        buf[63 - i] = (unsigned char)(t[i / 4] >> (8 * (i % 4)));
+    bn_mod_be(r, buf, sizeof(buf), m);
+}
+
+/* field arithmetic modulo 2^255 - 19 */
+
+static
+void fe_reduce(bn_t* a)
+{
+    while (bn_cmp(a, &FE_P) >= 0)
+        bn_sub(a, a, &FE_P);
+}
+
+static
+void fe_add(bn_t* r, const bn_t* a, const bn_t* b)
+{
+    bn_add(r, a, b); // a, b < p so no carry out
+    fe_reduce(r);
+}
+
+static
+void fe_sub(bn_t* r, const bn_t* a, const bn_t* b)
+{
+    if (bn_sub(r, a, b))
+        bn_add(r, r, &FE_P);
+}
+
+static
+void fe_mul(bn_t* r, const bn_t* a, const bn_t* b)
+{
+    uint32_t t[16];
+    bn_mul_wide(t, a, b);
+
+    // 2^256 = 38 mod p
+    uint64_t c = 0;
+    for (int i = 0; i < 8; ++i)
+    {
+        c += (uint64_t)t[i] + (uint64_t)t[i + 8] * 38;
+        r->v[i] = (uint32_t)c;
+        c >>= 32;
+    }
+    while (c)
+    {
+        c *= 38;
+        for (int i = 0; i < 8; ++i)
+        {
+            c += r->v[i];
+            r->v[i] = (uint32_t)c;
+            c >>= 32;
+        }
+    }
+    fe_reduce(r);
+}
+
+static
+void fe_pow(bn_t* r, const bn_t* a, const bn_t* e)
+{
+    bn_t result = BN_ONE;
+    const bn_t base = *a;
+    for (int i = 255; i >= 0; --i)
+    {
+        fe_mul(&result, &result, &result);
+        if ((e->v[i / 32] >> (i % 32)) & 1)
+            fe_mul(&result, &result, &base);
+    }
+    *r = result;
+}
+
+/* arithmetic modulo any odd m */
+
+static
+int is_field(const bn_t* m)
+{
+    return bn_cmp(m, &FE_P) == 0;
+}
+
+static
+void mod_reduce(bn_t* r, const bn_t* a, const bn_t* m)
+{
+    if (is_field(m))
+    {
+        *r = *a;
+        fe_reduce(r);
+        return;
+    }
+    if (bn_cmp(a, m) < 0)
+    {
+        *r = *a;
+        return;
+    }
+    unsigned char buf[32];
+    bn_to_be(buf, sizeof(buf), a);
+    bn_mod_be(r, buf, sizeof(buf), m);
+}
+
+static
+void mod_mul(bn_t* r, const bn_t* a, const bn_t* b, const bn_t* m)
+{
+    if (is_field(m))
+    {
+        fe_mul(r, a, b);
+        return;
+    }
+    uint32_t t[16];
+    bn_mul_wide(t, a, b);
+    bn_mod_wide(r, t, m);
+}
+
+static
+void mod_add(bn_t* r, const bn_t* a, const bn_t* b, const bn_t* m)
+{
+    bn_t ra, rb;
+    mod_reduce(&ra, a, m);
+    mod_reduce(&rb, b, m);
+    if (bn_add(r, &ra, &rb) || bn_cmp(r, m) >= 0)
+        bn_sub(r, r, m);
+}
+
+static
+void mod_sub(bn_t* r, const bn_t* a, const bn_t* b, const bn_t* m)
+{
+    bn_t ra, rb;
+    mod_reduce(&ra, a, m);
+    mod_reduce(&rb, b, m);
+    if (bn_sub(r, &ra, &rb))
+        bn_add(r, r, m);
+}
+
+// x = (x / 2) mod m for odd m
+static
+void mod_half(bn_t* x, const bn_t* m)
+{
+    if (x->v[0] & 1)
+        bn_shr1(x, bn_add(x, x, m));
+    else
+        bn_shr1(x, 0);
+}
+
+// binary extended Euclid, m must be odd
+static
+void mod_inv(bn_t* r, const bn_t* a, const bn_t* m)
+{
+    bn_t u;
+    mod_reduce(&u, a, m);
+    if (bn_is_zero(&u))
+    {
+        *r = BN_ZERO;
+        return;
+    }
+    bn_t v = *m;
+    bn_t x1 = BN_ONE;
+    bn_t x2 = BN_ZERO;
+    while (bn_cmp(&u, &BN_ONE) != 0 && bn_cmp(&v, &BN_ONE) != 0)
+    {
+        while (!(u.v[0] & 1))
+        {
+            bn_shr1(&u, 0);
+            mod_half(&x1, m);
+        }
+        while (!(v.v[0] & 1))
+        {
+            bn_shr1(&v, 0);
+            mod_half(&x2, m);
+        }
+        if (bn_cmp(&u, &v) >= 0)
+        {
+            bn_sub(&u, &u, &v);
+            mod_sub(&x1, &x1, &x2, m);
+        }
+        else
+        {
+            bn_sub(&v, &v, &u);
+            mod_sub(&x2, &x2, &x1, m);
+        }
+    }
+    *r = (bn_cmp(&u, &BN_ONE) == 0) ? x1 : x2;
+}
+
+static
+void load_modulus(bn_t* m, const unsigned char* buf, unsigned int len)
+{
+    bn_from_be(m, buf, len);
+    if (!(m->v[0] & 1))
+        THROW(INVALID_PARAMETER);
+}
+
+void cx_math_addm(unsigned char* r, const unsigned char* a, const unsigned char* b, const unsigned char* m, unsigned int len)
+{
+    HOST_SYSCALL(HOST_SYSCALL_MATH_ADDM);
+    bn_t ba, bb, bm, br;
+    bn_from_be(&ba, a, len);
+    bn_from_be(&bb, b, len);
+    load_modulus(&bm, m, len);
+    mod_add(&br, &ba, &bb, &bm);
+    bn_to_be(r, len, &br);
+}
+
+void cx_math_subm(unsigned char* r, const unsigned char* a, const unsigned char* b, const unsigned char* m, unsigned int len)
+{
+    HOST_SYSCALL(HOST_SYSCALL_MATH_SUBM);
+    bn_t ba, bb, bm, br;
+    bn_from_be(&ba, a, len);
+    bn_from_be(&bb, b, len);
+    load_modulus(&bm, m, len);
+    mod_sub(&br, &ba, &bb, &bm);
+    bn_to_be(r, len, &br);
+}
+
+void cx_math_multm(unsigned char* r, const unsigned char* a, const unsigned char* b, const unsigned char* m, unsigned int len)
+{
+    HOST_SYSCALL(HOST_SYSCALL_MATH_MULTM);
+    bn_t ba, bb, bm, br;
+    bn_from_be(&ba, a, len);
+    bn_from_be(&bb, b, len);
+    load_modulus(&bm, m, len);
+    mod_reduce(&ba, &ba, &bm);
+    mod_reduce(&bb, &bb, &bm);
+    mod_mul(&br, &ba, &bb, &bm);
+    bn_to_be(r, len, &br);
+}
+
+void cx_math_modm(unsigned char* v, unsigned int len_v, const unsigned char* m, unsigned int len_m)
+{
+    HOST_SYSCALL(HOST_SYSCALL_MATH_MODM);
+    bn_t bm, br;
+    load_modulus(&bm, m, len_m);
+    bn_mod_be(&br, v, len_v, &bm);
+    bn_to_be(v, len_v, &br);
+}
+
+void cx_math_powm(unsigned char* r, const unsigned char* a, const unsigned char* e, unsigned int len_e, const unsigned char* m, unsigned int len)
+{
+    HOST_SYSCALL(HOST_SYSCALL_MATH_POWM);
+    bn_t base, bm;
+    bn_from_be(&base, a, len);
+    load_modulus(&bm, m, len);
+    mod_reduce(&base, &base, &bm);
+
+    bn_t result = BN_ONE;
+    for (unsigned int i = 0; i < len_e; ++i)
+        for (int bit = 7; bit >= 0; --bit)
+        {
+            mod_mul(&result, &result, &result, &bm);
+            if ((e[i] >> bit) & 1)
+                mod_mul(&result, &result, &base, &bm);
+        }
+    bn_to_be(r, len, &result);
+}
+
+void cx_math_invprimem(unsigned char* r, const unsigned char* a, const unsigned char* m, unsigned int len)
+{
+    HOST_SYSCALL(HOST_SYSCALL_MATH_INVPRIMEM);
+    bn_t ba, bm, br;
+    bn_from_be(&ba, a, len);
+    load_modulus(&bm, m, len);
+    mod_inv(&br, &ba, &bm);
+    bn_to_be(r, len, &br);
+}
+
+int cx_math_is_zero(const unsigned char* a, unsigned int len)
+{
+    HOST_SYSCALL(HOST_SYSCALL_MATH_IS_ZERO);
+    for (unsigned int i = 0; i < len; ++i)
+        if (a[i])
+            return 0;
+    return 1;
+}
+
+/* twisted Edwards curve -x^2 + y^2 = 1 + d x^2 y^2, extended coordinates */
+
+static
+void check_curve(cx_curve_t curve)
+{
+    if (curve != CX_CURVE_Ed25519)
+        THROW(INVALID_PARAMETER);
+}
+
+static
+void ge_from_uncompressed(ge_t* r, const unsigned char* P)
+{
+    if (P[0] != 0x04)
+        THROW(INVALID_PARAMETER);
+    bn_from_be(&r->X, P + 1, 32);
+    bn_from_be(&r->Y, P + 33, 32);
+    fe_reduce(&r->X);
+    fe_reduce(&r->Y);
+    r->Z = BN_ONE;
+    fe_mul(&r->T, &r->X, &r->Y);
+}
+
+static
+void ge_to_uncompressed(unsigned char* P, const ge_t* p)
+{
+    bn_t zinv, x, y;
+    mod_inv(&zinv, &p->Z, &FE_P);
+    fe_mul(&x, &p->X, &zinv);
+    fe_mul(&y, &p->Y, &zinv);
+    P[0] = 0x04;
+    bn_to_be(P + 1, 32, &x);
+    bn_to_be(P + 33, 32, &y);
+}
+
+// unified addition (add-2008-hwcd-3), also valid for doubling
+static
+void ge_add(ge_t* r, const ge_t* p, const ge_t* q)
+{
+    bn_t a, b, c, d, e, f, g, h, t;
+
+    fe_sub(&a, &p->Y, &p->X);
+    fe_sub(&t, &q->Y, &q->X);
+    fe_mul(&a, &a, &t);
+    fe_add(&b, &p->Y, &p->X);
+    fe_add(&t, &q->Y, &q->X);
+    fe_mul(&b, &b, &t);
+    fe_mul(&c, &p->T, &q->T);
+    fe_mul(&c, &c, &FE_D2);
+    fe_mul(&d, &p->Z, &q->Z);
+    fe_add(&d, &d, &d);
+
+    fe_sub(&e, &b, &a);
+    fe_sub(&f, &d, &c);
+    fe_add(&g, &d, &c);
+    fe_add(&h, &b, &a);
+
+    fe_mul(&r->X, &e, &f);
+    fe_mul(&r->Y, &g, &h);
+    fe_mul(&r->T, &e, &h);
+    fe_mul(&r->Z, &f, &g);
+}
+
+int cx_ecfp_add_point(cx_curve_t curve, unsigned char* R, const unsigned char* P, const unsigned char* Q, unsigned int X_len)
+{
+    HOST_SYSCALL(HOST_SYSCALL_ECFP_ADD_POINT);
+    check_curve(curve);
+    ge_t p, q, r;
+    ge_from_uncompressed(&p, P);
+    ge_from_uncompressed(&q, Q);
+    ge_add(&r, &p, &q);
+    ge_to_uncompressed(R, &r);
+    return X_len;
+}
+
+int cx_ecfp_scalar_mult(cx_curve_t curve, unsigned char* P, unsigned int P_len, const unsigned char* k, unsigned int k_len)
+{
+    HOST_SYSCALL(HOST_SYSCALL_ECFP_SCALAR_MULT);
+    check_curve(curve);
+    ge_t p, r;
+    ge_from_uncompressed(&p, P);
+    r.X = BN_ZERO;
+    r.Y = BN_ONE;
+    r.Z = BN_ONE;
+    r.T = BN_ZERO;
+    for (unsigned int i = 0; i < k_len; ++i)
+        for (int bit = 7; bit >= 0; --bit)
+        {
+            ge_add(&r, &r, &r);
+            if ((k[i] >> bit) & 1)
+                ge_add(&r, &r, &p);
+        }
+    ge_to_uncompressed(P, &r);
+    return P_len;
+}
+
+void cx_edward_compress_point(cx_curve_t curve, unsigned char* P, unsigned int P_len)
+{
+    HOST_SYSCALL(HOST_SYSCALL_EDWARD_COMPRESS_POINT);
+    check_curve(curve);
+    if (P_len < 65)
+        THROW(INVALID_PARAMETER);
+    bn_t x, y;
+    bn_from_be(&x, P + 1, 32);
+    bn_from_be(&y, P + 33, 32);
+    P[0] = 0x02;
+    for (int i = 0; i < 32; ++i)
+        P[1 + i] = (unsigned char)(y.v[i / 4] >> (8 * (i % 4)));
+    P[32] |= (unsigned char)((x.v[0] & 1) << 7);
+    os_memset(P + 33, 0, 32);
+}
+
+void cx_edward_decompress_point(cx_curve_t curve, unsigned char* P, unsigned int P_len)
+{
+    HOST_SYSCALL(HOST_SYSCALL_EDWARD_DECOMPRESS_POINT);
+    check_curve(curve);
+    if (P_len < 65)
+        THROW(INVALID_PARAMETER);
+    const uint32_t sign = P[32] >> 7;
+    bn_t y = BN_ZERO;
+    for (int i = 0; i < 32; ++i)
+        y.v[i / 4] |= (uint32_t)P[1 + i] << (8 * (i % 4));
+    y.v[7] &= 0x7fffffff;
+    if (bn_cmp(&y, &FE_P) >= 0)
+        THROW(INVALID_PARAMETER);
+
+    // x = u v^3 (u v^7)^((p - 5) / 8), u = y^2 - 1, v = d y^2 + 1
+    bn_t u, v, v3, x, t;
+    fe_mul(&u, &y, &y);
+    fe_mul(&v, &u, &FE_D);
+    fe_sub(&u, &u, &BN_ONE);
+    fe_add(&v, &v, &BN_ONE);
+
+    fe_mul(&v3, &v, &v);
+    fe_mul(&v3, &v3, &v);
+    fe_mul(&x, &v3, &v3);
+    fe_mul(&x, &x, &v);
+    fe_mul(&x, &x, &u);
+    bn_t e = FE_P;
+    bn_sub(&e, &e, &(bn_t){{ 5 }});
+    for (int i = 0; i < 3; ++i)
+        bn_shr1(&e, 0);
+    fe_pow(&x, &x, &e);
+    fe_mul(&x, &x, &v3);
+    fe_mul(&x, &x, &u);
+
+    fe_mul(&t, &x, &x);
+    fe_mul(&t, &t, &v);
+    if (bn_cmp(&t, &u) != 0)
+    {
+        fe_add(&t, &t, &u);
+        if (!bn_is_zero(&t))
+            THROW(INVALID_PARAMETER);
+        fe_mul(&x, &x, &FE_SQRTM1);
+    }
+    if (bn_is_zero(&x) && sign)
+        THROW(INVALID_PARAMETER);
+    if ((x.v[0] & 1) != sign)
+        fe_sub(&x, &BN_ZERO, &x);
+
+    P[0] = 0x04;
+    bn_to_be(P + 1, 32, &x);
+    bn_to_be(P + 33, 32, &y);
+}
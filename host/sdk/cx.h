@@ -0,0 +1,47 @@
+/*******************************************************************************
+*   Bytecoin Wallet for Ledger Nano S
+*   (c) 2018 - 2019 The Bytecoin developers
+*
+*  Licensed under the Apache License, Version 2.0 (the "License");
+*  you may not use this file except in compliance with the License.
+*  You may obtain a copy of the License at
+*
+*      http://www.apache.org/licenses/LICENSE-2.0
+*
+*  Unless required by applicable law or agreed to in writing, software
+*  distributed under the License is distributed on an "AS IS" BASIS,
+*  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+*  See the License for the specific language governing permissions and
+*  limitations under the License.
+********************************************************************************/
+
+// Host stand-in for the subset of the BOLOS SDK cx.h used by the app.
+// All numbers are big-endian, points are 0x04 || x || y when uncompressed
+// and 0x02 || standard ed25519 encoding when compressed, as on the device.
+
+#ifndef CX_H
+#define CX_H
+
+typedef enum cx_curve_e
+{
+    CX_CURVE_NONE      = 0,
+    CX_CURVE_SECP256K1 = 0x21,
+    CX_CURVE_Ed25519   = 0x71,
+} cx_curve_t;
+
+int cx_ecfp_add_point(cx_curve_t curve, unsigned char* R, const unsigned char* P, const unsigned char* Q, unsigned int X_len);
+int cx_ecfp_scalar_mult(cx_curve_t curve, unsigned char* P, unsigned int P_len, const unsigned char* k, unsigned int k_len);
+void cx_edward_compress_point(cx_curve_t curve, unsigned char* P, unsigned int P_len);
+void cx_edward_decompress_point(cx_curve_t curve, unsigned char* P, unsigned int P_len);
+
+void cx_math_addm(unsigned char* r, const unsigned char* a, const unsigned char* b, const unsigned char* m, unsigned int len);
+void cx_math_subm(unsigned char* r, const unsigned char* a, const unsigned char* b, const unsigned char* m, unsigned int len);
+void cx_math_multm(unsigned char* r, const unsigned char* a, const unsigned char* b, const unsigned char* m, unsigned int len);
+void cx_math_modm(unsigned char* v, unsigned int len_v, const unsigned char* m, unsigned int len_m);
+void cx_math_powm(unsigned char* r, const unsigned char* a, const unsigned char* e, unsigned int len_e, const unsigned char* m, unsigned int len);
+void cx_math_invprimem(unsigned char* r, const unsigned char* a, const unsigned char* m, unsigned int len);
+int cx_math_is_zero(const unsigned char* a, unsigned int len);
+
+unsigned char* cx_rng(unsigned char* buffer, unsigned int len);
+
+#endif // CX_H
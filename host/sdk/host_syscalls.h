@@ -0,0 +1,57 @@
+/*******************************************************************************
+*   Bytecoin Wallet for Ledger Nano S
+*   (c) 2018 - 2019 The Bytecoin developers
+*
+*  Licensed under the Apache License, Version 2.0 (the "License");
+*  you may not use this file except in compliance with the License.
+*  You may obtain a copy of the License at
+*
+*      http://www.apache.org/licenses/LICENSE-2.0
+*
+*  Unless required by applicable law or agreed to in writing, software
+*  distributed under the License is distributed on an "AS IS" BASIS,
+*  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+*  See the License for the specific language governing permissions and
+*  limitations under the License.
+********************************************************************************/
+
+// Not part of the SDK: counts the calls into the stand-in that would be
+// syscalls (traps into the secure element OS) on the device.
+
+#ifndef HOST_SYSCALLS_H
+#define HOST_SYSCALLS_H
+
+#include <stdint.h>
+
+typedef enum host_syscall_e
+{
+    HOST_SYSCALL_ECFP_ADD_POINT = 0,
+    HOST_SYSCALL_ECFP_SCALAR_MULT,
+    HOST_SYSCALL_EDWARD_COMPRESS_POINT,
+    HOST_SYSCALL_EDWARD_DECOMPRESS_POINT,
+    HOST_SYSCALL_MATH_ADDM,
+    HOST_SYSCALL_MATH_SUBM,
+    HOST_SYSCALL_MATH_MULTM,
+    HOST_SYSCALL_MATH_MODM,
+    HOST_SYSCALL_MATH_POWM,
+    HOST_SYSCALL_MATH_INVPRIMEM,
+    HOST_SYSCALL_MATH_IS_ZERO,
+    HOST_SYSCALL_RNG,
+    HOST_SYSCALL_DERIVE_NODE_BIP32,
+    HOST_SYSCALL_COUNT
+} host_syscall_t;
+
+typedef struct host_syscall_counters_s
+{
+    uint64_t calls[HOST_SYSCALL_COUNT];
+} host_syscall_counters_t;
+
+// calls made by the calling thread
+extern __thread host_syscall_counters_t G_host_syscalls;
+
+#define HOST_SYSCALL(id) (++G_host_syscalls.calls[(id)])
+
+const char* host_syscall_name(host_syscall_t id);
+uint64_t host_syscall_total(const host_syscall_counters_t* counters);
+
+#endif // HOST_SYSCALLS_H
@@ -0,0 +1,149 @@
+/*******************************************************************************
+*   Bytecoin Wallet for Ledger Nano S
+*   (c) 2018 - 2019 The Bytecoin developers
+*
+*  Licensed under the Apache License, Version 2.0 (the "License");
+*  you may not use this file except in compliance with the License.
+*  You may obtain a copy of the License at
+*
+*      http://www.apache.org/licenses/LICENSE-2.0
+*
+*  Unless required by applicable law or agreed to in writing, software
+*  distributed under the License is distributed on an "AS IS" BASIS,
+*  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+*  See the License for the specific language governing permissions and
+*  limitations under the License.
+********************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "os.h"
+#include "host_syscalls.h"
+
+// the state of the stand-in is per thread so that every thread can run its
+// own emulated devices
+__thread host_syscall_counters_t G_host_syscalls;
+
+static __thread try_context_t* G_try_context;
+
+// 32 bytes standing in for the device master seed, "bytecoin host seed"
+static __thread unsigned char G_host_seed[32] = {
+    'b', 'y', 't', 'e', 'c', 'o', 'i', 'n', ' ', 'h', 'o', 's', 't', ' ', 's', 'e',
+    'e', 'd'
+};
+static __thread uint64_t G_rng_state;
+
+try_context_t* try_context_get(void)
+{
+    return G_try_context;
+}
+
+try_context_t* try_context_set(try_context_t* context)
+{
+    try_context_t* previous = G_try_context;
+    G_try_context = context;
+    return previous;
+}
+
+void os_longjmp(unsigned int exception)
+{
+    if (!G_try_context)
+    {
+        fprintf(stderr, "uncaught exception 0x%04x\n", exception);
+        abort();
+    }
+    longjmp(G_try_context->jmp_buf, exception);
+}
+
+// splitmix64, good enough to stand in for the device TRNG and key derivation
+static
+uint64_t mix64(uint64_t x)
+{
+    x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+    return x ^ (x >> 31);
+}
+
+static
+uint64_t load64_le(const unsigned char* buf)
+{
+    uint64_t v = 0;
+    for (int i = 7; i >= 0; --i)
+        v = (v << 8) | buf[i];
+    return v;
+}
+
+void os_host_set_seed(const unsigned char seed[32])
+{
+    memcpy(G_host_seed, seed, sizeof(G_host_seed));
+    G_rng_state = 0;
+}
+
+unsigned char* cx_rng(unsigned char* buffer, unsigned int len)
+{
+    HOST_SYSCALL(HOST_SYSCALL_RNG);
+    if (G_rng_state == 0)
+        G_rng_state = mix64(load64_le(G_host_seed) ^ load64_le(G_host_seed + 8)) | 1;
+    for (unsigned int i = 0; i < len; ++i)
+    {
+        if (i % 8 == 0)
+            G_rng_state = mix64(G_rng_state + 0x9e3779b97f4a7c15ULL);
+        buffer[i] = (unsigned char)(G_rng_state >> ((i % 8) * 8));
+    }
+    return buffer;
+}
+
+// Not BIP32: the stand-in only has to be deterministic per (seed, path) so
+// that wallet keys are stable across host runs.
+void os_perso_derive_node_bip32(
+        cx_curve_t curve,
+        const unsigned int* path,
+        unsigned int pathLength,
+        unsigned char* privateKey,
+        unsigned char* chain)
+{
+    HOST_SYSCALL(HOST_SYSCALL_DERIVE_NODE_BIP32);
+    uint64_t acc = mix64((uint64_t)curve);
+    for (unsigned int i = 0; i < pathLength; ++i)
+        acc = mix64(acc ^ path[i]);
+
+    for (unsigned int w = 0; w < 4; ++w)
+    {
+        const uint64_t v = mix64(acc ^ load64_le(G_host_seed + 8 * w) ^ w);
+        for (unsigned int i = 0; i < 8; ++i)
+        {
+            if (privateKey)
+                privateKey[8 * w + i] = (unsigned char)(v >> (8 * i));
+            if (chain)
+                chain[8 * w + i] = (unsigned char)(v >> (8 * (7 - i)));
+        }
+    }
+}
+
+const char* host_syscall_name(host_syscall_t id)
+{
+    static const char* const names[HOST_SYSCALL_COUNT] = {
+        "cx_ecfp_add_point",
+        "cx_ecfp_scalar_mult",
+        "cx_edward_compress_point",
+        "cx_edward_decompress_point",
+        "cx_math_addm",
+        "cx_math_subm",
+        "cx_math_multm",
+        "cx_math_modm",
+        "cx_math_powm",
+        "cx_math_invprimem",
+        "cx_math_is_zero",
+        "cx_rng",
+        "os_perso_derive_node_bip32",
+    };
+    return (id < HOST_SYSCALL_COUNT) ? names[id] : "unknown";
+}
+
+uint64_t host_syscall_total(const host_syscall_counters_t* counters)
+{
+    uint64_t total = 0;
+    for (int i = 0; i < HOST_SYSCALL_COUNT; ++i)
+        total += counters->calls[i];
+    return total;
+}
@@ -0,0 +1,139 @@
+/*******************************************************************************
+*   Bytecoin Wallet for Ledger Nano S
+*   (c) 2018 - 2019 The Bytecoin developers
+*
+*  Licensed under the Apache License, Version 2.0 (the "License");
+*  you may not use this file except in compliance with the License.
+*  You may obtain a copy of the License at
+*
+*      http://www.apache.org/licenses/LICENSE-2.0
+*
+*  Unless required by applicable law or agreed to in writing, software
+*  distributed under the License is distributed on an "AS IS" BASIS,
+*  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+*  See the License for the specific language governing permissions and
+*  limitations under the License.
+********************************************************************************/
+
+// Host stand-in for the subset of the BOLOS SDK os.h used by the app.
+// Only what src/ needs is declared here, with the SDK signatures.
+
+#ifndef OS_H
+#define OS_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <setjmp.h>
+#include "cx.h"
+
+#define os_memset  memset
+#define os_memmove memmove
+#define os_memcmp  memcmp
+
+#define PRINTF(...)
+#define UNUSED(x) (void)x
+
+#define EXCEPTION            1
+#define INVALID_PARAMETER    2
+#define EXCEPTION_OVERFLOW   3
+#define EXCEPTION_SECURITY   4
+#define INVALID_STATE        9
+#define EXCEPTION_IO_RESET  16
+
+typedef unsigned short exception_t;
+
+typedef struct try_context_s try_context_t;
+struct try_context_s
+{
+    jmp_buf jmp_buf;
+    try_context_t* previous;
+    exception_t ex;
+};
+
+try_context_t* try_context_get(void);
+try_context_t* try_context_set(try_context_t* context);
+void os_longjmp(unsigned int exception) __attribute__((noreturn));
+
+#define BEGIN_TRY_L(L) \
+    {                                                \
+        try_context_t __try##L;
+
+#define TRY_L(L) \
+        __try##L.ex = setjmp(__try##L.jmp_buf);      \
+        if (__try##L.ex == 0) {                      \
+            __try##L.previous = try_context_set(&__try##L);
+
+#define CATCH_L(L, x) \
+            goto FINALLY##L;                         \
+        }                                            \
+        else if (__try##L.ex == x) {                 \
+            __try##L.ex = 0;                         \
+            try_context_set(__try##L.previous);
+
+#define CATCH_OTHER_L(L, e) \
+            goto FINALLY##L;                         \
+        }                                            \
+        else {                                       \
+            exception_t e;                           \
+            e = __try##L.ex;                         \
+            __try##L.ex = 0;                         \
+            try_context_set(__try##L.previous);
+
+#define CATCH_ALL_L(L) CATCH_OTHER_L(L, __exception##L)
+
+#define FINALLY_L(L) \
+            goto FINALLY##L;                         \
+        }                                            \
+        FINALLY##L:                                  \
+        if (try_context_get() == &__try##L)          \
+            try_context_set(__try##L.previous);
+
+#define END_TRY_L(L) \
+        if (__try##L.ex != 0)                        \
+            THROW_L(L, __try##L.ex);                 \
+    }
+
+#define THROW_L(L, x) os_longjmp(x)
+
+#define BEGIN_TRY     BEGIN_TRY_L(_)
+#define TRY           TRY_L(_)
+#define CATCH(x)      CATCH_L(_, x)
+#define CATCH_OTHER(e) CATCH_OTHER_L(_, e)
+#define CATCH_ALL     CATCH_ALL_L(_)
+#define FINALLY       FINALLY_L(_)
+#define END_TRY       END_TRY_L(_)
+#define THROW(x)      THROW_L(_, x)
+
+#ifdef CUSTOM_IO_APDU_BUFFER_SIZE
+#define IO_APDU_BUFFER_SIZE CUSTOM_IO_APDU_BUFFER_SIZE
+#else
+#define IO_APDU_BUFFER_SIZE (5 + 255)
+#endif
+
+// every emulated device has its own APDU buffer, see bytecoin_host_device_t
+
+#define CHANNEL_APDU           0
+#define CHANNEL_KEYBOARD       1
+#define CHANNEL_SPI            2
+#define IO_RESET_AFTER_REPLIED 0x80
+#define IO_RECEIVE_DATA        0x40
+#define IO_RETURN_AFTER_TX     0x20
+#define IO_ASYNCH_REPLY        0x10
+#define IO_FLAGS               0xF8
+
+// implemented by the host emulator, see bytecoin_host.c
+unsigned short io_exchange(unsigned char channel_and_flags, unsigned short tx_len);
+
+void os_perso_derive_node_bip32(
+        cx_curve_t curve,
+        const unsigned int* path,
+        unsigned int pathLength,
+        unsigned char* privateKey,
+        unsigned char* chain);
+
+// not part of the SDK: seeds os_perso_derive_node_bip32 and cx_rng of the
+// stand-in for the calling thread
+void os_host_set_seed(const unsigned char seed[32]);
+
+#endif // OS_H
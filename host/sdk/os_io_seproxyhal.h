@@ -0,0 +1,26 @@
+/*******************************************************************************
+*   Bytecoin Wallet for Ledger Nano S
+*   (c) 2018 - 2019 The Bytecoin developers
+*
+*  Licensed under the Apache License, Version 2.0 (the "License");
+*  you may not use this file except in compliance with the License.
+*  You may obtain a copy of the License at
+*
+*      http://www.apache.org/licenses/LICENSE-2.0
+*
+*  Unless required by applicable law or agreed to in writing, software
+*  distributed under the License is distributed on an "AS IS" BASIS,
+*  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+*  See the License for the specific language governing permissions and
+*  limitations under the License.
+********************************************************************************/
+
+// Host stand-in for os_io_seproxyhal.h: the app core only needs io_exchange,
+// declared in os.h.
+
+#ifndef OS_IO_SEPROXYHAL_H
+#define OS_IO_SEPROXYHAL_H
+
+#include "os.h"
+
+#endif // OS_IO_SEPROXYHAL_H
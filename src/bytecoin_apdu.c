@@ -20,10 +20,12 @@
 #include "bytecoin_io.h"
 #include "bytecoin_vars.h"
 #include "bytecoin_debug.h"
+#include "bytecoin_dispatch.h"
+#include "bytecoin_apdu_schema.h"
 
-int bytecoin_apdu_get_ledger_app_info(void)
+int bytecoin_apdu_get_ledger_app_info(bytecoin_v_state_t* state)
 {
-    reset_io_buffer(&G_bytecoin_vstate.io_buffer);
+    bytecoin_parse_get_app_info(&state->sig_state, &state->io_buffer);
 
     const uint8_t major_version = BYTECOIN_VERSION_M;
     const uint8_t minor_version = BYTECOIN_VERSION_N;
@@ -35,20 +37,20 @@ int bytecoin_apdu_get_ledger_app_info(void)
 
     const uint8_t app_name_size = sizeof(XSTR(BYTECOIN_NAME)) - 1;
     insert_var(app_name_size);
-    insert_bytes_to_io_buffer(&G_bytecoin_vstate.io_buffer, XSTR(BYTECOIN_NAME), app_name_size);
+    insert_bytes_to_io_buffer(&state->io_buffer, XSTR(BYTECOIN_NAME), app_name_size);
     const uint8_t app_version_size = sizeof(XSTR(BYTECOIN_VERSION)) - 1;
     insert_var(app_version_size);
-    insert_bytes_to_io_buffer(&G_bytecoin_vstate.io_buffer, XSTR(BYTECOIN_VERSION), app_version_size);
+    insert_bytes_to_io_buffer(&state->io_buffer, XSTR(BYTECOIN_VERSION), app_version_size);
     const uint8_t app_specversion_size = sizeof(XSTR(BYTECOIN_SPEC_VERSION)) - 1;
     insert_var(app_specversion_size);
-    insert_bytes_to_io_buffer(&G_bytecoin_vstate.io_buffer, XSTR(BYTECOIN_SPEC_VERSION), app_specversion_size);
+    insert_bytes_to_io_buffer(&state->io_buffer, XSTR(BYTECOIN_SPEC_VERSION), app_specversion_size);
 
     return SW_NO_ERROR;
 }
 
-int bytecoin_apdu_get_wallet_keys(void)
+int bytecoin_apdu_get_wallet_keys(bytecoin_v_state_t* state)
 {
-    reset_io_buffer(&G_bytecoin_vstate.io_buffer);
+    bytecoin_parse_get_wallet_keys(&state->sig_state, &state->io_buffer);
 
     hash_t wallet_key;
     public_key_t A_plus_sH;
@@ -56,7 +58,7 @@ int bytecoin_apdu_get_wallet_keys(void)
     elliptic_curve_point_t v_mul_A_plus_sH;
 
 
-    get_wallet_keys(&G_bytecoin_vstate.wallet_keys, &wallet_key, &A_plus_sH, &view_public_key, &v_mul_A_plus_sH);
+    get_wallet_keys(&state->wallet_keys, &wallet_key, &A_plus_sH, &view_public_key, &v_mul_A_plus_sH);
 
     insert_hash      (wallet_key);
     insert_public_key(A_plus_sH);
@@ -66,137 +68,274 @@ int bytecoin_apdu_get_wallet_keys(void)
     return SW_NO_ERROR;
 }
 
-int bytecoin_apdu_scan_outputs(void)
+int bytecoin_apdu_scan_outputs(bytecoin_v_state_t* state)
 {
-    const uint8_t len = fetch_var(uint8_t);
-    if (len > BYTECOIN_MAX_SCAN_OUTPUTS)
-        THROW(SW_NOT_ENOUGH_MEMORY);
-
-    public_key_t output_public_keys[BYTECOIN_MAX_SCAN_OUTPUTS];
-    for (uint8_t i = 0; i < len; ++i)
-        output_public_keys[i] = fetch_public_key();
-    reset_io_buffer(&G_bytecoin_vstate.io_buffer);
+    bytecoin_scan_outputs_cmd_t cmd;
+    bytecoin_parse_scan_outputs(&state->sig_state, &state->io_buffer, &cmd);
 
-    for (uint8_t i = 0; i < len; ++i)
+    // result i overwrites no key after key i
+    for (uint8_t i = 0; i < cmd.output_public_keys.count; ++i)
     {
         public_key_t result;
-        scan_outputs(&G_bytecoin_vstate.wallet_keys, &output_public_keys[i], &result);
+        scan_outputs(&state->wallet_keys, &cmd.output_public_keys.items[i], &result);
         insert_public_key(result);
     }
     return SW_NO_ERROR;
 }
 
-int bytecoin_apdu_generate_keyimage(void)
+int bytecoin_apdu_generate_keyimage(bytecoin_v_state_t* state)
 {
-    const uint8_t len = fetch_var(uint8_t);
-    if (len > BYTECOIN_MAX_BUFFER_SIZE)
-        THROW(SW_NOT_ENOUGH_MEMORY);
-    uint8_t output_secret_hash_arg[BYTECOIN_MAX_BUFFER_SIZE];
-    fetch_bytes_from_io_buffer(&G_bytecoin_vstate.io_buffer, output_secret_hash_arg, len);
-    const uint32_t address_index = fetch_var(uint32_t);
-    reset_io_buffer(&G_bytecoin_vstate.io_buffer);
+    bytecoin_generate_keyimage_cmd_t cmd;
+    bytecoin_parse_generate_keyimage(&state->sig_state, &state->io_buffer, &cmd);
 
     keyimage_t result;
 
-    generate_keyimage_for_address(&G_bytecoin_vstate.wallet_keys, output_secret_hash_arg, len, address_index, &result);
+    generate_keyimage_for_address(&state->wallet_keys, &state->address_cache, cmd.output_secret_hash_arg.data, cmd.output_secret_hash_arg.length, cmd.address_index, &result);
 
     insert_keyimage(result);
 
     return SW_NO_ERROR;
 }
 
-int bytecoin_apdu_generate_output_seed(void)
+int bytecoin_apdu_generate_output_seed(bytecoin_v_state_t* state)
 {
-    const hash_t tx_inputs_hash = fetch_hash();
-    const uint32_t out_index    = fetch_var(uint32_t);
-    reset_io_buffer(&G_bytecoin_vstate.io_buffer);
+    bytecoin_generate_output_seed_cmd_t cmd;
+    bytecoin_parse_generate_output_seed(&state->sig_state, &state->io_buffer, &cmd);
 
     hash_t result;
-    generate_output_seed(&G_bytecoin_vstate.wallet_keys, &tx_inputs_hash, out_index, &result);
+    generate_output_seed(&state->wallet_keys, cmd.tx_inputs_hash, cmd.out_index, &result);
 
     insert_hash(result);
     return SW_NO_ERROR;
 }
 
-int bytecoin_apdu_sig_start(void)
+int bytecoin_apdu_sig_start(bytecoin_v_state_t* state)
 {
-    const uint32_t version     = fetch_var(uint32_t);
-    const uint64_t ut          = fetch_var(uint64_t);
-    const uint32_t inputs_num  = fetch_var(uint32_t);
-    const uint32_t outputs_num = fetch_var(uint32_t);
-    const uint32_t extra_num   = fetch_var(uint32_t);
-    reset_io_buffer(&G_bytecoin_vstate.io_buffer);
+    bytecoin_sig_start_cmd_t cmd;
+    bytecoin_parse_sig_start(&state->sig_state, &state->io_buffer, &cmd);
 
-    sig_start(&G_bytecoin_vstate.sig_state, version, ut, inputs_num, outputs_num, extra_num);
+    sig_start(&state->sig_state, cmd.version, cmd.unlock_time, cmd.inputs_num, cmd.outputs_num, cmd.extra_num);
 
     return SW_NO_ERROR;
 }
 
-int bytecoin_apdu_sig_add_input_start(void)
+int bytecoin_apdu_sig_add_input_start(bytecoin_v_state_t* state)
 {
-    const uint64_t amount = fetch_var(uint64_t);
-    const uint32_t output_indexes_count   = fetch_var(uint32_t);
-    reset_io_buffer(&G_bytecoin_vstate.io_buffer);
+    bytecoin_sig_add_input_start_cmd_t cmd;
+    bytecoin_parse_sig_add_input_start(&state->sig_state, &state->io_buffer, &cmd);
 
-    sig_add_input_start(&G_bytecoin_vstate.sig_state, amount, output_indexes_count);
+    sig_add_input_start(&state->sig_state, cmd.amount, cmd.output_indexes_count);
 
     return SW_NO_ERROR;
 
 }
 
-int bytecoin_apdu_sig_add_input_indexes(void)
+// a chained command carries the indexes without the count, a whole number of
+// them in every APDU
+static
+void add_input_indexes_chunk(bytecoin_v_state_t* state)
 {
-    const uint8_t output_indexes_len = fetch_var(uint8_t);
-    if (output_indexes_len > BYTECOIN_MAX_OUTPUT_INDEXES)
-        THROW(SW_NOT_ENOUGH_MEMORY);
     uint32_t output_indexes[BYTECOIN_MAX_OUTPUT_INDEXES];
-    for (uint32_t i = 0; i < output_indexes_len; ++i)
-        output_indexes[i] = fetch_var_from_io_buffer(&G_bytecoin_vstate.io_buffer, sizeof(output_indexes[0]));
-    reset_io_buffer(&G_bytecoin_vstate.io_buffer);
+    while (state->io_buffer.offset < state->io_buffer.length)
+    {
+        uint32_t count = 0;
+        for (; count < BYTECOIN_MAX_OUTPUT_INDEXES && state->io_buffer.offset < state->io_buffer.length; ++count)
+            output_indexes[count] = fetch_var_from_io_buffer(&state->io_buffer, sizeof(output_indexes[0]));
+        sig_add_input_indexes(&state->sig_state, output_indexes, count);
+    }
+    reset_io_buffer(&state->io_buffer);
+}
+
+int bytecoin_apdu_sig_add_input_indexes(bytecoin_v_state_t* state)
+{
+    if (state->io_buffer.chunk != IO_CHUNK_WHOLE)
+    {
+        add_input_indexes_chunk(state);
+        return SW_NO_ERROR;
+    }
+    bytecoin_sig_add_input_indexes_cmd_t cmd;
+    bytecoin_parse_sig_add_input_indexes(&state->sig_state, &state->io_buffer, &cmd);
+
+    uint32_t output_indexes[BYTECOIN_MAX_OUTPUT_INDEXES];
+    for (uint8_t i = 0; i < cmd.output_indexes.count; ++i)
+        output_indexes[i] = bytecoin_u32s_at(&cmd.output_indexes, i);
+    sig_add_input_indexes(&state->sig_state, output_indexes, cmd.output_indexes.count);
+
+    return SW_NO_ERROR;
+}
+
+// the commands that finish an input answer its token with P1_INPUT_TOKEN
+static
+bytecoin_input_token_t* requested_token(const bytecoin_v_state_t* state, bytecoin_input_token_t* token)
+{
+    return state->prev_io_call_params.p1 == P1_INPUT_TOKEN ? token : NULL;
+}
+
+static
+void insert_input_token(bytecoin_v_state_t* state, const bytecoin_input_token_t* token)
+{
+    if (token)
+        insert_bytes_to_io_buffer(&state->io_buffer, token->data, sizeof(token->data));
+}
+
+int bytecoin_apdu_sig_add_input_finish(bytecoin_v_state_t* state)
+{
+    bytecoin_sig_add_input_finish_cmd_t cmd;
+    bytecoin_parse_sig_add_input_finish(&state->sig_state, &state->io_buffer, &cmd);
 
-    sig_add_input_indexes(&G_bytecoin_vstate.sig_state, output_indexes, output_indexes_len);
+    bytecoin_input_token_t buffer;
+    bytecoin_input_token_t* token = requested_token(state, &buffer);
+    sig_add_input_finish(&state->sig_state, &state->wallet_keys, &state->address_cache, cmd.output_secret_hash_arg.data, cmd.output_secret_hash_arg.length, cmd.address_index, token);
 
+    insert_input_token(state, token);
     return SW_NO_ERROR;
 }
 
-int bytecoin_apdu_sig_add_input_finish(void)
+// the indexes in groups that sig_add_input_indexes takes, a ring of none
+// still finishes the indexes
+static
+void add_input_indexes_view(bytecoin_signing_state_t* sig_state, const bytecoin_u32s_t* indexes)
 {
-    const uint8_t len = fetch_var(uint8_t);
-    if (len > BYTECOIN_MAX_BUFFER_SIZE)
+    uint32_t output_indexes[BYTECOIN_MAX_OUTPUT_INDEXES];
+    uint8_t i = 0;
+    do
+    {
+        uint32_t count = 0;
+        for (; count < BYTECOIN_MAX_OUTPUT_INDEXES && i < indexes->count; ++count, ++i)
+            output_indexes[count] = bytecoin_u32s_at(indexes, i);
+        sig_add_input_indexes(sig_state, output_indexes, count);
+    } while (i < indexes->count);
+}
+
+// as many varint indexes as the buffer holds and the ring still takes
+static
+void add_input_varints(bytecoin_signing_state_t* sig_state, io_buffer_t* iobuf)
+{
+    uint32_t output_indexes[BYTECOIN_MAX_OUTPUT_INDEXES];
+    do
+    {
+        uint32_t count = 0;
+        for (; count < BYTECOIN_MAX_OUTPUT_INDEXES && sig_state->mixin_counter + count < sig_state->mixin_num && iobuf->offset < iobuf->length; ++count)
+            output_indexes[count] = fetch_varint_from_io_buffer(iobuf);
+        sig_add_input_indexes(sig_state, output_indexes, count);
+    } while (sig_state->status == SIG_STATE_EXPECT_INPUT_INDEXES && iobuf->offset < iobuf->length);
+}
+
+// a chained command has the layout of a plain one: the first APDU starts with
+// the amount and the count, every APDU holds a whole number of indexes and the
+// last one holds the key image arguments after the last index
+static
+void add_input_chunk(bytecoin_v_state_t* state, bool varints)
+{
+    io_buffer_t* iobuf = &state->io_buffer;
+    bytecoin_signing_state_t* sig_state = &state->sig_state;
+
+    if (iobuf->chunk & IO_CHUNK_FIRST)
+    {
+        const uint64_t amount = fetch_var_from_io_buffer(iobuf, sizeof(amount));
+        const uint8_t count = fetch_var_from_io_buffer(iobuf, sizeof(count));
+        sig_add_input_start(sig_state, amount, count);
+    }
+    if (sig_state->status == SIG_STATE_EXPECT_INPUT_INDEXES && varints)
+        add_input_varints(sig_state, iobuf);
+    else if (sig_state->status == SIG_STATE_EXPECT_INPUT_INDEXES)
+    {
+        const uint32_t left = sig_state->mixin_num - sig_state->mixin_counter;
+        const uint32_t available = (iobuf->length - iobuf->offset) / 4;
+        bytecoin_u32s_t indexes;
+        indexes.count = left < available ? left : available;
+        indexes.data = fetch_view_from_io_buffer(iobuf, 4 * indexes.count);
+        add_input_indexes_view(sig_state, &indexes);
+    }
+    if (!(iobuf->chunk & IO_CHUNK_LAST))
+    {
+        if (iobuf->offset != iobuf->length)
+            THROW(SW_WRONG_LENGTH);
+        reset_io_buffer(iobuf);
+        return;
+    }
+    if (sig_state->status != SIG_STATE_EXPECT_INPUT_FINISH)
+        THROW(SW_WRONG_LENGTH);
+
+    const uint8_t arg_len = fetch_var_from_io_buffer(iobuf, sizeof(arg_len));
+    if (arg_len > BYTECOIN_MAX_BUFFER_SIZE)
         THROW(SW_NOT_ENOUGH_MEMORY);
-    uint8_t output_secret_hash_arg[BYTECOIN_MAX_BUFFER_SIZE];
-    fetch_bytes_from_io_buffer(&G_bytecoin_vstate.io_buffer, output_secret_hash_arg, len);
-    const uint32_t address_index = fetch_var(uint32_t);
-    reset_io_buffer(&G_bytecoin_vstate.io_buffer);
+    const uint8_t* arg = fetch_view_from_io_buffer(iobuf, arg_len);
+    const uint32_t address_index = fetch_var_from_io_buffer(iobuf, sizeof(address_index));
+    if (iobuf->offset != iobuf->length)
+        THROW(SW_WRONG_LENGTH);
+
+    bytecoin_input_token_t buffer;
+    bytecoin_input_token_t* token = requested_token(state, &buffer);
+    sig_add_input_finish(sig_state, &state->wallet_keys, &state->address_cache, arg, arg_len, address_index, token);
+    reset_io_buffer(iobuf);
+    insert_input_token(state, token);
+}
+
+// sig_add_input_start, _indexes and _finish in one round trip, hashed the same way
+int bytecoin_apdu_sig_add_input(bytecoin_v_state_t* state)
+{
+    if (state->io_buffer.chunk != IO_CHUNK_WHOLE)
+    {
+        add_input_chunk(state, false);
+        return SW_NO_ERROR;
+    }
+    bytecoin_sig_add_input_cmd_t cmd;
+    bytecoin_parse_sig_add_input(&state->sig_state, &state->io_buffer, &cmd);
+
+    sig_add_input_start(&state->sig_state, cmd.amount, cmd.output_indexes.count);
+    add_input_indexes_view(&state->sig_state, &cmd.output_indexes);
+    bytecoin_input_token_t buffer;
+    bytecoin_input_token_t* token = requested_token(state, &buffer);
+    sig_add_input_finish(&state->sig_state, &state->wallet_keys, &state->address_cache, cmd.output_secret_hash_arg.data, cmd.output_secret_hash_arg.length, cmd.address_index, token);
 
-    sig_add_input_finish(&G_bytecoin_vstate.sig_state, &G_bytecoin_vstate.wallet_keys, output_secret_hash_arg, len, address_index);
+    insert_input_token(state, token);
+    return SW_NO_ERROR;
+}
 
+int bytecoin_apdu_sig_add_input_varints(bytecoin_v_state_t* state)
+{
+    if (state->io_buffer.chunk != IO_CHUNK_WHOLE)
+    {
+        add_input_chunk(state, true);
+        return SW_NO_ERROR;
+    }
+    bytecoin_sig_add_input_varints_cmd_t cmd;
+    bytecoin_parse_sig_add_input_varints(&state->sig_state, &state->io_buffer, &cmd);
+
+    io_buffer_t indexes;
+    os_memset(&indexes, 0, sizeof(indexes));
+    indexes.data = (uint8_t*)cmd.output_indexes.data;
+    indexes.length = cmd.output_indexes.length;
+    sig_add_input_start(&state->sig_state, cmd.amount, cmd.output_indexes.count);
+    add_input_varints(&state->sig_state, &indexes);
+    bytecoin_input_token_t buffer;
+    bytecoin_input_token_t* token = requested_token(state, &buffer);
+    sig_add_input_finish(&state->sig_state, &state->wallet_keys, &state->address_cache, cmd.output_secret_hash_arg.data, cmd.output_secret_hash_arg.length, cmd.address_index, token);
+
+    insert_input_token(state, token);
     return SW_NO_ERROR;
 }
 
-int bytecoin_apdu_sig_add_output(void)
+int bytecoin_apdu_sig_add_output(bytecoin_v_state_t* state)
 {
-    const uint8_t change                = fetch_var(uint8_t);
-    const uint64_t amount               = fetch_var(uint64_t);
-    const uint32_t change_address_index = fetch_var(uint32_t);
-    const uint8_t dst_address_tag       = fetch_var(uint8_t);
-    const public_key_t dst_address_s    = fetch_public_key();
-    const public_key_t dst_address_s_v  = fetch_public_key();
-    reset_io_buffer(&G_bytecoin_vstate.io_buffer);
+    bytecoin_sig_add_output_cmd_t cmd;
+    bytecoin_parse_sig_add_output(&state->sig_state, &state->io_buffer, &cmd);
 
     public_key_t public_key;
     public_key_t encrypted_secret;
     uint8_t encrypted_address_type;
 
     const int rc = sig_add_output(
-                &G_bytecoin_vstate.sig_state,
-                &G_bytecoin_vstate.wallet_keys,
-                change ? true : false,
-                amount,
-                change_address_index,
-                dst_address_tag,
-                &dst_address_s,
-                &dst_address_s_v,
+                &state->sig_state,
+                &state->wallet_keys,
+                &state->address_cache,
+                cmd.change ? true : false,
+                cmd.amount,
+                cmd.change_address_index,
+                cmd.dst_address_tag,
+                cmd.dst_address_s,
+                cmd.dst_address_s_v,
                 &public_key,
                 &encrypted_secret,
                 &encrypted_address_type);
@@ -205,49 +344,183 @@ int bytecoin_apdu_sig_add_output(void)
     insert_public_key(encrypted_secret);
     insert_var       (encrypted_address_type);
 
+    if (state->sig_state.status == SIG_STATE_EXPECT_USER_CONFIRMATION)
+        return user_confirm_tx(state);
+    return rc;
+}
+
+// the outputs after the first BYTECOIN_ADD_OUTPUTS_PER_RESPONSE wait at the
+// end of the io buffer for INS_GET_RESPONSE
+#if BYTECOIN_ADD_OUTPUTS_PER_RESPONSE * (2 * 32 + 1) + 2 + (BYTECOIN_MAX_ADD_OUTPUTS - BYTECOIN_ADD_OUTPUTS_PER_RESPONSE) * BYTECOIN_SIG_ADD_OUTPUTS_ITEM_SIZE > BYTECOIN_IO_BUFFER_SIZE
+#error the outputs of INS_SIG_ADD_OUTPUTS do not fit in the io buffer
+#endif
+
+static
+int add_pending_outputs(bytecoin_v_state_t* state)
+{
+    io_buffer_t* iobuf = &state->io_buffer;
+    bytecoin_signing_state_t* sig_state = &state->sig_state;
+    int rc = SW_NO_ERROR;
+    for (uint8_t i = 0; i < BYTECOIN_ADD_OUTPUTS_PER_RESPONSE && iobuf->pending; ++i)
+    {
+        const uint8_t* item = iobuf->data + iobuf->size - iobuf->pending;
+        iobuf->pending -= BYTECOIN_SIG_ADD_OUTPUTS_ITEM_SIZE;
+        uint64_t amount = 0;
+        for (uint8_t k = 0; k < 8; ++k)
+            amount = amount << 8 | item[1 + k];
+        const uint32_t change_address_index = (uint32_t)item[9] << 24 | (uint32_t)item[10] << 16 | (uint32_t)item[11] << 8 | item[12];
+
+        public_key_t public_key;
+        public_key_t encrypted_secret;
+        uint8_t encrypted_address_type;
+
+        rc = sig_add_output(
+                    sig_state,
+                    &state->wallet_keys,
+                    &state->address_cache,
+                    item[0] ? true : false,
+                    amount,
+                    change_address_index,
+                    sig_state->dst_address_tag,
+                    &sig_state->dst_address_s,
+                    &sig_state->dst_address_s_v,
+                    &public_key,
+                    &encrypted_secret,
+                    &encrypted_address_type);
+
+        insert_public_key(public_key);
+        insert_public_key(encrypted_secret);
+        insert_var       (encrypted_address_type);
+    }
+
+    if (sig_state->status == SIG_STATE_EXPECT_USER_CONFIRMATION)
+        return user_confirm_tx(state);
+    if (iobuf->pending)
+    {
+        const uint16_t rest = iobuf->pending / BYTECOIN_SIG_ADD_OUTPUTS_ITEM_SIZE * (2 * 32 + 1);
+        return SW_BYTES_REMAINING_00 | (rest > 0xFF ? 0 : rest);
+    }
     return rc;
 }
 
-int bytecoin_apdu_sig_add_output_final(void)
+// sig_add_output of every item in turn. The responses follow one another, the
+// first ones answer the command and the others INS_GET_RESPONSE.
+int bytecoin_apdu_sig_add_outputs(bytecoin_v_state_t* state)
+{
+    bytecoin_sig_add_outputs_cmd_t cmd;
+    bytecoin_parse_sig_add_outputs(&state->sig_state, &state->io_buffer, &cmd);
+
+    const uint8_t count = cmd.outputs.length / BYTECOIN_SIG_ADD_OUTPUTS_ITEM_SIZE;
+    if (!count || cmd.outputs.length % BYTECOIN_SIG_ADD_OUTPUTS_ITEM_SIZE)
+        THROW(SW_WRONG_LENGTH);
+    if (count > state->sig_state.outputs_num - state->sig_state.outputs_counter)
+        THROW(SW_WRONG_DATA);
+    for (uint8_t i = 0; i < count; ++i)
+        if (!cmd.outputs.data[i * BYTECOIN_SIG_ADD_OUTPUTS_ITEM_SIZE])
+        {
+            sig_set_dst_address(&state->sig_state, cmd.dst_address_tag, cmd.dst_address_s, cmd.dst_address_s_v);
+            break;
+        }
+
+    // the items move to the end of the buffer, the responses grow from its
+    // start and overwrite only the items done
+    io_buffer_t* iobuf = &state->io_buffer;
+    os_memmove(iobuf->data + iobuf->size - cmd.outputs.length, cmd.outputs.data, cmd.outputs.length);
+    iobuf->pending = cmd.outputs.length;
+    iobuf->pending_ins = INS_SIG_ADD_OUTPUTS;
+    return add_pending_outputs(state);
+}
+
+int bytecoin_apdu_sig_add_output_final(bytecoin_v_state_t* state)
 {
-    sig_add_output_final(&G_bytecoin_vstate.sig_state);
+    sig_add_output_final(&state->sig_state);
     return SW_NO_ERROR;
 }
 
-int bytecoin_apdu_sig_add_extra(void)
+int bytecoin_apdu_sig_add_extra(bytecoin_v_state_t* state)
 {
-    const uint8_t len = fetch_var(uint8_t);
+    // a chained command carries the extra without the length, every APDU is
+    // hashed in place
+    if (state->io_buffer.chunk != IO_CHUNK_WHOLE)
+    {
+        sig_add_extra(&state->sig_state, state->io_buffer.data, state->io_buffer.length);
+        reset_io_buffer(&state->io_buffer);
+        return SW_NO_ERROR;
+    }
+    bytecoin_sig_add_extra_cmd_t cmd;
+    bytecoin_parse_sig_add_extra(&state->sig_state, &state->io_buffer, &cmd);
 
-    if (len > BYTECOIN_MAX_BUFFER_SIZE)
-        THROW(SW_NOT_ENOUGH_MEMORY);
-    uint8_t buf[BYTECOIN_MAX_BUFFER_SIZE];
-    fetch_bytes_from_io_buffer(&G_bytecoin_vstate.io_buffer, buf, len);
-    reset_io_buffer(&G_bytecoin_vstate.io_buffer);
+    sig_add_extra(&state->sig_state, cmd.extra.data, cmd.extra.length);
+
+    return SW_NO_ERROR;
+}
 
-    sig_add_extra(&G_bytecoin_vstate.sig_state, buf, len);
+#if BYTECOIN_PREFIX_OUTPUTS > BYTECOIN_ADD_OUTPUTS_PER_RESPONSE
+#error the outputs derived after a piece of the prefix do not fit a response
+#endif
 
+// The transaction prefix up to the extra size, see bytecoin_prefix.h, streamed
+// as a chained command cut anywhere. The response to every APDU holds the
+// outputs derived after it, at most BYTECOIN_PREFIX_OUTPUTS; the last output
+// asks for the confirmation.
+int bytecoin_apdu_sig_prefix(bytecoin_v_state_t* state)
+{
+    io_buffer_t* iobuf = &state->io_buffer;
+    bytecoin_signing_state_t* sig_state = &state->sig_state;
+
+    if (iobuf->chunk & IO_CHUNK_FIRST)
+        prefix_start(&state->prefix, sig_state);
+    prefix_update(&state->prefix, sig_state, &state->wallet_keys, &state->address_cache, iobuf->data, iobuf->length);
+    if ((iobuf->chunk & IO_CHUNK_LAST) && !prefix_done(&state->prefix))
+        THROW(SW_WRONG_LENGTH);
+    reset_io_buffer(iobuf);
+
+    bytecoin_prefix_output_t output;
+    while (prefix_next_output(&state->prefix, &output))
+    {
+        public_key_t public_key;
+        public_key_t encrypted_secret;
+        uint8_t encrypted_address_type;
+
+        sig_add_output(
+                    sig_state,
+                    &state->wallet_keys,
+                    &state->address_cache,
+                    output.change,
+                    output.amount,
+                    output.change_address_index,
+                    sig_state->dst_address_tag,
+                    &sig_state->dst_address_s,
+                    &sig_state->dst_address_s_v,
+                    &public_key,
+                    &encrypted_secret,
+                    &encrypted_address_type);
+
+        insert_public_key(public_key);
+        insert_public_key(encrypted_secret);
+        insert_var       (encrypted_address_type);
+    }
+
+    if (sig_state->status == SIG_STATE_EXPECT_USER_CONFIRMATION)
+        return user_confirm_tx(state);
     return SW_NO_ERROR;
 }
 
-int bytecoin_apdu_sig_step_a(void)
+int bytecoin_apdu_sig_step_a(bytecoin_v_state_t* state)
 {
-    const uint8_t len = fetch_var(uint8_t);
-    if (len > BYTECOIN_MAX_BUFFER_SIZE)
-        THROW(SW_NOT_ENOUGH_MEMORY);
-    uint8_t output_secret_hash_arg[BYTECOIN_MAX_BUFFER_SIZE];
-    fetch_bytes_from_io_buffer(&G_bytecoin_vstate.io_buffer, output_secret_hash_arg, len);
-    const uint32_t address_index = fetch_var(uint32_t);
-    reset_io_buffer(&G_bytecoin_vstate.io_buffer);
+    bytecoin_sig_step_a_cmd_t cmd;
+    bytecoin_parse_sig_step_a(&state->sig_state, &state->io_buffer, &cmd);
 
     elliptic_curve_point_t sig_p;
     elliptic_curve_point_t y;
     elliptic_curve_point_t z;
 
-    sig_step_a(&G_bytecoin_vstate.sig_state,
-               &G_bytecoin_vstate.wallet_keys,
-               output_secret_hash_arg,
-               len,
-               address_index,
+    sig_step_a(&state->sig_state,
+               &state->wallet_keys,
+               &state->address_cache,
+               cmd.output_secret_hash_arg.data,
+               cmd.output_secret_hash_arg.length,
+               cmd.address_index,
                &sig_p,
                &y,
                &z);
@@ -259,54 +532,175 @@ int bytecoin_apdu_sig_step_a(void)
     return SW_NO_ERROR;
 }
 
-int bytecoin_apdu_sig_step_a_more_data(void)
+int bytecoin_apdu_sig_step_a_more_data(bytecoin_v_state_t* state)
+{
+    bytecoin_sig_step_a_more_data_cmd_t cmd;
+    bytecoin_parse_sig_step_a_more_data(&state->sig_state, &state->io_buffer, &cmd);
+
+    sig_step_a_more_data(&state->sig_state, cmd.data.data, cmd.data.length);
+
+    return SW_NO_ERROR;
+}
+
+// the inputs of a grouped step move to the end of the buffer, the responses
+// grow from its start and overwrite only the inputs done
+static
+void move_inputs_to_end(io_buffer_t* iobuf, const bytecoin_bytes_t* bytes, io_buffer_t* inputs)
+{
+    os_memset(inputs, 0, sizeof(*inputs));
+    inputs->data = iobuf->data + iobuf->size - bytes->length;
+    inputs->length = bytes->length;
+    inputs->size = bytes->length;
+    os_memmove(inputs->data, bytes->data, bytes->length);
+}
+
+// the responses to the inputs done must not reach the next one
+static
+void check_next_input(const io_buffer_t* iobuf, const io_buffer_t* inputs, uint8_t done, uint8_t max, uint16_t response_size)
 {
-    const uint8_t len = fetch_var(uint8_t);
-    if (len > BYTECOIN_MAX_BUFFER_SIZE)
+    if (done == max)
+        THROW(SW_WRONG_LENGTH);
+    if (done * response_size > iobuf->size - inputs->length + inputs->offset)
         THROW(SW_NOT_ENOUGH_MEMORY);
-    uint8_t buf[BYTECOIN_MAX_BUFFER_SIZE];
-    fetch_bytes_from_io_buffer(&G_bytecoin_vstate.io_buffer, buf, len);
-    reset_io_buffer(&G_bytecoin_vstate.io_buffer);
+}
+
+typedef struct step_a_input_s
+{
+    const uint8_t* arg;
+    uint8_t arg_len;
+    uint32_t address_index;
+    const uint8_t* data;
+    uint8_t data_len;
+} step_a_input_t;
+
+static
+void fetch_step_a_input(io_buffer_t* inputs, step_a_input_t* input)
+{
+    input->arg_len = fetch_var_from_io_buffer(inputs, sizeof(input->arg_len));
+    input->arg = fetch_view_from_io_buffer(inputs, input->arg_len);
+    input->address_index = fetch_var_from_io_buffer(inputs, sizeof(input->address_index));
+    input->data_len = fetch_var_from_io_buffer(inputs, sizeof(input->data_len));
+    input->data = fetch_view_from_io_buffer(inputs, input->data_len);
+}
+
+// sig_step_a and sig_step_a_more_data of every input in turn, the responses of
+// sig_step_a follow one another. The ring data of the last input may go on
+// with INS_SIG_STEP_A_MORE_DATA.
+int bytecoin_apdu_sig_step_a_inputs(bytecoin_v_state_t* state)
+{
+    bytecoin_sig_step_a_inputs_cmd_t cmd;
+    bytecoin_parse_sig_step_a_inputs(&state->sig_state, &state->io_buffer, &cmd);
 
-    sig_step_a_more_data(&G_bytecoin_vstate.sig_state, buf, len);
+    io_buffer_t inputs;
+    move_inputs_to_end(&state->io_buffer, &cmd.inputs, &inputs);
+
+    // checked in full before the first input is hashed
+    step_a_input_t input;
+    uint8_t count = 0;
+    for (; inputs.offset < inputs.length; ++count)
+    {
+        check_next_input(&state->io_buffer, &inputs, count, BYTECOIN_STEP_A_INPUTS_PER_RESPONSE, 3 * 32);
+        fetch_step_a_input(&inputs, &input);
+    }
+    if (!count)
+        THROW(SW_WRONG_LENGTH);
+    // after the ring data of an input the counter still points at it
+    const bytecoin_signing_state_t* sig_state = &state->sig_state;
+    const uint16_t next_input = sig_state->inputs_counter + (sig_state->status == SIG_STATE_EXPECT_STEP_A_MORE_DATA ? 1 : 0);
+    if (count > sig_state->inputs_num - next_input)
+        THROW(SW_WRONG_DATA);
+
+    inputs.offset = 0;
+    for (uint8_t i = 0; i < count; ++i)
+    {
+        fetch_step_a_input(&inputs, &input);
+
+        elliptic_curve_point_t sig_p;
+        elliptic_curve_point_t y;
+        elliptic_curve_point_t z;
+
+        sig_step_a(&state->sig_state,
+                   &state->wallet_keys,
+                   &state->address_cache,
+                   input.arg,
+                   input.arg_len,
+                   input.address_index,
+                   &sig_p,
+                   &y,
+                   &z);
+        sig_step_a_more_data(&state->sig_state, input.data, input.data_len);
+
+        insert_point(sig_p);
+        insert_point(y);
+        insert_point(z);
+    }
+
+    return SW_NO_ERROR;
+}
+
+static
+const bytecoin_input_token_t* token_view(const bytecoin_bytes_t* token)
+{
+    if (token->length != BYTECOIN_INPUT_TOKEN_SIZE)
+        THROW(SW_WRONG_LENGTH);
+    return (const bytecoin_input_token_t*)token->data;
+}
+
+int bytecoin_apdu_sig_step_a_token(bytecoin_v_state_t* state)
+{
+    bytecoin_sig_step_a_token_cmd_t cmd;
+    bytecoin_parse_sig_step_a_token(&state->sig_state, &state->io_buffer, &cmd);
+
+    elliptic_curve_point_t sig_p;
+    elliptic_curve_point_t y;
+    elliptic_curve_point_t z;
+
+    sig_step_a_token(&state->sig_state, &state->wallet_keys, token_view(&cmd.token), &sig_p, &y, &z);
+
+    insert_point(sig_p);
+    insert_point(y);
+    insert_point(z);
 
     return SW_NO_ERROR;
 }
 
-int bytecoin_apdu_sig_get_c0(void)
+int bytecoin_apdu_sig_get_c0(bytecoin_v_state_t* state)
 {
-    reset_io_buffer(&G_bytecoin_vstate.io_buffer);
+    bytecoin_parse_sig_get_c0(&state->sig_state, &state->io_buffer);
 
     elliptic_curve_scalar_t c0;
-    sig_get_c0(&G_bytecoin_vstate.sig_state, &c0);
+    sig_get_c0(&state->sig_state, &c0);
 
     insert_scalar(c0);
 
     return SW_NO_ERROR;
 }
 
-int bytecoin_apdu_sig_step_b(void)
+// the step B commands encrypt with encrypt_scalars() given P1_STEP_B_KEY_STREAM
+static
+bool key_stream_requested(const bytecoin_v_state_t* state)
 {
-    const uint8_t len = fetch_var(uint8_t);
-    if (len > BYTECOIN_MAX_BUFFER_SIZE)
-        THROW(SW_NOT_ENOUGH_MEMORY);
-    uint8_t output_secret_hash_arg[BYTECOIN_MAX_BUFFER_SIZE];
-    fetch_bytes_from_io_buffer(&G_bytecoin_vstate.io_buffer, output_secret_hash_arg, len);
-    const uint32_t address_index = fetch_var(uint32_t);
-    const elliptic_curve_scalar_t my_c = fetch_scalar();
-    reset_io_buffer(&G_bytecoin_vstate.io_buffer);
+    return state->prev_io_call_params.p1 == P1_STEP_B_KEY_STREAM;
+}
+
+int bytecoin_apdu_sig_step_b(bytecoin_v_state_t* state)
+{
+    bytecoin_sig_step_b_cmd_t cmd;
+    bytecoin_parse_sig_step_b(&state->sig_state, &state->io_buffer, &cmd);
 
     hash_t sig_my_rr;
     hash_t sig_rs;
     hash_t sig_ra;
     hash_t e_key;
 
-    sig_step_b(&G_bytecoin_vstate.sig_state,
-               &G_bytecoin_vstate.wallet_keys,
-               output_secret_hash_arg,
-               len,
-               address_index,
-               &my_c,
+    sig_step_b(&state->sig_state,
+               &state->wallet_keys,
+               &state->address_cache,
+               cmd.output_secret_hash_arg.data,
+               cmd.output_secret_hash_arg.length,
+               cmd.address_index,
+               cmd.my_c,
+               key_stream_requested(state),
                &sig_my_rr,
                &sig_rs,
                &sig_ra,
@@ -320,23 +714,114 @@ int bytecoin_apdu_sig_step_b(void)
     return SW_NO_ERROR;
 }
 
+int bytecoin_apdu_sig_step_b_token(bytecoin_v_state_t* state)
+{
+    bytecoin_sig_step_b_token_cmd_t cmd;
+    bytecoin_parse_sig_step_b_token(&state->sig_state, &state->io_buffer, &cmd);
+
+    hash_t sig_my_rr;
+    hash_t sig_rs;
+    hash_t sig_ra;
+    hash_t e_key;
+
+    sig_step_b_token(&state->sig_state, &state->wallet_keys, token_view(&cmd.token), cmd.my_c, key_stream_requested(state), &sig_my_rr, &sig_rs, &sig_ra, &e_key);
+
+    insert_hash(sig_my_rr);
+    insert_hash(sig_rs);
+    insert_hash(sig_ra);
+    insert_hash(e_key);
+
+    return SW_NO_ERROR;
+}
 
-int bytecoin_apdu_export_view_only(void)
+typedef struct step_b_input_s
+{
+    const uint8_t* arg;
+    uint8_t arg_len;
+    uint32_t address_index;
+    elliptic_curve_scalar_t my_c;
+} step_b_input_t;
+
+static
+void fetch_step_b_input(io_buffer_t* inputs, step_b_input_t* input)
 {
-    reset_io_buffer(&G_bytecoin_vstate.io_buffer);
-    return user_confirm_export_view_only();
+    input->arg_len = fetch_var_from_io_buffer(inputs, sizeof(input->arg_len));
+    input->arg = fetch_view_from_io_buffer(inputs, input->arg_len);
+    input->address_index = fetch_var_from_io_buffer(inputs, sizeof(input->address_index));
+    input->my_c = fetch_scalar_from_io_buffer(inputs);
 }
 
-int bytecoin_apdu_export_view_only_final(bool view_outgoing_addresses)
+// sig_step_b of every input in turn, the response holds sig_my_rr, sig_rs and
+// sig_ra of every input and e_key of the last one
+int bytecoin_apdu_sig_step_b_inputs(bytecoin_v_state_t* state)
 {
-    reset_io_buffer(&G_bytecoin_vstate.io_buffer);
+    bytecoin_sig_step_b_inputs_cmd_t cmd;
+    bytecoin_parse_sig_step_b_inputs(&state->sig_state, &state->io_buffer, &cmd);
+
+    io_buffer_t inputs;
+    move_inputs_to_end(&state->io_buffer, &cmd.inputs, &inputs);
+
+    step_b_input_t input;
+    uint8_t count = 0;
+    for (; inputs.offset < inputs.length; ++count)
+    {
+        check_next_input(&state->io_buffer, &inputs, count, BYTECOIN_STEP_B_INPUTS_PER_RESPONSE, 3 * 32);
+        fetch_step_b_input(&inputs, &input);
+    }
+    if (!count)
+        THROW(SW_WRONG_LENGTH);
+    if (count > state->sig_state.inputs_num - state->sig_state.inputs_counter)
+        THROW(SW_WRONG_DATA);
+
+    hash_t e_key;
+    const bool key_stream = key_stream_requested(state);
+    inputs.offset = 0;
+    for (uint8_t i = 0; i < count; ++i)
+    {
+        fetch_step_b_input(&inputs, &input);
+
+        hash_t sig_my_rr;
+        hash_t sig_rs;
+        hash_t sig_ra;
+
+        sig_step_b(&state->sig_state,
+                   &state->wallet_keys,
+                   &state->address_cache,
+                   input.arg,
+                   input.arg_len,
+                   input.address_index,
+                   &input.my_c,
+                   key_stream,
+                   &sig_my_rr,
+                   &sig_rs,
+                   &sig_ra,
+                   &e_key);
+
+        insert_hash(sig_my_rr);
+        insert_hash(sig_rs);
+        insert_hash(sig_ra);
+    }
+    insert_hash(e_key);
+
+    return SW_NO_ERROR;
+}
+
+int bytecoin_apdu_export_view_only(bytecoin_v_state_t* state)
+{
+    bytecoin_parse_export_view_only(&state->sig_state, &state->io_buffer);
+    return user_confirm_export_view_only(state);
+}
+
+int bytecoin_apdu_export_view_only_final(bytecoin_v_state_t* state, bool view_outgoing_addresses)
+{
+    reset_io_buffer(&state->io_buffer);
 
     secret_key_t audit_key_base_secret_key;
     secret_key_t view_secret_key;
     hash_t tx_derivation_seed;
     signature_t view_secrets_signature;
 
-    export_view_only(&G_bytecoin_vstate.wallet_keys,
+    export_view_only(&state->wallet_keys,
                      &audit_key_base_secret_key,
                      &view_secret_key,
                      &tx_derivation_seed,
@@ -355,12 +840,224 @@ int bytecoin_apdu_export_view_only_final(bool view_outgoing_addresses)
     return SW_NO_ERROR;
 }
 
-int bytecoin_apdu_sig_proof_start(void)
+int bytecoin_apdu_sig_proof_start(bytecoin_v_state_t* state)
+{
+    bytecoin_sig_proof_start_cmd_t cmd;
+    bytecoin_parse_sig_proof_start(&state->sig_state, &state->io_buffer, &cmd);
+
+    sig_proof_start(&state->sig_state, cmd.len);
+
+    return SW_NO_ERROR;
+}
+
+#ifdef BYTECOIN_STATS
+// ins, calls, errors, bytes in and bytes out of every instruction called since
+// the last reset, starting from the INS in P2; a full page means there may be
+// more. P1 = 1 resets the reported counters.
+#define STATS_ENTRY_SIZE        15
+#define STATS_ENTRIES_PER_PAGE  ((0xFE - 2) / STATS_ENTRY_SIZE)
+
+int bytecoin_apdu_get_stats(bytecoin_v_state_t* state)
+{
+    const uint8_t reset = state->prev_io_call_params.p1;
+    const uint8_t first_ins = state->prev_io_call_params.p2;
+    bytecoin_parse_get_stats(&state->sig_state, &state->io_buffer);
+
+    uint8_t entries = 0;
+    for (uint8_t slot = 0; slot < BYTECOIN_STATS_SLOTS && entries < STATS_ENTRIES_PER_PAGE; ++slot)
+    {
+        bytecoin_ins_stats_t* s = &state->stats.ins[slot];
+        const uint8_t ins = stats_slot_ins(slot);
+        if (ins < first_ins || !s->calls)
+            continue;
+        insert_var(ins);
+        insert_var(s->calls);
+        insert_var(s->errors);
+        insert_var(s->bytes_in);
+        insert_var(s->bytes_out);
+        if (reset == 1)
+            os_memset(s, 0, sizeof(bytecoin_ins_stats_t));
+        ++entries;
+    }
+    return SW_NO_ERROR;
+}
+#endif
+
+#ifdef BYTECOIN_CRYPTO_COUNTERS
+// number of counters followed by the counters of the previous command, in bytecoin_crypto_op_t order
+int bytecoin_apdu_get_crypto_counters(bytecoin_v_state_t* state)
 {
-    const uint32_t len = fetch_var(uint32_t);
-    reset_io_buffer(&G_bytecoin_vstate.io_buffer);
+    bytecoin_parse_get_crypto_counters(&state->sig_state, &state->io_buffer);
 
-    sig_proof_start(&G_bytecoin_vstate.sig_state, len);
+    const uint8_t count = CRYPTO_OP_COUNT;
+    insert_var(count);
+    for (uint8_t i = 0; i < count; ++i)
+        insert_var(G_crypto_counters.last[i]);
+    return SW_NO_ERROR;
+}
+#endif
+
+// the response of the command with the sequence number in P1 (high byte) and
+// P2, once more and without running the command again
+int bytecoin_apdu_get_last_response(bytecoin_v_state_t* state)
+{
+    const uint16_t sequence = (uint16_t)(state->prev_io_call_params.p1 << 8 | state->prev_io_call_params.p2);
+    bytecoin_parse_get_last_response(&state->sig_state, &state->io_buffer);
+
+    io_buffer_t* iobuf = &state->io_buffer;
+    if (iobuf->sequence != sequence)
+        THROW(SW_WRONG_DATA);
+    // data sent with the command would have overwritten it
+    if (!iobuf->last_length || sizeof(io_call_params_t) + state->prev_io_call_params.lc > iobuf->last_response)
+        THROW(SW_CONDITIONS_NOT_SATISFIED);
+    const uint8_t* last = iobuf->data + iobuf->last_response;
+    const uint16_t sw = last[iobuf->last_length - 2] << 8 | last[iobuf->last_length - 1];
+    insert_bytes_to_io_buffer(iobuf, last, iobuf->last_length - 2);
+    return sw;
+}
+
+// the rest of a response longer than an APDU, see io_do, or the next outputs
+// of INS_SIG_ADD_OUTPUTS
+int bytecoin_apdu_get_response(bytecoin_v_state_t* state)
+{
+    bytecoin_parse_get_response(&state->sig_state, &state->io_buffer);
+
+    io_buffer_t* iobuf = &state->io_buffer;
+    const uint16_t pending = iobuf->pending;
+    if (!pending)
+        THROW(SW_CONDITIONS_NOT_SATISFIED);
+    if (iobuf->pending_ins == INS_SIG_ADD_OUTPUTS)
+        return add_pending_outputs(state);
+    iobuf->pending = 0;
+    const uint8_t* rest = iobuf->data + iobuf->size - pending;
+    const uint16_t sw = rest[pending - 2] << 8 | rest[pending - 1];
+    os_memmove(iobuf->data, rest, pending - 2);
+    iobuf->length = pending - 2;
+    iobuf->offset = iobuf->length;
+    return sw;
+}
+
+#define APP_INFO_SIZE (3 + 3 + sizeof(XSTR(BYTECOIN_NAME)) - 1 + sizeof(XSTR(BYTECOIN_VERSION)) - 1 + sizeof(XSTR(BYTECOIN_SPEC_VERSION)) - 1)
+
+uint16_t bytecoin_batch_max_response(uint8_t ins)
+{
+    switch (ins)
+    {
+    case INS_RESET:
+    case INS_SIG_START:
+    case INS_SIG_ADD_INPUT_START:
+    case INS_SIG_ADD_INPUT_INDEXES:
+    case INS_SIG_ADD_INPUT_FINISH:
+    case INS_SIG_ADD_INPUT:
+    case INS_SIG_ADD_INPUT_VARINTS:
+    case INS_SIG_ADD_EXTRA:
+    case INS_SIG_STEP_A_MORE_DATA:
+    case INS_SIG_PROOF_START:
+        return 0;
+    case INS_GET_APP_INFO:         return APP_INFO_SIZE;
+    case INS_GET_WALLET_KEYS:      return 4 * 32;
+    case INS_SCAN_OUTPUTS:         return BYTECOIN_MAX_SCAN_OUTPUTS * 32;
+    case INS_GENERATE_KEYIMAGE:    return 32;
+    case INS_GENERATE_OUTPUT_SEED: return 32;
+    case INS_SIG_ADD_OUPUT:        return 2 * 32 + 1;
+    case INS_SIG_STEP_A:           return 3 * 32;
+    case INS_SIG_GET_C0:           return 32;
+    case INS_SIG_STEP_B:           return 4 * 32;
+#ifdef BYTECOIN_STATS
+    case INS_GET_STATS:            return STATS_ENTRIES_PER_PAGE * STATS_ENTRY_SIZE;
+#endif
+#ifdef BYTECOIN_CRYPTO_COUNTERS
+    case INS_GET_CRYPTO_COUNTERS:  return 1 + 2 * CRYPTO_OP_COUNT;
+#endif
+    default:
+        return BYTECOIN_BATCH_NOT_BATCHABLE;
+    }
+}
+
+static
+bool waits_for_user(const bytecoin_v_state_t* state, uint8_t ins)
+{
+    // the last output asks for the confirmation of the transaction
+    return ins == INS_SIG_ADD_OUPUT &&
+           state->sig_state.status == SIG_STATE_EXPECT_OUTPUT &&
+           state->sig_state.outputs_counter + 1 == state->sig_state.outputs_num;
+}
+
+static
+uint16_t run_batch_item(bytecoin_v_state_t* state, uint8_t ins)
+{
+    volatile uint16_t sw = 0;
+    BEGIN_TRY {
+        TRY {
+            sw = dispatch(state, BYTECOIN_CLA, ins);
+        }
+        CATCH_OTHER(e) {
+            reset_io_buffer(&state->io_buffer);
+            sw = ((e & 0xF000) == 0x6000 || (e & 0xF000) == 0x9000) ? e : SW_SOMETHING_WRONG;
+        }
+        FINALLY {
+        }
+    }
+    END_TRY;
+    return sw;
+}
+
+// Several commands in one APDU, each as ins (1), length (1) and data. The
+// response holds length (1), data and sw (2) of every command that ran. The
+// commands run in order and the batch stops after a failed command or before
+// one whose response might not fit; the host sends the rest again. Commands
+// that may wait for the user cannot be batched.
+int bytecoin_apdu_batch(bytecoin_v_state_t* state)
+{
+    const io_buffer_t batch = state->io_buffer;
+    uint8_t* const data = batch.data;
+
+    // the commands see P1 and P2 of the batch
+    if (state->prev_io_call_params.p1 || state->prev_io_call_params.p2)
+        THROW(SW_WRONG_DATA);
+    for (uint16_t pos = 0; pos < batch.length; pos += 2 + data[pos + 1])
+        if (batch.length - pos < 2 || batch.length - pos - 2 < data[pos + 1])
+            THROW(SW_WRONG_LENGTH);
+
+    // the commands move to the end of the buffer, the responses grow from its
+    // start and may overwrite every command that already ran
+    uint16_t next = batch.size - batch.length;
+    os_memmove(data + next, data, batch.length);
+    uint16_t end = 0;
+
+    while (next < batch.size)
+    {
+        const uint8_t ins = data[next];
+        const uint8_t len = data[next + 1];
+        const uint16_t max_response = bytecoin_batch_max_response(ins);
+        const uint16_t room = (next + 2 + len < BYTECOIN_BATCH_MAX_RESPONSE) ? next + 2 + len : BYTECOIN_BATCH_MAX_RESPONSE;
+        uint16_t sw = SW_COMMAND_NOT_ALLOWED;
+        uint8_t response_length = 0;
+        if (max_response != BYTECOIN_BATCH_NOT_BATCHABLE && !waits_for_user(state, ins))
+        {
+            // keeps the responses in front of the commands still to run
+            if (end + 3 + max_response > room)
+                break;
+            os_memmove(data + end + 1, data + next + 2, len);
+            state->io_buffer.data = data + end + 1;
+            state->io_buffer.length = len;
+            state->io_buffer.offset = 0;
+            state->io_buffer.size = max_response;
+            sw = run_batch_item(state, ins);
+            response_length = (uint8_t)state->io_buffer.length;
+            state->io_buffer = batch;
+        }
+        next += 2 + len;
+
+        data[end] = response_length;
+        end += 1 + response_length;
+        data[end++] = (uint8_t)(sw >> 8);
+        data[end++] = (uint8_t)sw;
+        if (sw != SW_NO_ERROR)
+            break;
+    }
 
+    state->io_buffer.length = end;
+    state->io_buffer.offset = end;
     return SW_NO_ERROR;
 }
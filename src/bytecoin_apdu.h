@@ -19,27 +19,63 @@
 #define BYTECOIN_APDU_H
 
 #include <stdbool.h>
+#include "bytecoin_vars.h"
 
-int bytecoin_apdu_get_ledger_app_info(void);
-int bytecoin_apdu_get_wallet_keys(void);
-
-int bytecoin_apdu_scan_outputs(void);
-int bytecoin_apdu_generate_keyimage(void);
-int bytecoin_apdu_generate_output_seed(void);
-int bytecoin_apdu_export_view_only(void);
-int bytecoin_apdu_export_view_only_final(bool view_outgoing_addresses);
-
-int bytecoin_apdu_sig_start(void);
-int bytecoin_apdu_sig_add_input_start(void);
-int bytecoin_apdu_sig_add_input_indexes(void);
-int bytecoin_apdu_sig_add_input_finish(void);
-int bytecoin_apdu_sig_add_output(void);
-int bytecoin_apdu_sig_add_output_final(void);
-int bytecoin_apdu_sig_add_extra(void);
-int bytecoin_apdu_sig_step_a(void);
-int bytecoin_apdu_sig_step_a_more_data(void);
-int bytecoin_apdu_sig_get_c0(void);
-int bytecoin_apdu_sig_step_b(void);
-int bytecoin_apdu_sig_proof_start(void);
+int bytecoin_apdu_get_ledger_app_info(bytecoin_v_state_t* state);
+int bytecoin_apdu_get_wallet_keys(bytecoin_v_state_t* state);
+
+int bytecoin_apdu_scan_outputs(bytecoin_v_state_t* state);
+int bytecoin_apdu_generate_keyimage(bytecoin_v_state_t* state);
+int bytecoin_apdu_generate_output_seed(bytecoin_v_state_t* state);
+int bytecoin_apdu_export_view_only(bytecoin_v_state_t* state);
+int bytecoin_apdu_export_view_only_final(bytecoin_v_state_t* state, bool view_outgoing_addresses);
+
+int bytecoin_apdu_sig_start(bytecoin_v_state_t* state);
+int bytecoin_apdu_sig_add_input_start(bytecoin_v_state_t* state);
+int bytecoin_apdu_sig_add_input_indexes(bytecoin_v_state_t* state);
+int bytecoin_apdu_sig_add_input_finish(bytecoin_v_state_t* state);
+int bytecoin_apdu_sig_add_input(bytecoin_v_state_t* state);
+int bytecoin_apdu_sig_add_input_varints(bytecoin_v_state_t* state);
+int bytecoin_apdu_sig_add_output(bytecoin_v_state_t* state);
+int bytecoin_apdu_sig_add_outputs(bytecoin_v_state_t* state);
+int bytecoin_apdu_sig_add_output_final(bytecoin_v_state_t* state);
+int bytecoin_apdu_sig_add_extra(bytecoin_v_state_t* state);
+int bytecoin_apdu_sig_prefix(bytecoin_v_state_t* state);
+int bytecoin_apdu_sig_step_a(bytecoin_v_state_t* state);
+int bytecoin_apdu_sig_step_a_more_data(bytecoin_v_state_t* state);
+int bytecoin_apdu_sig_step_a_inputs(bytecoin_v_state_t* state);
+int bytecoin_apdu_sig_get_c0(bytecoin_v_state_t* state);
+int bytecoin_apdu_sig_step_b(bytecoin_v_state_t* state);
+int bytecoin_apdu_sig_step_b_inputs(bytecoin_v_state_t* state);
+int bytecoin_apdu_sig_step_a_token(bytecoin_v_state_t* state);
+int bytecoin_apdu_sig_step_b_token(bytecoin_v_state_t* state);
+int bytecoin_apdu_sig_proof_start(bytecoin_v_state_t* state);
+#ifdef BYTECOIN_STATS
+int bytecoin_apdu_get_stats(bytecoin_v_state_t* state);
+#endif
+int bytecoin_apdu_batch(bytecoin_v_state_t* state);
+int bytecoin_apdu_get_last_response(bytecoin_v_state_t* state);
+int bytecoin_apdu_get_response(bytecoin_v_state_t* state);
+
+// the item responses of a batch have to fit one response APDU
+#define BYTECOIN_BATCH_MAX_RESPONSE   (0xFE - 2)
+#define BYTECOIN_BATCH_NOT_BATCHABLE  0xFFFF
+
+// outputs of INS_SIG_ADD_OUTPUTS per response, the command and every
+// INS_GET_RESPONSE after it answer this many
+#define BYTECOIN_ADD_OUTPUTS_PER_RESPONSE ((0xFE - 2) / (2 * 32 + 1))
+
+// inputs of one INS_SIG_STEP_A_INPUTS, as many as one response carries
+#define BYTECOIN_STEP_A_INPUTS_PER_RESPONSE ((0xFE - 2) / (3 * 32))
+
+// inputs of one INS_SIG_STEP_B_INPUTS, e_key follows the last one
+#define BYTECOIN_STEP_B_INPUTS_PER_RESPONSE ((0xFE - 2 - 32) / (3 * 32))
+
+// longest response of the handler of ins, BYTECOIN_BATCH_NOT_BATCHABLE for
+// the commands a batch cannot carry
+uint16_t bytecoin_batch_max_response(uint8_t ins);
+#ifdef BYTECOIN_CRYPTO_COUNTERS
+int bytecoin_apdu_get_crypto_counters(bytecoin_v_state_t* state);
+#endif
 
 #endif // BYTECOIN_APDU_H
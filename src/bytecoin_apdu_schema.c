@@ -0,0 +1,139 @@
+/*******************************************************************************
+*   Bytecoin Wallet for Ledger Nano S
+*   (c) 2018 - 2019 The Bytecoin developers
+*
+*  Licensed under the Apache License, Version 2.0 (the "License");
+*  you may not use this file except in compliance with the License.
+*  You may obtain a copy of the License at
+*
+*      http://www.apache.org/licenses/LICENSE-2.0
+*
+*  Unless required by applicable law or agreed to in writing, software
+*  distributed under the License is distributed on an "AS IS" BASIS,
+*  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+*  See the License for the specific language governing permissions and
+*  limitations under the License.
+********************************************************************************/
+
+#include "os.h"
+#include "bytecoin_apdu_schema.h"
+
+uint32_t bytecoin_u32s_at(const bytecoin_u32s_t* u32s, uint8_t i)
+{
+    const uint8_t* p = u32s->data + 4 * i;
+    return (uint32_t)p[0] << 24 | (uint32_t)p[1] << 16 | (uint32_t)p[2] << 8 | p[3];
+}
+
+static
+void parse_U8(io_buffer_t* iobuf, uint8_t* field, uint16_t max)
+{
+    *field = fetch_var_from_io_buffer(iobuf, sizeof(*field));
+}
+
+static
+void parse_U32(io_buffer_t* iobuf, uint32_t* field, uint16_t max)
+{
+    *field = fetch_var_from_io_buffer(iobuf, sizeof(*field));
+}
+
+static
+void parse_U64(io_buffer_t* iobuf, uint64_t* field, uint16_t max)
+{
+    *field = fetch_var_from_io_buffer(iobuf, sizeof(*field));
+}
+
+static
+void parse_HASH(io_buffer_t* iobuf, const hash_t** field, uint16_t max)
+{
+    *field = (const hash_t*)fetch_view_from_io_buffer(iobuf, sizeof(hash_t));
+}
+
+static
+void parse_POINT(io_buffer_t* iobuf, const elliptic_curve_point_t** field, uint16_t max)
+{
+    *field = (const elliptic_curve_point_t*)fetch_view_from_io_buffer(iobuf, sizeof(elliptic_curve_point_t));
+}
+
+// reversed in place
+static
+void parse_SCALAR(io_buffer_t* iobuf, const elliptic_curve_scalar_t** field, uint16_t max)
+{
+    uint8_t* data = fetch_view_from_io_buffer(iobuf, sizeof(elliptic_curve_scalar_t));
+    reverse(data, data, sizeof(elliptic_curve_scalar_t));
+    *field = (const elliptic_curve_scalar_t*)data;
+}
+
+static
+uint8_t fetch_count(io_buffer_t* iobuf, uint16_t max)
+{
+    const uint8_t count = fetch_var_from_io_buffer(iobuf, sizeof(count));
+    if (count > max)
+        THROW(SW_NOT_ENOUGH_MEMORY);
+    return count;
+}
+
+static
+void parse_BYTES(io_buffer_t* iobuf, bytecoin_bytes_t* field, uint16_t max)
+{
+    field->length = fetch_count(iobuf, max);
+    field->data = fetch_view_from_io_buffer(iobuf, field->length);
+}
+
+static
+void parse_POINTS(io_buffer_t* iobuf, bytecoin_points_t* field, uint16_t max)
+{
+    field->count = fetch_count(iobuf, max);
+    field->items = (const elliptic_curve_point_t*)fetch_view_from_io_buffer(iobuf, field->count * sizeof(elliptic_curve_point_t));
+}
+
+static
+void parse_U32S(io_buffer_t* iobuf, bytecoin_u32s_t* field, uint16_t max)
+{
+    field->count = fetch_count(iobuf, max);
+    field->data = fetch_view_from_io_buffer(iobuf, field->count * 4);
+}
+
+static
+void parse_VARINTS(io_buffer_t* iobuf, bytecoin_varints_t* field, uint16_t max)
+{
+    field->count = fetch_count(iobuf, max);
+    field->data = iobuf->data + iobuf->offset;
+    const uint16_t start = iobuf->offset;
+    for (uint8_t i = 0; i < field->count; ++i)
+        fetch_varint_from_io_buffer(iobuf);
+    field->length = iobuf->offset - start;
+}
+
+static
+void check_sig_state(const bytecoin_signing_state_t* sig_state, uint16_t states)
+{
+    if (!(states & SIG_STATE_BIT(sig_state->status)))
+        THROW(SW_COMMAND_NOT_ALLOWED);
+}
+
+// bytes after the fields are ignored, as the handlers always did; the response
+// starts from an empty buffer
+static
+void finish(io_buffer_t* iobuf)
+{
+    reset_io_buffer(iobuf);
+}
+
+#define PARSE_FIELD(type, name, max) parse_##type(iobuf, &cmd->name, max);
+
+#define DEFINE_PARSER(name, ins, fields, states) \
+void bytecoin_parse_##name(const bytecoin_signing_state_t* sig_state, io_buffer_t* iobuf, bytecoin_##name##_cmd_t* cmd) \
+{ \
+    check_sig_state(sig_state, states); \
+    fields(PARSE_FIELD) \
+    finish(iobuf); \
+}
+BYTECOIN_APDU_COMMANDS(DEFINE_PARSER)
+
+#define DEFINE_EMPTY_PARSER(name, ins, states) \
+void bytecoin_parse_##name(const bytecoin_signing_state_t* sig_state, io_buffer_t* iobuf) \
+{ \
+    check_sig_state(sig_state, states); \
+    finish(iobuf); \
+}
+BYTECOIN_APDU_EMPTY_COMMANDS(DEFINE_EMPTY_PARSER)
@@ -0,0 +1,229 @@
+/*******************************************************************************
+*   Bytecoin Wallet for Ledger Nano S
+*   (c) 2018 - 2019 The Bytecoin developers
+*
+*  Licensed under the Apache License, Version 2.0 (the "License");
+*  you may not use this file except in compliance with the License.
+*  You may obtain a copy of the License at
+*
+*      http://www.apache.org/licenses/LICENSE-2.0
+*
+*  Unless required by applicable law or agreed to in writing, software
+*  distributed under the License is distributed on an "AS IS" BASIS,
+*  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+*  See the License for the specific language governing permissions and
+*  limitations under the License.
+********************************************************************************/
+
+#ifndef BYTECOIN_APDU_SCHEMA_H
+#define BYTECOIN_APDU_SCHEMA_H
+
+#include <stdint.h>
+#include "bytecoin_crypto.h"
+#include "bytecoin_io.h"
+#include "bytecoin_ledger_api.h"
+#include "bytecoin_sig.h"
+
+// The payload of every command, one X-macro per INS. A field is
+// F(type, name, max) with the types
+//   U8, U32, U64  big endian integers
+//   HASH, POINT   32 bytes as they are
+//   SCALAR        32 bytes, reversed
+//   BYTES         length (1) and at most max bytes
+//   POINTS        count (1) and at most max points
+//   U32S          count (1) and at most max big endian u32
+//   VARINTS       count (1) and at most max varints of at most 32 bits
+// The parsers check the whole payload and the signing state before a handler
+// runs and give it views into the io buffer instead of copies, so a handler
+// must not insert its response before it is done with its command. The host
+// encoders are generated from the same lists, see bytecoin_host.h.
+// INS_BATCH, INS_SIG_PREFIX and the chained forms of sig_add_extra,
+// sig_add_input_indexes, sig_add_input and sig_add_input_varints are parsed by
+// their handlers.
+
+#define BYTECOIN_CMD_SCAN_OUTPUTS(F) \
+    F(POINTS, output_public_keys,     BYTECOIN_MAX_SCAN_OUTPUTS)
+
+#define BYTECOIN_CMD_GENERATE_KEYIMAGE(F) \
+    F(BYTES,  output_secret_hash_arg, BYTECOIN_MAX_BUFFER_SIZE) \
+    F(U32,    address_index,          0)
+
+#define BYTECOIN_CMD_GENERATE_OUTPUT_SEED(F) \
+    F(HASH,   tx_inputs_hash,         0) \
+    F(U32,    out_index,              0)
+
+#define BYTECOIN_CMD_SIG_START(F) \
+    F(U32,    version,                0) \
+    F(U64,    unlock_time,            0) \
+    F(U32,    inputs_num,             0) \
+    F(U32,    outputs_num,            0) \
+    F(U32,    extra_num,              0)
+
+#define BYTECOIN_CMD_SIG_ADD_INPUT_START(F) \
+    F(U64,    amount,                 0) \
+    F(U32,    output_indexes_count,   0)
+
+#define BYTECOIN_CMD_SIG_ADD_INPUT_INDEXES(F) \
+    F(U32S,   output_indexes,         BYTECOIN_MAX_OUTPUT_INDEXES)
+
+#define BYTECOIN_CMD_SIG_ADD_INPUT_FINISH(F) \
+    F(BYTES,  output_secret_hash_arg, BYTECOIN_MAX_BUFFER_SIZE) \
+    F(U32,    address_index,          0)
+
+// sig_add_input_start, _indexes and _finish in one command
+#define BYTECOIN_CMD_SIG_ADD_INPUT(F) \
+    F(U64,    amount,                 0) \
+    F(U32S,   output_indexes,         BYTECOIN_MAX_RING_SIZE) \
+    F(BYTES,  output_secret_hash_arg, BYTECOIN_MAX_BUFFER_SIZE) \
+    F(U32,    address_index,          0)
+
+// the same with the indexes as varints, the way the transaction has them
+#define BYTECOIN_CMD_SIG_ADD_INPUT_VARINTS(F) \
+    F(U64,    amount,                 0) \
+    F(VARINTS, output_indexes,        BYTECOIN_MAX_RING_SIZE) \
+    F(BYTES,  output_secret_hash_arg, BYTECOIN_MAX_BUFFER_SIZE) \
+    F(U32,    address_index,          0)
+
+#define BYTECOIN_CMD_SIG_ADD_OUTPUT(F) \
+    F(U8,     change,                 0) \
+    F(U64,    amount,                 0) \
+    F(U32,    change_address_index,   0) \
+    F(U8,     dst_address_tag,        0) \
+    F(POINT,  dst_address_s,          0) \
+    F(POINT,  dst_address_s_v,        0)
+
+// one destination and change (1), amount (8) and change_address_index (4) of
+// every output
+#define BYTECOIN_SIG_ADD_OUTPUTS_ITEM_SIZE 13
+#define BYTECOIN_CMD_SIG_ADD_OUTPUTS(F) \
+    F(U8,     dst_address_tag,        0) \
+    F(POINT,  dst_address_s,          0) \
+    F(POINT,  dst_address_s_v,        0) \
+    F(BYTES,  outputs,                BYTECOIN_MAX_ADD_OUTPUTS * BYTECOIN_SIG_ADD_OUTPUTS_ITEM_SIZE)
+
+#define BYTECOIN_CMD_SIG_ADD_EXTRA(F) \
+    F(BYTES,  extra,                  BYTECOIN_MAX_BUFFER_SIZE)
+
+#define BYTECOIN_CMD_SIG_STEP_A(F) \
+    F(BYTES,  output_secret_hash_arg, BYTECOIN_MAX_BUFFER_SIZE) \
+    F(U32,    address_index,          0)
+
+#define BYTECOIN_CMD_SIG_STEP_A_MORE_DATA(F) \
+    F(BYTES,  data,                   BYTECOIN_MAX_BUFFER_SIZE)
+
+// every input as arg_length (1), arg, address_index (4), data_length (1) and
+// the ring data hashed after it
+#define BYTECOIN_CMD_SIG_STEP_A_INPUTS(F) \
+    F(BYTES,  inputs,                 BYTECOIN_MAX_STEP_INPUTS)
+
+#define BYTECOIN_CMD_SIG_STEP_B(F) \
+    F(BYTES,  output_secret_hash_arg, BYTECOIN_MAX_BUFFER_SIZE) \
+    F(U32,    address_index,          0) \
+    F(SCALAR, my_c,                   0)
+
+// every input as arg_length (1), arg, address_index (4) and my_c (32, reversed)
+#define BYTECOIN_CMD_SIG_STEP_B_INPUTS(F) \
+    F(BYTES,  inputs,                 BYTECOIN_MAX_STEP_INPUTS)
+
+// sig_step_a and sig_step_b with the token of the input in place of its key
+// image arguments, see bytecoin_sig.h
+#define BYTECOIN_CMD_SIG_STEP_A_TOKEN(F) \
+    F(BYTES,  token,                  BYTECOIN_INPUT_TOKEN_SIZE)
+
+#define BYTECOIN_CMD_SIG_STEP_B_TOKEN(F) \
+    F(BYTES,  token,                  BYTECOIN_INPUT_TOKEN_SIZE) \
+    F(SCALAR, my_c,                   0)
+
+#define BYTECOIN_CMD_SIG_PROOF_START(F) \
+    F(U32,    len,                    0)
+
+// signing states in which a command is accepted; the handlers check the rest
+#define SIG_STATE_BIT(status) (1u << (status))
+#define SIG_STATE_ANY         0xFFFFu
+
+// C(name, ins, fields, signing states)
+#define BYTECOIN_APDU_COMMANDS(C) \
+    C(scan_outputs,           INS_SCAN_OUTPUTS,          BYTECOIN_CMD_SCAN_OUTPUTS,           SIG_STATE_ANY) \
+    C(generate_keyimage,      INS_GENERATE_KEYIMAGE,     BYTECOIN_CMD_GENERATE_KEYIMAGE,      SIG_STATE_ANY) \
+    C(generate_output_seed,   INS_GENERATE_OUTPUT_SEED,  BYTECOIN_CMD_GENERATE_OUTPUT_SEED,   SIG_STATE_ANY) \
+    C(sig_start,              INS_SIG_START,             BYTECOIN_CMD_SIG_START,              SIG_STATE_ANY) \
+    C(sig_add_input_start,    INS_SIG_ADD_INPUT_START,   BYTECOIN_CMD_SIG_ADD_INPUT_START,    SIG_STATE_BIT(SIG_STATE_EXPECT_INPUT_START)) \
+    C(sig_add_input_indexes,  INS_SIG_ADD_INPUT_INDEXES, BYTECOIN_CMD_SIG_ADD_INPUT_INDEXES,  SIG_STATE_BIT(SIG_STATE_EXPECT_INPUT_INDEXES)) \
+    C(sig_add_input_finish,   INS_SIG_ADD_INPUT_FINISH,  BYTECOIN_CMD_SIG_ADD_INPUT_FINISH,   SIG_STATE_BIT(SIG_STATE_EXPECT_INPUT_FINISH)) \
+    C(sig_add_input,          INS_SIG_ADD_INPUT,         BYTECOIN_CMD_SIG_ADD_INPUT,          SIG_STATE_BIT(SIG_STATE_EXPECT_INPUT_START)) \
+    C(sig_add_input_varints,  INS_SIG_ADD_INPUT_VARINTS, BYTECOIN_CMD_SIG_ADD_INPUT_VARINTS,  SIG_STATE_BIT(SIG_STATE_EXPECT_INPUT_START)) \
+    C(sig_add_output,         INS_SIG_ADD_OUPUT,         BYTECOIN_CMD_SIG_ADD_OUTPUT,         SIG_STATE_BIT(SIG_STATE_EXPECT_OUTPUT)) \
+    C(sig_add_outputs,        INS_SIG_ADD_OUTPUTS,       BYTECOIN_CMD_SIG_ADD_OUTPUTS,        SIG_STATE_BIT(SIG_STATE_EXPECT_OUTPUT)) \
+    C(sig_add_extra,          INS_SIG_ADD_EXTRA,         BYTECOIN_CMD_SIG_ADD_EXTRA,          SIG_STATE_BIT(SIG_STATE_EXPECT_EXTRA_CHUNK)) \
+    C(sig_step_a,             INS_SIG_STEP_A,            BYTECOIN_CMD_SIG_STEP_A,             SIG_STATE_BIT(SIG_STATE_EXPECT_STEP_A) | SIG_STATE_BIT(SIG_STATE_EXPECT_STEP_A_MORE_DATA)) \
+    C(sig_step_a_more_data,   INS_SIG_STEP_A_MORE_DATA,  BYTECOIN_CMD_SIG_STEP_A_MORE_DATA,   SIG_STATE_BIT(SIG_STATE_EXPECT_STEP_A_MORE_DATA)) \
+    C(sig_step_a_inputs,      INS_SIG_STEP_A_INPUTS,     BYTECOIN_CMD_SIG_STEP_A_INPUTS,      SIG_STATE_BIT(SIG_STATE_EXPECT_STEP_A) | SIG_STATE_BIT(SIG_STATE_EXPECT_STEP_A_MORE_DATA)) \
+    C(sig_step_b,             INS_SIG_STEP_B,            BYTECOIN_CMD_SIG_STEP_B,             SIG_STATE_BIT(SIG_STATE_EXPECT_STEP_B)) \
+    C(sig_step_b_inputs,      INS_SIG_STEP_B_INPUTS,     BYTECOIN_CMD_SIG_STEP_B_INPUTS,      SIG_STATE_BIT(SIG_STATE_EXPECT_STEP_B)) \
+    C(sig_step_a_token,       INS_SIG_STEP_A_TOKEN,      BYTECOIN_CMD_SIG_STEP_A_TOKEN,       SIG_STATE_BIT(SIG_STATE_EXPECT_STEP_A) | SIG_STATE_BIT(SIG_STATE_EXPECT_STEP_A_MORE_DATA)) \
+    C(sig_step_b_token,       INS_SIG_STEP_B_TOKEN,      BYTECOIN_CMD_SIG_STEP_B_TOKEN,       SIG_STATE_BIT(SIG_STATE_EXPECT_STEP_B)) \
+    C(sig_proof_start,        INS_SIG_PROOF_START,       BYTECOIN_CMD_SIG_PROOF_START,        SIG_STATE_ANY)
+
+// commands without payload, E(name, ins, signing states)
+#define BYTECOIN_APDU_EMPTY_COMMANDS(E) \
+    E(reset,                  INS_RESET,                 SIG_STATE_ANY) \
+    E(get_app_info,           INS_GET_APP_INFO,          SIG_STATE_ANY) \
+    E(get_wallet_keys,        INS_GET_WALLET_KEYS,       SIG_STATE_ANY) \
+    E(export_view_only,       INS_EXPORT_VIEW_ONLY,      SIG_STATE_ANY) \
+    E(sig_get_c0,             INS_SIG_GET_C0,            SIG_STATE_BIT(SIG_STATE_EXPECT_STEP_A_MORE_DATA)) \
+    E(get_stats,              INS_GET_STATS,             SIG_STATE_ANY) \
+    E(get_crypto_counters,    INS_GET_CRYPTO_COUNTERS,   SIG_STATE_ANY) \
+    E(get_last_response,      INS_GET_LAST_RESPONSE,     SIG_STATE_ANY) \
+    E(get_response,           INS_GET_RESPONSE,          SIG_STATE_ANY)
+
+typedef struct bytecoin_bytes_s
+{
+    const uint8_t* data;
+    uint8_t length;
+} bytecoin_bytes_t;
+
+typedef struct bytecoin_points_s
+{
+    const elliptic_curve_point_t* items;
+    uint8_t count;
+} bytecoin_points_t;
+
+typedef struct bytecoin_u32s_s
+{
+    const uint8_t* data; // big endian
+    uint8_t count;
+} bytecoin_u32s_t;
+
+uint32_t bytecoin_u32s_at(const bytecoin_u32s_t* u32s, uint8_t i);
+
+typedef struct bytecoin_varints_s
+{
+    const uint8_t* data;
+    uint16_t length; // in bytes
+    uint8_t count;
+} bytecoin_varints_t;
+
+#define BYTECOIN_FIELD_TYPE_U8     uint8_t
+#define BYTECOIN_FIELD_TYPE_U32    uint32_t
+#define BYTECOIN_FIELD_TYPE_U64    uint64_t
+#define BYTECOIN_FIELD_TYPE_HASH   const hash_t*
+#define BYTECOIN_FIELD_TYPE_POINT  const elliptic_curve_point_t*
+#define BYTECOIN_FIELD_TYPE_SCALAR const elliptic_curve_scalar_t*
+#define BYTECOIN_FIELD_TYPE_BYTES  bytecoin_bytes_t
+#define BYTECOIN_FIELD_TYPE_POINTS bytecoin_points_t
+#define BYTECOIN_FIELD_TYPE_U32S   bytecoin_u32s_t
+#define BYTECOIN_FIELD_TYPE_VARINTS bytecoin_varints_t
+
+#define BYTECOIN_FIELD_DECLARE(type, name, max) BYTECOIN_FIELD_TYPE_##type name;
+
+// bytecoin_<name>_cmd_t and bytecoin_parse_<name>() of every command
+#define BYTECOIN_CMD_DECLARE(name, ins, fields, states) \
+    typedef struct bytecoin_##name##_cmd_s { fields(BYTECOIN_FIELD_DECLARE) } bytecoin_##name##_cmd_t; \
+    void bytecoin_parse_##name(const bytecoin_signing_state_t* sig_state, io_buffer_t* iobuf, bytecoin_##name##_cmd_t* cmd);
+BYTECOIN_APDU_COMMANDS(BYTECOIN_CMD_DECLARE)
+
+#define BYTECOIN_EMPTY_CMD_DECLARE(name, ins, states) \
+    void bytecoin_parse_##name(const bytecoin_signing_state_t* sig_state, io_buffer_t* iobuf);
+BYTECOIN_APDU_EMPTY_COMMANDS(BYTECOIN_EMPTY_CMD_DECLARE)
+
+#endif // BYTECOIN_APDU_SCHEMA_H
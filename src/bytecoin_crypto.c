@@ -20,6 +20,7 @@
 #include "bytecoin_crypto.h"
 #include "bytecoin_fe.h"
 #include "bytecoin_debug.h"
+#include "bytecoin_stats.h"
 
 static const uint8_t C_ED25519_G[] = {
     //uncompressed
@@ -60,6 +61,7 @@ const uint8_t C_ED25519_2_256[] = {
 //static
 void compress_point(decompressed_point_t* point, elliptic_curve_point_t* result)
 {
+    COUNT_CRYPTO_OP(CRYPTO_OP_COMPRESS_POINT);
     cx_edward_compress_point(CX_CURVE_Ed25519, point->data, sizeof(point->data));
     os_memmove(result->data, &point->data[1], sizeof(result->data));
 }
@@ -67,6 +69,7 @@ void compress_point(decompressed_point_t* point, elliptic_curve_point_t* result)
 static
 void decompress_point(const elliptic_curve_point_t* point, decompressed_point_t* result)
 {
+    COUNT_CRYPTO_OP(CRYPTO_OP_DECOMPRESS_POINT);
     result->data[0] = 0x02;
     os_memmove(&result->data[1], point->data, sizeof(point->data));
     cx_edward_decompress_point(CX_CURVE_Ed25519, result->data, sizeof(result->data));
@@ -117,13 +120,6 @@ void keccak_final_to_scalar(keccak_hasher_t* hasher, elliptic_curve_scalar_t* re
     reduce32(&hash, result);
 }
 
-void keccak_final_to_scalar64(keccak_hasher_t* hasher, elliptic_curve_scalar_t* result)
-{
-    hash_t hash;
-    keccak_final(hasher, &hash);
-    reduce64(&hash, result);
-}
-
 void keccak_final_to_good_point(keccak_hasher_t* hasher, elliptic_curve_point_t* result)
 {
     hash_t hash;
@@ -169,19 +165,19 @@ size_t encode_varint(uint64_t value, uint8_t* buf)
 
 void reduce32(const hash_t* h, elliptic_curve_scalar_t* result)
 {
+    COUNT_CRYPTO_OP(CRYPTO_OP_REDUCE32);
     reverse(result->data, h->data, sizeof(h->data));
     cx_math_modm(result->data, sizeof(result->data), C_ED25519_ORDER, sizeof(C_ED25519_ORDER));
 }
 
-void reduce64(const hash_t* h, elliptic_curve_scalar_t* result)
+// left + right * 2^256, both little endian
+static
+void reduce_halves(const hash_t* left_hash, const hash_t* right_hash, elliptic_curve_scalar_t* result)
 {
-    const hash_t* left_hash = h;
-    hash_t right_hash;
-    fast_hash(left_hash->data, sizeof(left_hash->data), &right_hash);
     secret_key_t left;
     reduce32(left_hash, &left);
     secret_key_t right;
-    reduce32(&right_hash, &right);
+    reduce32(right_hash, &right);
 
     elliptic_curve_scalar_t sc_2_256;
     os_memmove(sc_2_256.data, C_ED25519_2_256, sizeof(C_ED25519_2_256));
@@ -190,8 +186,25 @@ void reduce64(const hash_t* h, elliptic_curve_scalar_t* result)
     ecaddm(result, &left, result);
 }
 
+void reduce64(const hash_t* h, elliptic_curve_scalar_t* result)
+{
+    COUNT_CRYPTO_OP(CRYPTO_OP_REDUCE64);
+    hash_t right_hash;
+    fast_hash(h->data, sizeof(h->data), &right_hash);
+    reduce_halves(h, &right_hash, result);
+}
+
+void reduce64_wide(const uint8_t wide[64], elliptic_curve_scalar_t* result)
+{
+    COUNT_CRYPTO_OP(CRYPTO_OP_REDUCE64);
+    hash_t halves[2];
+    os_memmove(halves, wide, sizeof(halves));
+    reduce_halves(&halves[0], &halves[1], result);
+}
+
 void invert32(const elliptic_curve_scalar_t *a, elliptic_curve_scalar_t* result)
 {
+    COUNT_CRYPTO_OP(CRYPTO_OP_INVERT32);
     os_memmove(result->data, a->data, sizeof(a->data));
     cx_math_invprimem(result->data, a->data, C_ED25519_ORDER, sizeof(C_ED25519_ORDER));
 }
@@ -203,6 +216,7 @@ void ecmulm(const elliptic_curve_scalar_t* a, const elliptic_curve_scalar_t* b,
 
 void ecmul(const elliptic_curve_point_t* point, const elliptic_curve_scalar_t* scalar, elliptic_curve_point_t* result)
 {
+    COUNT_CRYPTO_OP(CRYPTO_OP_ECMUL);
     decompressed_point_t Pxy;
     decompress_point(point, &Pxy);
     cx_ecfp_scalar_mult(CX_CURVE_Ed25519, Pxy.data, sizeof(Pxy.data), scalar->data, sizeof(scalar->data));
@@ -212,6 +226,7 @@ void ecmul(const elliptic_curve_point_t* point, const elliptic_curve_scalar_t* s
 static
 void d_ecmul(decompressed_point_t* point, const elliptic_curve_scalar_t* scalar, elliptic_curve_point_t* result)
 {
+    COUNT_CRYPTO_OP(CRYPTO_OP_D_ECMUL);
     cx_ecfp_scalar_mult(CX_CURVE_Ed25519, point->data, sizeof(point->data), scalar->data, sizeof(scalar->data));
     compress_point(point, result);
 }
@@ -232,6 +247,7 @@ void ecmul_H(const elliptic_curve_scalar_t* scalar, elliptic_curve_point_t* resu
 
 void ecadd(const elliptic_curve_point_t* P, const elliptic_curve_point_t* Q, elliptic_curve_point_t* result)
 {
+    COUNT_CRYPTO_OP(CRYPTO_OP_ECADD);
     decompressed_point_t Pxy;
     decompressed_point_t Qxy;
     decompress_point(P, &Pxy);
@@ -242,6 +258,7 @@ void ecadd(const elliptic_curve_point_t* P, const elliptic_curve_point_t* Q, ell
 
 void d_ecadd(const decompressed_point_t* P, const decompressed_point_t* Q, elliptic_curve_point_t* result)
 {
+    COUNT_CRYPTO_OP(CRYPTO_OP_D_ECADD);
     decompressed_point_t Rxy;
     cx_ecfp_add_point(CX_CURVE_Ed25519, Rxy.data, P->data, Q->data, sizeof(Rxy.data));
     compress_point(&Rxy, result);
@@ -249,6 +266,7 @@ void d_ecadd(const decompressed_point_t* P, const decompressed_point_t* Q, ellip
 
 void ecsub(const elliptic_curve_point_t* P, const elliptic_curve_point_t* Q, elliptic_curve_point_t* result)
 {
+    COUNT_CRYPTO_OP(CRYPTO_OP_ECSUB);
     decompressed_point_t Pxy;
     decompressed_point_t minus_Qxy;
     decompress_point(P, &Pxy);
@@ -308,6 +326,7 @@ void hash_scalar_to_good_point(const elliptic_curve_scalar_t* s, elliptic_curve_
 
 void ecmul_8(const elliptic_curve_point_t* P, elliptic_curve_point_t* result)
 {
+    COUNT_CRYPTO_OP(CRYPTO_OP_ECMUL_8);
     decompressed_point_t d_result;
     decompress_point(P, &d_result);
     cx_ecfp_add_point(CX_CURVE_Ed25519, d_result.data, d_result.data, d_result.data, sizeof(d_result.data));
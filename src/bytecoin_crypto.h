@@ -63,11 +63,12 @@ void keccak_update_varint(keccak_hasher_t* hasher, uint64_t value);
 void keccak_update_byte(keccak_hasher_t* hasher, uint8_t value);
 void keccak_final(keccak_hasher_t* hasher, hash_t* result);
 void keccak_final_to_scalar(keccak_hasher_t* hasher, elliptic_curve_scalar_t* result);
-void keccak_final_to_scalar64(keccak_hasher_t* hasher, elliptic_curve_scalar_t* result);
 void keccak_final_to_good_point(keccak_hasher_t* hasher, elliptic_curve_point_t* result);
 
 void reduce32(const hash_t* hash, elliptic_curve_scalar_t* result);
 void reduce64(const hash_t* left_hash, elliptic_curve_scalar_t* result);
+// 64 bytes taken as one little endian number
+void reduce64_wide(const uint8_t wide[64], elliptic_curve_scalar_t* result);
 void invert32(const elliptic_curve_scalar_t* a, elliptic_curve_scalar_t* result);
 
 void ecmulm(const elliptic_curve_scalar_t* a, const elliptic_curve_scalar_t* b, elliptic_curve_scalar_t* result);
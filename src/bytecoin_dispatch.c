@@ -0,0 +1,183 @@
+/*******************************************************************************
+*   Bytecoin Wallet for Ledger Nano S
+*   (c) 2018 - 2019 The Bytecoin developers
+*
+*  Licensed under the Apache License, Version 2.0 (the "License");
+*  you may not use this file except in compliance with the License.
+*  You may obtain a copy of the License at
+*
+*      http://www.apache.org/licenses/LICENSE-2.0
+*
+*  Unless required by applicable law or agreed to in writing, software
+*  distributed under the License is distributed on an "AS IS" BASIS,
+*  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+*  See the License for the specific language governing permissions and
+*  limitations under the License.
+********************************************************************************/
+
+#include "os.h"
+#include "bytecoin_dispatch.h"
+#include "bytecoin_ledger_api.h"
+#include "bytecoin_vars.h"
+#include "bytecoin_apdu.h"
+#include "bytecoin_apdu_schema.h"
+
+int dispatch(bytecoin_v_state_t* state, uint8_t cla, uint8_t ins)
+{
+    int sw = SW_INS_NOT_SUPPORTED;
+
+    if (cla != BYTECOIN_CLA)
+    {
+        THROW(SW_CLA_NOT_SUPPORTED);
+        return SW_CLA_NOT_SUPPORTED;
+    }
+
+    // a few handlers consume a chained command chunk by chunk, the others get
+    // it whole and answer only its last APDU
+    const bool streamed =
+            (ins == INS_SIG_ADD_INPUT_INDEXES || ins == INS_SIG_ADD_INPUT || ins == INS_SIG_ADD_INPUT_VARINTS ||
+             ins == INS_SIG_ADD_EXTRA || ins == INS_SIG_PREFIX);
+    if (state->io_buffer.chunk != IO_CHUNK_WHOLE && !streamed && !gather_chunk(&state->io_buffer))
+        return SW_NO_ERROR;
+
+    switch(ins)
+    {
+    case INS_RESET:
+        bytecoin_parse_reset(&state->sig_state, &state->io_buffer);
+        return SW_NO_ERROR;
+
+    case INS_GET_APP_INFO:
+        sw = bytecoin_apdu_get_ledger_app_info(state); break;
+    case INS_GET_WALLET_KEYS:
+        sw = bytecoin_apdu_get_wallet_keys(state); break;
+    case INS_SCAN_OUTPUTS:
+        sw = bytecoin_apdu_scan_outputs(state); break;
+    case INS_GENERATE_KEYIMAGE:
+        sw = bytecoin_apdu_generate_keyimage(state); break;
+    case INS_GENERATE_OUTPUT_SEED:
+        sw = bytecoin_apdu_generate_output_seed(state); break;
+    case INS_SIG_START:
+        sw = bytecoin_apdu_sig_start(state); break;
+    case INS_SIG_ADD_INPUT_START:
+        sw = bytecoin_apdu_sig_add_input_start(state); break;
+    case INS_SIG_ADD_INPUT_INDEXES:
+        sw = bytecoin_apdu_sig_add_input_indexes(state); break;
+    case INS_SIG_ADD_INPUT_FINISH:
+        sw = bytecoin_apdu_sig_add_input_finish(state); break;
+    case INS_SIG_ADD_INPUT:
+        sw = bytecoin_apdu_sig_add_input(state); break;
+    case INS_SIG_ADD_INPUT_VARINTS:
+        sw = bytecoin_apdu_sig_add_input_varints(state); break;
+    case INS_SIG_ADD_OUPUT:
+        sw = bytecoin_apdu_sig_add_output(state); break;
+    case INS_SIG_ADD_OUTPUTS:
+        sw = bytecoin_apdu_sig_add_outputs(state); break;
+    case INS_SIG_ADD_EXTRA:
+        sw = bytecoin_apdu_sig_add_extra(state); break;
+    case INS_SIG_PREFIX:
+        sw = bytecoin_apdu_sig_prefix(state); break;
+    case INS_SIG_STEP_A:
+        sw = bytecoin_apdu_sig_step_a(state); break;
+    case INS_SIG_STEP_A_MORE_DATA:
+        sw = bytecoin_apdu_sig_step_a_more_data(state); break;
+    case INS_SIG_STEP_A_INPUTS:
+        sw = bytecoin_apdu_sig_step_a_inputs(state); break;
+    case INS_SIG_GET_C0:
+        sw = bytecoin_apdu_sig_get_c0(state); break;
+    case INS_SIG_STEP_B:
+        sw = bytecoin_apdu_sig_step_b(state); break;
+    case INS_SIG_STEP_B_INPUTS:
+        sw = bytecoin_apdu_sig_step_b_inputs(state); break;
+    case INS_SIG_STEP_A_TOKEN:
+        sw = bytecoin_apdu_sig_step_a_token(state); break;
+    case INS_SIG_STEP_B_TOKEN:
+        sw = bytecoin_apdu_sig_step_b_token(state); break;
+    case INS_SIG_PROOF_START:
+        sw = bytecoin_apdu_sig_proof_start(state); break;
+    case INS_EXPORT_VIEW_ONLY:
+        sw = bytecoin_apdu_export_view_only(state); break;
+#ifdef BYTECOIN_STATS
+    case INS_GET_STATS:
+        sw = bytecoin_apdu_get_stats(state); break;
+#endif
+    case INS_BATCH:
+        sw = bytecoin_apdu_batch(state); break;
+    case INS_GET_LAST_RESPONSE:
+        sw = bytecoin_apdu_get_last_response(state); break;
+    case INS_GET_RESPONSE:
+        sw = bytecoin_apdu_get_response(state); break;
+#ifdef BYTECOIN_CRYPTO_COUNTERS
+    case INS_GET_CRYPTO_COUNTERS:
+        sw = bytecoin_apdu_get_crypto_counters(state); break;
+#endif
+
+    default:
+      THROW(SW_INS_NOT_SUPPORTED);
+      return SW_INS_NOT_SUPPORTED;
+      break;
+    }
+    return sw;
+}
+
+void finish_response(bytecoin_v_state_t* state, uint16_t sw)
+{
+    insert_var(sw);
+    keep_last_response(&state->io_buffer, state->prev_io_call_params.ins);
+}
+
+void bytecoin_main(bytecoin_v_state_t* state)
+{
+    volatile uint32_t io_flags = 0;
+
+    // DESIGN NOTE: the bootloader ignores the way APDU are fetched. The only
+    // goal is to retrieve APDU.
+    // When APDU are to be fetched from multiple IOs, like NFC+USB+BLE, make
+    // sure the io_event is called with a
+    // switch event, before the apdu is replied to the bootloader. This avoid
+    // APDU injection faults.
+    for (;;)
+    {
+        volatile uint16_t sw = 0;
+
+        BEGIN_TRY {
+            TRY {
+                io_do(&state->prev_io_call_params, &state->io_buffer, io_flags);
+#ifdef BYTECOIN_STATS
+                stats_begin(&state->stats, state->prev_io_call_params.ins, state->io_buffer.length);
+#endif
+#ifdef BYTECOIN_CRYPTO_COUNTERS
+                next_crypto_counters();
+#endif
+                sw = dispatch(state, state->prev_io_call_params.cla & ~CHAINING_BIT, state->prev_io_call_params.ins);
+            }
+            CATCH_OTHER(e) {
+                clear_io_buffer(&state->io_buffer);
+                // an error ends the chained command, the next APDU starts a new one
+                state->prev_io_call_params.cla &= ~CHAINING_BIT;
+
+                if ((e & 0xF000) != 0x6000 && (e & 0xF000) != 0x9000)
+                {
+                    insert_var(e);
+                    sw = SW_SOMETHING_WRONG;
+                }
+                else
+                    sw = e;
+            }
+            FINALLY {
+                if (sw)
+                {
+                    finish_response(state, sw);
+                    io_flags = 0;
+                }
+                else
+                  io_flags = IO_ASYNCH_REPLY;
+#ifdef BYTECOIN_STATS
+                stats_end(&state->stats, sw, state->io_buffer.length);
+#endif
+            }
+        }
+        END_TRY;
+    }
+
+    return;
+}
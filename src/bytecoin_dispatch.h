@@ -0,0 +1,33 @@
+/*******************************************************************************
+*   Bytecoin Wallet for Ledger Nano S
+*   (c) 2018 - 2019 The Bytecoin developers
+*
+*  Licensed under the Apache License, Version 2.0 (the "License");
+*  you may not use this file except in compliance with the License.
+*  You may obtain a copy of the License at
+*
+*      http://www.apache.org/licenses/LICENSE-2.0
+*
+*  Unless required by applicable law or agreed to in writing, software
+*  distributed under the License is distributed on an "AS IS" BASIS,
+*  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+*  See the License for the specific language governing permissions and
+*  limitations under the License.
+********************************************************************************/
+
+#ifndef BYTECOIN_DISPATCH_H
+#define BYTECOIN_DISPATCH_H
+
+#include <stdint.h>
+#include "bytecoin_vars.h"
+
+int dispatch(bytecoin_v_state_t* state, uint8_t cla, uint8_t ins);
+
+// appends sw to the response in the io buffer and keeps it for
+// INS_GET_LAST_RESPONSE, io_do() then sends it
+void finish_response(bytecoin_v_state_t* state, uint16_t sw);
+
+// never returns, exchanges APDUs with the host and dispatches them to state
+void bytecoin_main(bytecoin_v_state_t* state);
+
+#endif // BYTECOIN_DISPATCH_H
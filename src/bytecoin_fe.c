@@ -17,6 +17,17 @@
 
 #include "bytecoin_fe.h"
 #include "bytecoin_vars.h"
+#include "bytecoin_stats.h"
+
+#ifdef BYTECOIN_CRYPTO_COUNTERS
+#define cx_math_modm(...)      (COUNT_CRYPTO_OP(CRYPTO_OP_FE_MATH), cx_math_modm(__VA_ARGS__))
+#define cx_math_multm(...)     (COUNT_CRYPTO_OP(CRYPTO_OP_FE_MATH), cx_math_multm(__VA_ARGS__))
+#define cx_math_addm(...)      (COUNT_CRYPTO_OP(CRYPTO_OP_FE_MATH), cx_math_addm(__VA_ARGS__))
+#define cx_math_subm(...)      (COUNT_CRYPTO_OP(CRYPTO_OP_FE_MATH), cx_math_subm(__VA_ARGS__))
+#define cx_math_powm(...)      (COUNT_CRYPTO_OP(CRYPTO_OP_FE_MATH), cx_math_powm(__VA_ARGS__))
+#define cx_math_invprimem(...) (COUNT_CRYPTO_OP(CRYPTO_OP_FE_MATH), cx_math_invprimem(__VA_ARGS__))
+#define cx_math_is_zero(...)   (COUNT_CRYPTO_OP(CRYPTO_OP_FE_MATH), cx_math_is_zero(__VA_ARGS__))
+#endif
 
 extern const uint8_t C_ED25519_FIELD[];
 
@@ -170,6 +181,7 @@ bool is_scalar_negative(const elliptic_curve_scalar_t* a)
 
 void ge_fromfe_frombytes(const hash_t* bytes, elliptic_curve_point_t* result)
 {
+    COUNT_CRYPTO_OP(CRYPTO_OP_GE_FROMFE_FROMBYTES);
     union
     {
         elliptic_curve_scalar_t s[6];
@@ -286,6 +298,7 @@ void ge_fromfe_frombytes(const hash_t* bytes, elliptic_curve_point_t* result)
 
 void ge_fromfe_frombytes(const hash_t* bytes, elliptic_curve_point_t* result)
 {
+    COUNT_CRYPTO_OP(CRYPTO_OP_GE_FROMFE_FROMBYTES);
     #define  MOD (unsigned char *)C_ED25519_FIELD,32
     #define fe_isnegative(f)      (f[31]&1)
 
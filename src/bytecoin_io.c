@@ -20,17 +20,31 @@
 #include "bytecoin_io.h"
 #include "bytecoin_ledger_api.h"
 
-unsigned char G_io_seproxyhal_spi_buffer[IO_SEPROXYHAL_BUFFER_SIZE_B];
-
 void init_io_call_params(io_call_params_t* ioparams)
 {
     os_memset(ioparams, 0, sizeof(io_call_params_t));
 }
 
-void init_io_buffer(io_buffer_t* iobuf)
+void init_io_buffer(io_buffer_t* iobuf, uint8_t* data)
 {
     os_memset(iobuf, 0 , sizeof(io_buffer_t));
-    iobuf->data = G_io_apdu_buffer;
+    iobuf->data = data;
+    iobuf->size = BYTECOIN_IO_BUFFER_SIZE;
+    iobuf->chunk = IO_CHUNK_WHOLE;
+}
+
+void keep_last_response(io_buffer_t* iobuf, uint8_t ins)
+{
+    if (ins == INS_GET_LAST_RESPONSE)
+        return;
+    iobuf->sequence = (ins == INS_RESET) ? 0 : iobuf->sequence + 1;
+    // out of reach of the command asking for it and of its copy to the start
+    const uint16_t room = iobuf->size - iobuf->pending;
+    const bool fits = (iobuf->length <= IO_LAST_RESPONSE_SIZE && !iobuf->gathered &&
+                       sizeof(io_call_params_t) + iobuf->length <= room && 2 * iobuf->length <= room);
+    iobuf->last_length = fits ? iobuf->length : 0;
+    iobuf->last_response = room - iobuf->last_length;
+    os_memmove(iobuf->data + iobuf->last_response, iobuf->data, iobuf->last_length);
 }
 
 static
@@ -45,7 +59,7 @@ void check_available(const io_buffer_t* iobuf, uint16_t len)
 static
 void make_hole(io_buffer_t* iobuf, uint16_t len)
 {
-    if (iobuf->length + len > BYTECOIN_IO_BUFFER_SIZE)
+    if (iobuf->length + len > iobuf->size)
         THROW(SW_NOT_ENOUGH_MEMORY);
     if (iobuf->length < iobuf->offset)
         THROW(SW_CONDITIONS_NOT_SATISFIED);
@@ -67,6 +81,14 @@ void fetch_bytes_from_io_buffer(io_buffer_t* iobuf, void* buf, uint16_t len)
     iobuf->offset += len;
 }
 
+uint8_t* fetch_view_from_io_buffer(io_buffer_t* iobuf, uint16_t len)
+{
+    check_available(iobuf, len);
+    uint8_t* view = iobuf->data + iobuf->offset;
+    iobuf->offset += len;
+    return view;
+}
+
 void insert_bytes_to_io_buffer(io_buffer_t* iobuf, const void* buf, uint16_t len)
 {
     make_hole(iobuf, len);
@@ -144,6 +166,21 @@ uint64_t fetch_var_from_io_buffer(io_buffer_t* iobuf, uint16_t len)
     return var;
 }
 
+// a varint of at most 32 bits in its minimal encoding, as the transaction has it
+uint32_t fetch_varint_from_io_buffer(io_buffer_t* iobuf)
+{
+    uint32_t var = 0;
+    for (uint8_t shift = 0; ; shift += 7)
+    {
+        const uint8_t byte = fetch_var_from_io_buffer(iobuf, sizeof(byte));
+        if ((shift == 28 && byte > 0x0F) || (shift && !byte))
+            THROW(SW_WRONG_DATA);
+        var |= (uint32_t)(byte & 0x7F) << shift;
+        if (!(byte & 0x80))
+            return var;
+    }
+}
+
 void reset_io_buffer(io_buffer_t* iobuf)
 {
     iobuf->offset = 0;
@@ -153,7 +190,12 @@ void reset_io_buffer(io_buffer_t* iobuf)
 void clear_io_buffer(io_buffer_t* iobuf)
 {
     reset_io_buffer(iobuf);
-    os_memset(iobuf->data, 0, BYTECOIN_IO_BUFFER_SIZE);
+    iobuf->pending = 0;
+    iobuf->gathered = 0;
+    // all but the last response, which INS_GET_LAST_RESPONSE may still ask for
+    const uint16_t kept_end = iobuf->last_response + iobuf->last_length;
+    os_memset(iobuf->data, 0, iobuf->last_response);
+    os_memset(iobuf->data + kept_end, 0, iobuf->size - kept_end);
 }
 
 #define MAX_OUT 0xFE
@@ -161,14 +203,9 @@ void clear_io_buffer(io_buffer_t* iobuf)
 #error MAX_OUT must be less than size of G_io_apdu_buffer
 #endif
 
-// chaining flag is in bit 5 of cla. see 5.1.1.1 of ISO/IEC 7816-4
-#define CHAINING_BIT 0x10
-
 int io_do(io_call_params_t* previous_iocall_params, io_buffer_t* iobuf, uint32_t io_flags)
 {
-    const io_call_t* new_iocall = (const io_call_t*)G_io_apdu_buffer;
-    if (previous_iocall_params->cla & CHAINING_BIT)
-        goto in_chaining;
+    const io_call_t* new_iocall = (const io_call_t*)iobuf->data;
 
     if (io_flags & IO_ASYNCH_REPLY)
     {
@@ -178,29 +215,19 @@ int io_do(io_call_params_t* previous_iocall_params, io_buffer_t* iobuf, uint32_t
     }
     else
     {
-        // full out chaining
-        iobuf->offset = 0;
-        while(iobuf->length > MAX_OUT)
+        // out chaining: the first MAX_OUT - 2 bytes go with 61xx, the rest
+        // waits at the end of the buffer for INS_GET_RESPONSE, see
+        // bytecoin_apdu_get_response
+        if (iobuf->length > MAX_OUT)
         {
-            const uint32_t tx =  MAX_OUT - 2;
-//            os_memmove(G_io_apdu_buffer, iobuf->data + iobuf->offset, tx);
-            iobuf->length -= tx;
-            iobuf->offset += tx;
-            G_io_apdu_buffer[tx] = (SW_BYTES_REMAINING_00 >> 8);
-            G_io_apdu_buffer[tx + 1] = (iobuf->length > MAX_OUT - 2) ? MAX_OUT - 2 : iobuf->length - 2;
-            io_exchange(CHANNEL_APDU, tx + 2);
-
-            // check get response
-            if (new_iocall->params.cla != BYTECOIN_CLA ||
-                new_iocall->params.ins != INS_GET_RESPONSE ||
-                new_iocall->params.p1 != 0x00 ||
-                new_iocall->params.p2 != 0x00)
-            {
-                THROW(SW_COMMAND_NOT_ALLOWED);
-                return 0;
-            }
+            const uint16_t tx = MAX_OUT - 2;
+            iobuf->pending = iobuf->length - tx;
+            iobuf->pending_ins = INS_NONE;
+            os_memmove(iobuf->data + iobuf->size - iobuf->pending, iobuf->data + tx, iobuf->pending);
+            iobuf->data[tx] = (SW_BYTES_REMAINING_00 >> 8);
+            iobuf->data[tx + 1] = (iobuf->pending - 2 > 0xFF) ? 0 : iobuf->pending - 2;
+            iobuf->length = tx + 2;
         }
-//        os_memmove(G_io_apdu_buffer, iobuf->data + iobuf->offset, iobuf->length);
 
         if (io_flags & IO_RETURN_AFTER_TX)
         {
@@ -213,11 +240,28 @@ int io_do(io_call_params_t* previous_iocall_params, io_buffer_t* iobuf, uint32_t
         }
     }
 
-    // full in chaining
+    // in chaining: the handler gets every APDU of a chained command as it
+    // arrives and consumes it before the next one overwrites the buffer
     reset_io_buffer(iobuf);
-
-    // save params
+    // a command other than INS_GET_RESPONSE or INS_GET_LAST_RESPONSE drops the rest of the response
+    if (new_iocall->params.ins != INS_GET_RESPONSE && new_iocall->params.ins != INS_GET_LAST_RESPONSE)
+        iobuf->pending = 0;
+    const uint8_t continued = previous_iocall_params->cla & CHAINING_BIT;
+    const io_call_params_t previous = *previous_iocall_params;
     *previous_iocall_params = new_iocall->params;
+    if (continued &&
+        (((new_iocall->params.cla & (~CHAINING_BIT)) != (previous.cla & (~CHAINING_BIT))) ||
+         (new_iocall->params.ins != previous.ins) ||
+         (new_iocall->params.p1 != previous.p1) ||
+         (new_iocall->params.p2 != previous.p2)))
+    {
+        THROW(SW_COMMAND_NOT_ALLOWED);
+        return SW_COMMAND_NOT_ALLOWED;
+    }
+    iobuf->chunk = continued ? 0 : IO_CHUNK_FIRST;
+    if (!(new_iocall->params.cla & CHAINING_BIT))
+        iobuf->chunk |= IO_CHUNK_LAST;
+
     // save cdata
 #if BYTECOIN_IO_BUFFER_SIZE < UINT8_MAX // disable warning if BYTECOIN_IO_BUFFER_SIZE > 255
     if (new_iocall->params.lc > BYTECOIN_IO_BUFFER_SIZE)
@@ -227,36 +271,50 @@ int io_do(io_call_params_t* previous_iocall_params, io_buffer_t* iobuf, uint32_t
         return SW_NOT_ENOUGH_MEMORY;
     }
 #endif
-    os_memmove(iobuf->data + iobuf->offset, new_iocall->cdata, new_iocall->params.lc);
-    iobuf->length =  previous_iocall_params->lc;
+    os_memmove(iobuf->data, new_iocall->cdata, previous_iocall_params->lc);
+    iobuf->length = previous_iocall_params->lc;
+    return 0;
+}
+
+static
+void reverse_bytes(uint8_t* data, uint16_t len)
+{
+    for (uint16_t i = 0; i < len / 2; ++i)
+    {
+        const uint8_t byte = data[i];
+        data[i] = data[len - 1 - i];
+        data[len - 1 - i] = byte;
+    }
+}
 
-    while(previous_iocall_params->cla & CHAINING_BIT)
+bool gather_chunk(io_buffer_t* iobuf)
+{
+    if (iobuf->chunk & IO_CHUNK_FIRST)
+        iobuf->gathered = 0;
+    // the APDU of this chunk must have missed the bytes gathered before
+    const uint16_t len = iobuf->length;
+    if (sizeof(io_call_params_t) + len > iobuf->size - iobuf->gathered)
     {
-        G_io_apdu_buffer[0] = (SW_NO_ERROR >> 8);
-        G_io_apdu_buffer[1] = (uint8_t)SW_NO_ERROR;
-        io_exchange(CHANNEL_APDU, 2);
-in_chaining:
-        {
-            if (((new_iocall->params.cla & (~CHAINING_BIT)) != (previous_iocall_params->cla & (~CHAINING_BIT))) ||
-                (new_iocall->params.ins != previous_iocall_params->ins) ||
-                (new_iocall->params.p1 != previous_iocall_params->p1) ||
-                (new_iocall->params.p2 != previous_iocall_params->p2) )
-            {
-                THROW(SW_COMMAND_NOT_ALLOWED);
-                return SW_COMMAND_NOT_ALLOWED;
-            }
-            previous_iocall_params->cla = new_iocall->params.cla;
-            previous_iocall_params->lc  = new_iocall->params.lc;
-            if ((iobuf->length + previous_iocall_params->lc) > BYTECOIN_IO_BUFFER_SIZE)
-            {
-                THROW(SW_NOT_ENOUGH_MEMORY);
-                return SW_NOT_ENOUGH_MEMORY;
-            }
-            os_memmove(iobuf->data + iobuf->length, new_iocall->cdata, new_iocall->params.lc);
-            iobuf->length += new_iocall->params.lc;
-        }
+        THROW(SW_NOT_ENOUGH_MEMORY);
+        return false;
     }
-    return 0;
+
+    // the chunk goes before the gathered bytes and the two swap places
+    uint8_t* start = iobuf->data + iobuf->size - iobuf->gathered - len;
+    os_memmove(start, iobuf->data, len);
+    reverse_bytes(start, len);
+    reverse_bytes(start + len, iobuf->gathered);
+    reverse_bytes(start, len + iobuf->gathered);
+    iobuf->gathered += len;
+    reset_io_buffer(iobuf);
+    if (!(iobuf->chunk & IO_CHUNK_LAST))
+        return false;
+
+    os_memmove(iobuf->data, iobuf->data + iobuf->size - iobuf->gathered, iobuf->gathered);
+    iobuf->length = iobuf->gathered;
+    iobuf->gathered = 0;
+    iobuf->chunk = IO_CHUNK_WHOLE;
+    return true;
 }
 
 void print_io_call_params(const io_call_params_t* iocall_params)
@@ -282,70 +340,3 @@ void print_io_buffer(const io_buffer_t* iobuf)
     PRINTF("offset=%d\n", iobuf->offset);
     PRINTF("data=%.*h\n", sizeof(iobuf->data), iobuf->data);
 }
-
-unsigned short io_exchange_al(unsigned char channel, unsigned short tx_len)
-{
-    switch (channel & ~(IO_FLAGS)) {
-    case CHANNEL_KEYBOARD:
-        break;
-
-    // multiplexed io exchange over a SPI channel and TLV encapsulated protocol
-    case CHANNEL_SPI:
-        if (tx_len) {
-            io_seproxyhal_spi_send(G_io_apdu_buffer, tx_len);
-
-            if (channel & IO_RESET_AFTER_REPLIED) {
-                reset();
-            }
-            return 0; // nothing received from the master so far (it's a tx
-                      // transaction)
-        } else {
-            return io_seproxyhal_spi_recv(G_io_apdu_buffer, sizeof(G_io_apdu_buffer), 0);
-        }
-
-    default:
-        THROW(INVALID_PARAMETER);
-    }
-    return 0;
-}
-
-unsigned char io_event(unsigned char channel) {
-  // nothing done with the event, throw an error on the transport layer if
-  // needed
-  // can't have more than one tag in the reply, not supported yet.
-  switch (G_io_seproxyhal_spi_buffer[0]) {
-  case SEPROXYHAL_TAG_FINGER_EVENT:
-    UX_FINGER_EVENT(G_io_seproxyhal_spi_buffer);
-    break;
-  // power off if long push, else pass to the application callback if any
-  case SEPROXYHAL_TAG_BUTTON_PUSH_EVENT: // for Nano S
-    UX_BUTTON_PUSH_EVENT(G_io_seproxyhal_spi_buffer);
-    break;
-
-  case SEPROXYHAL_TAG_DISPLAY_PROCESSED_EVENT:
-    UX_DISPLAYED_EVENT({});
-    break;
-  case SEPROXYHAL_TAG_TICKER_EVENT:
-    UX_TICKER_EVENT(G_io_seproxyhal_spi_buffer,
-    {
-       // only allow display when not locked of overlayed by an OS UX.
-      if (UX_ALLOWED ) {
-        UX_REDISPLAY();
-      }
-    });
-    break;
-    // other events are propagated to the UX just in case
-  default:
-    UX_DEFAULT_EVENT();
-    break;
-
-  }
-
-  // close the event if not done previously (by a display or whatever)
-  if (!io_seproxyhal_spi_is_status_sent()) {
-    io_seproxyhal_general_status();
-  }
-  // command has been processed, DO NOT reset the current APDU transport
-  return 1;
-}
-
@@ -18,6 +18,7 @@
 #ifndef BYTECOIN_IO_H
 #define BYTECOIN_IO_H
 
+#include <stdbool.h>
 #include <stdint.h>
 #include "os.h"
 #include "bytecoin_crypto.h"
@@ -57,14 +58,42 @@ typedef struct confirm_tx_params_s
     uint8_t address_tag;
 }  confirm_tx_params_t;
 
+// chaining flag is in bit 5 of cla. see 5.1.1.1 of ISO/IEC 7816-4
+#define CHAINING_BIT 0x10
+
+// the longest response io_do() sends, in two parts when it is longer than an APDU
+#define IO_MAX_RESPONSE (BYTECOIN_IO_BUFFER_SIZE - 2)
+
+// part of a chained command held by the io buffer, see io_do
+#define IO_CHUNK_FIRST 0x01
+#define IO_CHUNK_LAST  0x02
+#define IO_CHUNK_WHOLE (IO_CHUNK_FIRST | IO_CHUNK_LAST)
+
 typedef struct io_buffer_s
 {
     uint8_t* data;
     uint16_t length;
     uint16_t offset;
+    uint16_t size;
+    uint16_t pending;    // bytes kept at the end of the buffer for INS_GET_RESPONSE
+    uint8_t pending_ins; // the command that answers with them, INS_NONE when they are the rest of the response
+    uint16_t gathered;   // bytes of a chained command kept at the end of the buffer, see gather_chunk
+    uint8_t chunk;
+    uint16_t sequence;      // commands answered since the last INS_RESET
+    uint16_t last_response; // where the last response is kept, see keep_last_response
+    uint8_t last_length;    // 0 when the response was not kept
 } io_buffer_t;
 
-void init_io_buffer(io_buffer_t* iobuf);
+void init_io_buffer(io_buffer_t* iobuf, uint8_t* data);
+
+// the last response with its status word, as long as it is no longer than the
+// response of sig_step_b; longer ones come from commands that can be sent again
+#define IO_LAST_RESPONSE_SIZE (4 * 32 + 2)
+
+// Keeps the response for INS_GET_LAST_RESPONSE at the end of the buffer, below
+// the bytes pending for INS_GET_RESPONSE, where a command without data does
+// not reach. A response that does not fit there or answers a chunk is not kept.
+void keep_last_response(io_buffer_t* iobuf, uint8_t ins);
 
 void print_io_call_params(const io_call_params_t* iocall_params);
 void print_io_call(const io_call_t* iocall);
@@ -73,9 +102,17 @@ void print_io_buffer(const io_buffer_t* iobuf);
 void reset_io_buffer(io_buffer_t* iobuf);
 void clear_io_buffer(io_buffer_t* iobuf);
 int io_do(io_call_params_t* previous_iocall_params, io_buffer_t* iobuf, uint32_t io_flags);
+// Puts a chained command together for the handlers that take it whole. Every
+// chunk joins the bytes gathered at the end of the buffer, where the next APDU
+// does not reach as long as it fits before them; true when the command is
+// whole at the start of the buffer.
+bool gather_chunk(io_buffer_t* iobuf);
 
 uint64_t fetch_var_from_io_buffer(io_buffer_t* iobuf, uint16_t len);
+uint32_t fetch_varint_from_io_buffer(io_buffer_t* iobuf);
 void fetch_bytes_from_io_buffer(io_buffer_t* iobuf, void* buf, uint16_t len);
+// the next len bytes in place, valid until the buffer is written
+uint8_t* fetch_view_from_io_buffer(io_buffer_t* iobuf, uint16_t len);
 elliptic_curve_point_t fetch_point_from_io_buffer(io_buffer_t* iobuf);
 elliptic_curve_scalar_t fetch_scalar_from_io_buffer(io_buffer_t* iobuf);
 hash_t fetch_hash_from_io_buffer(io_buffer_t* iobuf);
@@ -86,29 +123,31 @@ void insert_scalar_to_io_buffer(io_buffer_t* iobuf, const elliptic_curve_scalar_
 void insert_point_to_io_buffer(io_buffer_t* iobuf, const elliptic_curve_point_t* P);
 void insert_hash_to_io_buffer(io_buffer_t* iobuf, const hash_t* h);
 
+// the helpers below read from and write to the io buffer of the
+// bytecoin_v_state_t pointed to by a `state` variable in scope
 #define insert_point(primitive) \
-    insert_point_to_io_buffer(&G_bytecoin_vstate.io_buffer, &primitive)
+    insert_point_to_io_buffer(&state->io_buffer, &primitive)
 
 #define insert_scalar(primitive) \
-    insert_scalar_to_io_buffer(&G_bytecoin_vstate.io_buffer, &primitive)
+    insert_scalar_to_io_buffer(&state->io_buffer, &primitive)
 
 #define insert_hash(primitive) \
-    insert_hash_to_io_buffer(&G_bytecoin_vstate.io_buffer, &primitive)
+    insert_hash_to_io_buffer(&state->io_buffer, &primitive)
 
 #define fetch_point() \
-    fetch_point_from_io_buffer(&G_bytecoin_vstate.io_buffer)
+    fetch_point_from_io_buffer(&state->io_buffer)
 
 #define fetch_scalar() \
-    fetch_scalar_from_io_buffer(&G_bytecoin_vstate.io_buffer)
+    fetch_scalar_from_io_buffer(&state->io_buffer)
 
 #define fetch_hash() \
-    fetch_hash_from_io_buffer(&G_bytecoin_vstate.io_buffer)
+    fetch_hash_from_io_buffer(&state->io_buffer)
 
 #define fetch_var(var_or_type) \
-    fetch_var_from_io_buffer(&G_bytecoin_vstate.io_buffer, sizeof(var_or_type))
+    fetch_var_from_io_buffer(&state->io_buffer, sizeof(var_or_type))
 
 #define insert_var(var) \
-    insert_var_to_io_buffer(&G_bytecoin_vstate.io_buffer, var, sizeof(var))
+    insert_var_to_io_buffer(&state->io_buffer, var, sizeof(var))
 
 #define fetch_secret_key  fetch_scalar
 #define fetch_public_key  fetch_point
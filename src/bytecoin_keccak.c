@@ -17,6 +17,7 @@
 
 #include "os.h"
 #include "bytecoin_keccak.h"
+#include "bytecoin_stats.h"
 
 typedef uint64_t keccak_lane_t;
 
@@ -105,6 +106,8 @@ void KeccakF1600_StatePermute(void *state)
     unsigned int round, x, y, j, t;
     uint8_t LFSRstate = 0x01;
 
+    COUNT_CRYPTO_OP(CRYPTO_OP_KECCAK_PERMUTATION);
+
     for(round=0; round<24; round++)
     {
         {   /* === theta step (see [Keccak Reference, Section 2.3.2]) === */
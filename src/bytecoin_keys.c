@@ -85,17 +85,25 @@ void generate_hd_secret_key(const secret_key_t* a0, const public_key_t* A_plus_s
     ecaddm(&delta_secret_key, a0, result);
 }
 
-void generate_output_secrets(const hash_t* output_seed, secret_key_t* output_secret_scalar, public_key_t* output_secret_point, uint8_t* output_secret_address_type)
+static
+uint8_t address_type_of_seed(const hash_t* output_seed)
+{
+    hash_t output_secret_address_type_hash;
+    fast_hash(output_seed->data, sizeof(output_seed->data), &output_secret_address_type_hash);
+    return output_secret_address_type_hash.data[0];
+}
+
+void linkable_generate_output_secret(const hash_t* output_seed, secret_key_t* output_secret_scalar, uint8_t* output_secret_address_type)
 {
     reduce32(output_seed, output_secret_scalar);
+    *output_secret_address_type = address_type_of_seed(output_seed);
+}
 
+void unlinkable_generate_output_secret(const hash_t* output_seed, elliptic_curve_point_t* output_secret_point, uint8_t* output_secret_address_type)
+{
     ge_fromfe_frombytes(output_seed, output_secret_point);
     ecmul_8(output_secret_point, output_secret_point);
-
-    hash_t output_secret_address_type_hash;
-    fast_hash(output_seed->data, sizeof(output_seed->data), &output_secret_address_type_hash);
-
-    *output_secret_address_type = output_secret_address_type_hash.data[0];
+    *output_secret_address_type = address_type_of_seed(output_seed);
 }
 
 void linkable_derive_output_public_key(
@@ -37,9 +37,15 @@ void secret_keys_to_A_plus_sH(
 void generate_keyimage(const public_key_t* pub, const secret_key_t* sec, keyimage_t* result);
 void generate_hd_secret_key(const secret_key_t* a0, const public_key_t* A_plus_sH, uint32_t index, secret_key_t* result);
 
-void generate_output_secrets(
-        const hash_t* output_det_key,
+// the output secret of a simple address is a scalar, of an unlinkable one a
+// point, each derivation computes only its own
+void linkable_generate_output_secret(
+        const hash_t* output_seed,
         secret_key_t* output_secret_scalar,
+        uint8_t* output_secret_address_type);
+
+void unlinkable_generate_output_secret(
+        const hash_t* output_seed,
         elliptic_curve_point_t* output_secret_point,
         uint8_t* output_secret_address_type);
 
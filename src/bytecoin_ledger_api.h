@@ -26,6 +26,9 @@
 #define BYTECOIN_MAX_OUTPUT_INDEXES 16
 #define BYTECOIN_MAX_BUFFER_SIZE    128
 #define BYTECOIN_MAX_SCAN_OUTPUTS   7
+#define BYTECOIN_MAX_RING_SIZE      255 // INS_SIG_ADD_INPUT and INS_SIG_ADD_INPUT_VARINTS
+#define BYTECOIN_MAX_ADD_OUTPUTS    12  // INS_SIG_ADD_OUTPUTS
+#define BYTECOIN_MAX_STEP_INPUTS    254 // bytes of INS_SIG_STEP_A_INPUTS and INS_SIG_STEP_B_INPUTS
 
 // INS must be even and cannot start with 9 or 6
 #define INS_GET_WALLET_KEYS           0x30
@@ -46,9 +49,27 @@
 #define INS_SIG_STEP_B                0x4e
 #define INS_SIG_PROOF_START           0x50
 #define INS_GET_APP_INFO              0x52
+#define INS_GET_STATS                 0x54 // builds with BYTECOIN_STATS only
+#define INS_GET_CRYPTO_COUNTERS       0x56 // builds with BYTECOIN_CRYPTO_COUNTERS only
+#define INS_BATCH                     0x58
+#define INS_GET_LAST_RESPONSE         0x5a
+#define INS_SIG_ADD_INPUT             0x5c
+#define INS_SIG_ADD_INPUT_VARINTS     0x5e
+#define INS_SIG_ADD_OUTPUTS           0x70
+#define INS_SIG_STEP_A_INPUTS         0x72
+#define INS_SIG_STEP_B_INPUTS         0x74
+#define INS_SIG_PREFIX                0x76
+#define INS_SIG_STEP_A_TOKEN          0x78
+#define INS_SIG_STEP_B_TOKEN          0x7a
 
 #define INS_GET_RESPONSE              0xc0
 
+// P1 of the command that finishes an input asking for the token of the input
+#define P1_INPUT_TOKEN                0x01
+// P1 of the step B commands asking for the scalars of an input encrypted with
+// one key stream, see encrypt_scalars()
+#define P1_STEP_B_KEY_STREAM          0x01
+
 
 #define SW_SECURITY_STATUS_NOT_SATISFIED  0x6982
 #define SW_CLA_NOT_SUPPORTED              0x6E00
@@ -20,115 +20,78 @@
 #include "os_io_seproxyhal.h"
 #include "bytecoin_ledger_api.h"
 #include "bytecoin_vars.h"
-#include "bytecoin_apdu.h"
+#include "bytecoin_dispatch.h"
 #include "bytecoin_ui.h"
+#include "bytecoin_stats.h"
+
+unsigned char G_io_seproxyhal_spi_buffer[IO_SEPROXYHAL_BUFFER_SIZE_B];
 
 bytecoin_v_state_t G_bytecoin_vstate;
 
-int dispatch(uint8_t cla, uint8_t ins)
+unsigned short io_exchange_al(unsigned char channel, unsigned short tx_len)
 {
-    int sw = SW_INS_NOT_SUPPORTED;
+    switch (channel & ~(IO_FLAGS)) {
+    case CHANNEL_KEYBOARD:
+        break;
 
-    if (cla != BYTECOIN_CLA)
-    {
-        THROW(SW_CLA_NOT_SUPPORTED);
-        return SW_CLA_NOT_SUPPORTED;
-    }
+    // multiplexed io exchange over a SPI channel and TLV encapsulated protocol
+    case CHANNEL_SPI:
+        if (tx_len) {
+            io_seproxyhal_spi_send(G_io_apdu_buffer, tx_len);
 
-    switch(ins)
-    {
-    case INS_RESET:
-        reset_io_buffer(&G_bytecoin_vstate.io_buffer);
-        return SW_NO_ERROR;
-
-    case INS_GET_APP_INFO:
-        sw = bytecoin_apdu_get_ledger_app_info(); break;
-    case INS_GET_WALLET_KEYS:
-        sw = bytecoin_apdu_get_wallet_keys(); break;
-    case INS_SCAN_OUTPUTS:
-        sw = bytecoin_apdu_scan_outputs(); break;
-    case INS_GENERATE_KEYIMAGE:
-        sw = bytecoin_apdu_generate_keyimage(); break;
-    case INS_GENERATE_OUTPUT_SEED:
-        sw = bytecoin_apdu_generate_output_seed(); break;
-    case INS_SIG_START:
-        sw = bytecoin_apdu_sig_start(); break;
-    case INS_SIG_ADD_INPUT_START:
-        sw = bytecoin_apdu_sig_add_input_start(); break;
-    case INS_SIG_ADD_INPUT_INDEXES:
-        sw = bytecoin_apdu_sig_add_input_indexes(); break;
-    case INS_SIG_ADD_INPUT_FINISH:
-        sw = bytecoin_apdu_sig_add_input_finish(); break;
-    case INS_SIG_ADD_OUPUT:
-        sw = bytecoin_apdu_sig_add_output(); break;
-    case INS_SIG_ADD_EXTRA:
-        sw = bytecoin_apdu_sig_add_extra(); break;
-    case INS_SIG_STEP_A:
-        sw = bytecoin_apdu_sig_step_a(); break;
-    case INS_SIG_STEP_A_MORE_DATA:
-        sw = bytecoin_apdu_sig_step_a_more_data(); break;
-    case INS_SIG_GET_C0:
-        sw = bytecoin_apdu_sig_get_c0(); break;
-    case INS_SIG_STEP_B:
-        sw = bytecoin_apdu_sig_step_b(); break;
-    case INS_SIG_PROOF_START:
-        sw = bytecoin_apdu_sig_proof_start(); break;
-    case INS_EXPORT_VIEW_ONLY:
-        sw = bytecoin_apdu_export_view_only(); break;
+            if (channel & IO_RESET_AFTER_REPLIED) {
+                reset();
+            }
+            return 0; // nothing received from the master so far (it's a tx
+                      // transaction)
+        } else {
+            return io_seproxyhal_spi_recv(G_io_apdu_buffer, sizeof(G_io_apdu_buffer), 0);
+        }
 
     default:
-      THROW(SW_INS_NOT_SUPPORTED);
-      return SW_INS_NOT_SUPPORTED;
-      break;
+        THROW(INVALID_PARAMETER);
     }
-    return sw;
+    return 0;
 }
 
-static
-void bytecoin_main(void)
-{
-    volatile uint32_t io_flags = 0;
-
-    // DESIGN NOTE: the bootloader ignores the way APDU are fetched. The only
-    // goal is to retrieve APDU.
-    // When APDU are to be fetched from multiple IOs, like NFC+USB+BLE, make
-    // sure the io_event is called with a
-    // switch event, before the apdu is replied to the bootloader. This avoid
-    // APDU injection faults.
-    for (;;)
+unsigned char io_event(unsigned char channel) {
+  // nothing done with the event, throw an error on the transport layer if
+  // needed
+  // can't have more than one tag in the reply, not supported yet.
+  switch (G_io_seproxyhal_spi_buffer[0]) {
+  case SEPROXYHAL_TAG_FINGER_EVENT:
+    UX_FINGER_EVENT(G_io_seproxyhal_spi_buffer);
+    break;
+  // power off if long push, else pass to the application callback if any
+  case SEPROXYHAL_TAG_BUTTON_PUSH_EVENT: // for Nano S
+    UX_BUTTON_PUSH_EVENT(G_io_seproxyhal_spi_buffer);
+    break;
+
+  case SEPROXYHAL_TAG_DISPLAY_PROCESSED_EVENT:
+    UX_DISPLAYED_EVENT({});
+    break;
+  case SEPROXYHAL_TAG_TICKER_EVENT:
+    UX_TICKER_EVENT(G_io_seproxyhal_spi_buffer,
     {
-        volatile uint16_t sw = 0;
+       // only allow display when not locked of overlayed by an OS UX.
+      if (UX_ALLOWED ) {
+        UX_REDISPLAY();
+      }
+    });
+    break;
+    // other events are propagated to the UX just in case
+  default:
+    UX_DEFAULT_EVENT();
+    break;
 
-        BEGIN_TRY {
-            TRY {
-                io_do(&G_bytecoin_vstate.prev_io_call_params, &G_bytecoin_vstate.io_buffer, io_flags);
-                sw = dispatch(G_bytecoin_vstate.prev_io_call_params.cla, G_bytecoin_vstate.prev_io_call_params.ins);
-            }
-            CATCH_OTHER(e) {
-                clear_io_buffer(&G_bytecoin_vstate.io_buffer);
-
-                if ((e & 0xF000) != 0x6000 && (e & 0xF000) != 0x9000)
-                {
-                    insert_var(e);
-                    sw = SW_SOMETHING_WRONG;
-                }
-                else
-                    sw = e;
-            }
-            FINALLY {
-                if (sw)
-                {
-                    insert_var(sw);
-                    io_flags = 0;
-                }
-                else
-                  io_flags = IO_ASYNCH_REPLY;
-            }
-        }
-        END_TRY;
-    }
+  }
 
-    return;
+  // close the event if not done previously (by a display or whatever)
+  if (!io_seproxyhal_spi_is_status_sent()) {
+    io_seproxyhal_general_status();
+  }
+  // command has been processed, DO NOT reset the current APDU transport
+  return 1;
 }
 
 void app_exit(void) {
@@ -155,6 +118,7 @@ int main(void)
     BEGIN_TRY {
         TRY {
             io_seproxyhal_init();
+            io_seproxyhal_setup_ticker(BYTECOIN_TICKER_MS);
 
             USB_power(0);
             USB_power(1);
@@ -163,10 +127,10 @@ int main(void)
             io_usb_ccid_set_card_inserted(1);
             #endif
 
-            init_vstate(&G_bytecoin_vstate);
+            init_vstate(&G_bytecoin_vstate, G_io_apdu_buffer);
             ui_init();
 
-            bytecoin_main();
+            bytecoin_main(&G_bytecoin_vstate);
         }
         CATCH(EXCEPTION_IO_RESET) {
         // reset IO and UX
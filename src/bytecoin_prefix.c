@@ -0,0 +1,269 @@
+/*******************************************************************************
+*   Bytecoin Wallet for Ledger Nano S
+*   (c) 2018 - 2019 The Bytecoin developers
+*
+*  Licensed under the Apache License, Version 2.0 (the "License");
+*  you may not use this file except in compliance with the License.
+*  You may obtain a copy of the License at
+*
+*      http://www.apache.org/licenses/LICENSE-2.0
+*
+*  Unless required by applicable law or agreed to in writing, software
+*  distributed under the License is distributed on an "AS IS" BASIS,
+*  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+*  See the License for the specific language governing permissions and
+*  limitations under the License.
+********************************************************************************/
+
+#include "os.h"
+#include "bytecoin_prefix.h"
+
+typedef enum prefix_field_e
+{
+    PREFIX_IDLE = 0,
+    PREFIX_VERSION,
+    PREFIX_UNLOCK_TIME,
+    PREFIX_INPUTS_NUM,
+    PREFIX_INPUT_TAG,
+    PREFIX_INPUT_AMOUNT,
+    PREFIX_INPUT_INDEXES_COUNT,
+    PREFIX_INPUT_INDEX,
+    PREFIX_INPUT_KEY,
+    PREFIX_OUTPUTS_NUM,
+    PREFIX_OUTPUT_TAG,
+    PREFIX_OUTPUT_AMOUNT,
+    PREFIX_OUTPUT_KEY,
+    PREFIX_EXTRA_SIZE,
+    PREFIX_DONE,
+} prefix_field_t;
+
+void init_prefix(bytecoin_prefix_t* prefix)
+{
+    os_memset(prefix, 0, sizeof(bytecoin_prefix_t));
+    prefix->field = PREFIX_IDLE;
+}
+
+void prefix_start(bytecoin_prefix_t* prefix, bytecoin_signing_state_t* sig_state)
+{
+    init_prefix(prefix);
+    init_signing_state(sig_state);
+    prefix->field = PREFIX_VERSION;
+}
+
+bool prefix_done(const bytecoin_prefix_t* prefix)
+{
+    return prefix->field == PREFIX_DONE;
+}
+
+// true when the varint is complete in prefix->value
+static
+bool read_varint(bytecoin_prefix_t* prefix, uint8_t byte, uint64_t max)
+{
+    if (prefix->shift == 63 && byte > 1)
+        THROW(SW_WRONG_DATA);
+    prefix->value |= (uint64_t)(byte & 0x7F) << prefix->shift;
+    if (byte & 0x80)
+    {
+        prefix->shift += 7;
+        return false;
+    }
+    // the value is hashed, not the bytes, so they must be the minimal ones
+    if ((prefix->shift && !byte) || prefix->value > max)
+        THROW(SW_WRONG_DATA);
+    prefix->shift = 0;
+    return true;
+}
+
+static
+uint64_t take_varint(bytecoin_prefix_t* prefix)
+{
+    const uint64_t value = prefix->value;
+    prefix->value = 0;
+    return value;
+}
+
+// true when the key is complete, its size follows from its first byte
+static
+bool read_key(bytecoin_prefix_t* prefix, uint8_t byte, bool output)
+{
+    if (!prefix->key_length)
+    {
+        if (!output && byte > BYTECOIN_MAX_BUFFER_SIZE)
+            THROW(SW_NOT_ENOUGH_MEMORY);
+        prefix->key_size = output ? (byte ? 1 + 4 : 1 + 1 + 2 * 32) : 1 + byte + 4;
+    }
+    prefix->key[prefix->key_length++] = byte;
+    return prefix->key_length == prefix->key_size;
+}
+
+static
+uint32_t key_u32(const uint8_t* p)
+{
+    return (uint32_t)p[0] << 24 | (uint32_t)p[1] << 16 | (uint32_t)p[2] << 8 | p[3];
+}
+
+static
+void finish_input(
+        bytecoin_prefix_t* prefix,
+        bytecoin_signing_state_t* sig_state,
+        const wallet_keys_t* wallet_keys,
+        address_secret_cache_t* address_cache)
+{
+    const uint8_t arg_len = prefix->key[0];
+    sig_add_input_finish(sig_state, wallet_keys, address_cache, prefix->key + 1, arg_len, key_u32(prefix->key + 1 + arg_len), NULL);
+    prefix->key_length = 0;
+}
+
+static
+void queue_output(bytecoin_prefix_t* prefix, bytecoin_signing_state_t* sig_state)
+{
+    if (prefix->outputs_count == BYTECOIN_PREFIX_OUTPUTS)
+        THROW(SW_NOT_ENOUGH_MEMORY);
+    bytecoin_prefix_output_t* output = &prefix->outputs[prefix->outputs_count++];
+    output->amount = prefix->amount;
+    output->change = prefix->key[0] ? true : false;
+    output->change_address_index = output->change ? key_u32(prefix->key + 1) : 0;
+    if (!output->change)
+        sig_set_dst_address(sig_state, prefix->key[1], (const public_key_t*)(prefix->key + 2), (const public_key_t*)(prefix->key + 2 + 32));
+    prefix->key_length = 0;
+    ++prefix->outputs_read;
+}
+
+void prefix_update(
+        bytecoin_prefix_t* prefix,
+        bytecoin_signing_state_t* sig_state,
+        const wallet_keys_t* wallet_keys,
+        address_secret_cache_t* address_cache,
+        const uint8_t* data,
+        uint16_t length)
+{
+    // a failure leaves the parser idle, the rest of the stream is refused
+    uint8_t field = prefix->field;
+    prefix->field = PREFIX_IDLE;
+    if (field == PREFIX_IDLE)
+        THROW(SW_COMMAND_NOT_ALLOWED);
+
+    for (uint16_t i = 0; i < length; ++i)
+    {
+        const uint8_t byte = data[i];
+        switch (field)
+        {
+        case PREFIX_VERSION:
+            if (read_varint(prefix, byte, UINT32_MAX))
+            {
+                prefix->version = take_varint(prefix);
+                field = PREFIX_UNLOCK_TIME;
+            }
+            break;
+        case PREFIX_UNLOCK_TIME:
+            if (read_varint(prefix, byte, UINT64_MAX))
+            {
+                prefix->unlock_time = take_varint(prefix);
+                field = PREFIX_INPUTS_NUM;
+            }
+            break;
+        case PREFIX_INPUTS_NUM:
+            // the outputs and the extra size come later, sig_start takes placeholders
+            if (read_varint(prefix, byte, UINT16_MAX))
+            {
+                sig_start(sig_state, prefix->version, prefix->unlock_time, take_varint(prefix), 1, 0);
+                field = PREFIX_INPUT_TAG;
+            }
+            break;
+        case PREFIX_INPUT_TAG:
+            if (byte != BYTECOIN_INPUT_KEY_TAG)
+                THROW(SW_WRONG_DATA);
+            field = PREFIX_INPUT_AMOUNT;
+            break;
+        case PREFIX_INPUT_AMOUNT:
+            if (read_varint(prefix, byte, UINT64_MAX))
+            {
+                prefix->amount = take_varint(prefix);
+                field = PREFIX_INPUT_INDEXES_COUNT;
+            }
+            break;
+        case PREFIX_INPUT_INDEXES_COUNT:
+            if (read_varint(prefix, byte, UINT16_MAX))
+            {
+                const uint32_t count = take_varint(prefix);
+                sig_add_input_start(sig_state, prefix->amount, count);
+                if (!count)
+                    sig_add_input_indexes(sig_state, NULL, 0);
+                field = count ? PREFIX_INPUT_INDEX : PREFIX_INPUT_KEY;
+            }
+            break;
+        case PREFIX_INPUT_INDEX:
+            if (read_varint(prefix, byte, UINT32_MAX))
+            {
+                const uint32_t index = take_varint(prefix);
+                sig_add_input_indexes(sig_state, &index, 1);
+                if (sig_state->status == SIG_STATE_EXPECT_INPUT_FINISH)
+                    field = PREFIX_INPUT_KEY;
+            }
+            break;
+        case PREFIX_INPUT_KEY:
+            if (!read_key(prefix, byte, false))
+                break;
+            // sig_add_input_finish hashes the number of outputs after the last input
+            if (sig_state->inputs_counter + 1 == sig_state->inputs_num)
+            {
+                field = PREFIX_OUTPUTS_NUM;
+                break;
+            }
+            finish_input(prefix, sig_state, wallet_keys, address_cache);
+            field = PREFIX_INPUT_TAG;
+            break;
+        case PREFIX_OUTPUTS_NUM:
+            if (read_varint(prefix, byte, UINT16_MAX))
+            {
+                sig_state->outputs_num = take_varint(prefix);
+                if (!sig_state->outputs_num)
+                    THROW(SW_WRONG_DATA);
+                finish_input(prefix, sig_state, wallet_keys, address_cache);
+                field = PREFIX_OUTPUT_TAG;
+            }
+            break;
+        case PREFIX_OUTPUT_TAG:
+            if (byte != BYTECOIN_OUTPUT_KEY_TAG)
+                THROW(SW_WRONG_DATA);
+            field = PREFIX_OUTPUT_AMOUNT;
+            break;
+        case PREFIX_OUTPUT_AMOUNT:
+            if (read_varint(prefix, byte, UINT64_MAX))
+            {
+                prefix->amount = take_varint(prefix);
+                field = PREFIX_OUTPUT_KEY;
+            }
+            break;
+        case PREFIX_OUTPUT_KEY:
+            if (!read_key(prefix, byte, true))
+                break;
+            queue_output(prefix, sig_state);
+            field = prefix->outputs_read < sig_state->outputs_num ? PREFIX_OUTPUT_TAG : PREFIX_EXTRA_SIZE;
+            break;
+        case PREFIX_EXTRA_SIZE:
+            // sig_add_output hashes the extra size after the last output
+            if (read_varint(prefix, byte, UINT16_MAX))
+            {
+                sig_state->extra_size = take_varint(prefix);
+                field = PREFIX_DONE;
+            }
+            break;
+        default:
+            THROW(SW_WRONG_LENGTH);
+        }
+    }
+    prefix->field = field;
+}
+
+bool prefix_next_output(bytecoin_prefix_t* prefix, bytecoin_prefix_output_t* output)
+{
+    if (!prefix->outputs_count)
+        return false;
+    if (prefix->outputs_count == 1 && prefix->field == PREFIX_EXTRA_SIZE)
+        return false;
+    *output = prefix->outputs[0];
+    --prefix->outputs_count;
+    os_memmove(prefix->outputs, prefix->outputs + 1, prefix->outputs_count * sizeof(prefix->outputs[0]));
+    return true;
+}
@@ -0,0 +1,88 @@
+/*******************************************************************************
+*   Bytecoin Wallet for Ledger Nano S
+*   (c) 2018 - 2019 The Bytecoin developers
+*
+*  Licensed under the Apache License, Version 2.0 (the "License");
+*  you may not use this file except in compliance with the License.
+*  You may obtain a copy of the License at
+*
+*      http://www.apache.org/licenses/LICENSE-2.0
+*
+*  Unless required by applicable law or agreed to in writing, software
+*  distributed under the License is distributed on an "AS IS" BASIS,
+*  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+*  See the License for the specific language governing permissions and
+*  limitations under the License.
+********************************************************************************/
+
+#ifndef BYTECOIN_PREFIX_H
+#define BYTECOIN_PREFIX_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "bytecoin_ledger_api.h"
+#include "bytecoin_sig.h"
+
+// The transaction prefix as it is serialized, up to and including the extra
+// size, with the arguments of the device in place of what it derives:
+//   version, unlock_time, inputs_num                         varints
+//   per input:  tag (1) amount count indexes...              varints
+//               arg_length (1) arg address_index (4)         instead of the key image
+//   outputs_num                                              varint
+//   per output: tag (1) amount                               varint
+//               change (1) change_address_index (4), or
+//               change (1) tag (1) s (32) s_v (32)           instead of key, secret and type
+//   extra_size                                               varint
+// The parser takes it in pieces cut anywhere and drives the sig_* functions,
+// so the hashes are those of the single commands. Varints must be minimal.
+
+// Outputs waiting to be derived. The piece is read from the io buffer the
+// responses go to, so its outputs are derived after it. At most this many may
+// be complete in one piece, the last output counting while it waits for the
+// extra size; one more throws SW_NOT_ENOUGH_MEMORY, which ends the stream.
+#define BYTECOIN_PREFIX_OUTPUTS   3
+#define BYTECOIN_PREFIX_KEY_SIZE  (1 + BYTECOIN_MAX_BUFFER_SIZE + 4)
+
+typedef struct bytecoin_prefix_output_s
+{
+    uint64_t amount;
+    uint32_t change_address_index;
+    bool change;
+} bytecoin_prefix_output_t;
+
+typedef struct bytecoin_prefix_s
+{
+    uint64_t value;         // of the varint being read
+    uint64_t unlock_time;
+    uint64_t amount;        // of the input being read
+    uint32_t version;
+    uint16_t outputs_read;
+    uint8_t shift;
+    uint8_t field;          // PREFIX_IDLE between streams and after a failure
+    uint8_t key_length;
+    uint8_t key_size;
+    uint8_t key[BYTECOIN_PREFIX_KEY_SIZE];
+    uint8_t outputs_count;
+    bytecoin_prefix_output_t outputs[BYTECOIN_PREFIX_OUTPUTS];
+} bytecoin_prefix_t;
+
+void init_prefix(bytecoin_prefix_t* prefix);
+
+// starts a stream and drops the signing in progress
+void prefix_start(bytecoin_prefix_t* prefix, bytecoin_signing_state_t* sig_state);
+
+void prefix_update(
+        bytecoin_prefix_t* prefix,
+        bytecoin_signing_state_t* sig_state,
+        const wallet_keys_t* wallet_keys,
+        address_secret_cache_t* address_cache,
+        const uint8_t* data,
+        uint16_t length);
+
+bool prefix_done(const bytecoin_prefix_t* prefix);
+
+// the next output to pass to sig_add_output, the last one of the transaction
+// waits for the extra size
+bool prefix_next_output(bytecoin_prefix_t* prefix, bytecoin_prefix_output_t* output);
+
+#endif // BYTECOIN_PREFIX_H
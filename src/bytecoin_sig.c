@@ -20,23 +20,26 @@
 #include "bytecoin_ledger_api.h"
 #include "bytecoin_wallet.h"
 #include "bytecoin_keys.h"
-#include "bytecoin_ui.h"
 #include "bytecoin_debug.h"
 
-#define BYTECOIN_INPUT_KEY_TAG  2
-#define BYTECOIN_OUTPUT_KEY_TAG 2
-
 #define BYTECOIN_SIMPLE_ADDRESS_TAG     0
 #define BYTECOIN_UNLINKABLE_ADDRESS_TAG 1
 
-static const uint8_t ka_str[] = { 'k', 'a' };
-static const uint8_t ks_str[] = { 'k', 's' };
-static const uint8_t kr_str[] = { 'k', 'r' };
-
 static const uint8_t ra_str[] = { 'r', 'a' };
 static const uint8_t rs_str[] = { 'r', 's' };
 static const uint8_t rr_str[] = { 'r', 'r' };
 
+static const uint8_t ti_str[] = { 't', 'i' };
+static const uint8_t ta_str[] = { 't', 'a' };
+static const uint8_t tt_str[] = { 't', 't' };
+
+// offsets in an input token, see bytecoin_sig.h
+#define TOKEN_INV_OUTPUT_SECRET_HASH 4
+#define TOKEN_OUTPUT_SECRET_KEY_A    (4 + 32)
+#define TOKEN_HASH_PUBS_SEC          (4 + 2 * 32)
+#define TOKEN_B_COIN                 (4 + 3 * 32)
+#define TOKEN_TAG                    (4 + 4 * 32)
+
 void init_signing_state(bytecoin_signing_state_t* sig_state)
 {
     os_memset(sig_state, 0, sizeof(bytecoin_signing_state_t));
@@ -68,6 +71,7 @@ void sig_start(
     }
 
     init_signing_state(sig_state);
+    generate_token_key(&sig_state->token_key);
 
     sig_state->inputs_num = inputs_num;
     sig_state->outputs_num = outputs_num;
@@ -142,12 +146,160 @@ void sig_add_input_indexes(
     sig_state->status = SIG_STATE_EXPECT_INPUT_FINISH;
 }
 
+// the secret keys of the input from its inverted output secret hash
+static
+void derive_input_secret_keys(
+        const wallet_keys_t* wallet_keys,
+        address_secret_cache_t* address_cache,
+        uint32_t address_index,
+        bytecoin_input_secrets_t* secrets)
+{
+    {
+        secret_key_t address_audit_secret_key;
+        prepare_address_secret(wallet_keys, address_cache, address_index, &address_audit_secret_key);
+        ecmulm(&address_audit_secret_key, &secrets->inv_output_secret_hash, &secrets->output_secret_key_a);
+    }
+    ecmulm(&wallet_keys->spend_secret_key, &secrets->inv_output_secret_hash, &secrets->output_secret_key_s);
+    secrets->address_index = address_index;
+}
+
+static
+void derive_input_secrets(
+        const wallet_keys_t* wallet_keys,
+        address_secret_cache_t* address_cache,
+        const elliptic_curve_scalar_t* output_secret_hash,
+        uint32_t address_index,
+        bytecoin_input_secrets_t* secrets)
+{
+    invert32(output_secret_hash, &secrets->inv_output_secret_hash);
+    derive_input_secret_keys(wallet_keys, address_cache, address_index, secrets);
+}
+
+// the key image as generate_keyimage() has it, keeping its base
+static
+void derive_input_keyimage(bytecoin_input_secrets_t* secrets, keyimage_t* keyimage)
+{
+    public_key_t output_public_key;
+    secret_keys_to_public_key(&secrets->output_secret_key_a, &secrets->output_secret_key_s, &output_public_key);
+    hash_point_to_good_point(&output_public_key, &secrets->hash_pubs_sec);
+    ecmul(&secrets->hash_pubs_sec, &secrets->output_secret_key_a, keyimage);
+}
+
+static
+void remember_input_secrets(bytecoin_signing_state_t* sig_state, const bytecoin_input_secrets_t* secrets)
+{
+    if (sig_state->inputs_counter >= BYTECOIN_INPUT_CACHE_SIZE)
+        return;
+    bytecoin_input_cache_entry_t* entry = &sig_state->input_cache[sig_state->inputs_counter];
+    entry->inv_output_secret_hash = secrets->inv_output_secret_hash;
+    entry->hash_pubs_sec = secrets->hash_pubs_sec;
+    entry->b_coin = secrets->b_coin;
+    entry->address_index = secrets->address_index;
+}
+
+// the secrets remembered for the current input, if its arguments are the same;
+// an empty slot holds a zero inverse, which matches no output secret hash
+static
+bool recall_input_secrets(
+        bytecoin_signing_state_t* sig_state,
+        const wallet_keys_t* wallet_keys,
+        address_secret_cache_t* address_cache,
+        const elliptic_curve_scalar_t* output_secret_hash,
+        uint32_t address_index,
+        bytecoin_input_secrets_t* secrets)
+{
+    static const uint8_t one[32] = { [31] = 1 }; // big endian as the scalars
+    if (sig_state->inputs_counter >= BYTECOIN_INPUT_CACHE_SIZE)
+        return false;
+    const bytecoin_input_cache_entry_t* entry = &sig_state->input_cache[sig_state->inputs_counter];
+    if (entry->address_index != address_index)
+        return false;
+    elliptic_curve_scalar_t product;
+    ecmulm(output_secret_hash, &entry->inv_output_secret_hash, &product);
+    if (os_memcmp(product.data, one, sizeof(one)) != 0)
+        return false;
+    secrets->inv_output_secret_hash = entry->inv_output_secret_hash;
+    derive_input_secret_keys(wallet_keys, address_cache, address_index, secrets);
+    secrets->hash_pubs_sec = entry->hash_pubs_sec;
+    secrets->b_coin = entry->b_coin;
+    return true;
+}
+
+// bound to the transaction by the token key and to the input by its index
+static
+void input_token_tag(const bytecoin_signing_state_t* sig_state, const bytecoin_input_token_t* token, hash_t* tag)
+{
+    keccak_hasher_t hasher;
+    keccak_init(&hasher);
+    keccak_update(&hasher, sig_state->token_key.data, sizeof(sig_state->token_key.data));
+    keccak_update(&hasher, tt_str, sizeof(tt_str));
+    keccak_update_varint(&hasher, sig_state->inputs_counter);
+    keccak_update(&hasher, token->data, TOKEN_TAG);
+    keccak_final(&hasher, tag);
+}
+
+static
+void seal_input_token(const bytecoin_signing_state_t* sig_state, const bytecoin_input_secrets_t* secrets, bytecoin_input_token_t* token)
+{
+    for (int k = 0; k < 4; ++k)
+        token->data[k] = (uint8_t)(secrets->address_index >> (24 - 8 * k));
+    hash_t encrypted;
+    encrypt_scalar(&sig_state->token_key, &secrets->inv_output_secret_hash, sig_state->inputs_counter, ti_str, &encrypted);
+    os_memmove(token->data + TOKEN_INV_OUTPUT_SECRET_HASH, encrypted.data, sizeof(encrypted.data));
+    encrypt_scalar(&sig_state->token_key, &secrets->output_secret_key_a, sig_state->inputs_counter, ta_str, &encrypted);
+    os_memmove(token->data + TOKEN_OUTPUT_SECRET_KEY_A, encrypted.data, sizeof(encrypted.data));
+    os_memmove(token->data + TOKEN_HASH_PUBS_SEC, secrets->hash_pubs_sec.data, sizeof(secrets->hash_pubs_sec.data));
+    os_memmove(token->data + TOKEN_B_COIN, secrets->b_coin.data, sizeof(secrets->b_coin.data));
+    hash_t tag;
+    input_token_tag(sig_state, token, &tag);
+    os_memmove(token->data + TOKEN_TAG, tag.data, BYTECOIN_INPUT_TOKEN_TAG_SIZE);
+}
+
+// encrypt_scalar() of zero is the key stream
+static
+void decrypt_scalar(const hash_t* encryption_key, const uint8_t* encrypted, uint32_t i, const uint8_t scalar_name[2], elliptic_curve_scalar_t* scalar)
+{
+    const elliptic_curve_scalar_t zero = { { 0 } };
+    hash_t key_stream;
+    encrypt_scalar(encryption_key, &zero, i, scalar_name, &key_stream);
+    for (uint32_t j = 0; j < sizeof(scalar->data); ++j)
+        scalar->data[sizeof(scalar->data) - j - 1] = encrypted[j] ^ key_stream.data[j];
+}
+
+static
+void open_input_token(
+        const bytecoin_signing_state_t* sig_state,
+        const wallet_keys_t* wallet_keys,
+        const bytecoin_input_token_t* token,
+        bytecoin_input_secrets_t* secrets)
+{
+    hash_t tag;
+    input_token_tag(sig_state, token, &tag);
+    uint8_t difference = 0;
+    for (uint32_t j = 0; j < BYTECOIN_INPUT_TOKEN_TAG_SIZE; ++j)
+        difference |= tag.data[j] ^ token->data[TOKEN_TAG + j];
+    if (difference)
+    {
+        THROW(SW_WRONG_DATA);
+        return;
+    }
+
+    secrets->address_index = (uint32_t)token->data[0] << 24 | (uint32_t)token->data[1] << 16 | (uint32_t)token->data[2] << 8 | token->data[3];
+    decrypt_scalar(&sig_state->token_key, token->data + TOKEN_INV_OUTPUT_SECRET_HASH, sig_state->inputs_counter, ti_str, &secrets->inv_output_secret_hash);
+    decrypt_scalar(&sig_state->token_key, token->data + TOKEN_OUTPUT_SECRET_KEY_A, sig_state->inputs_counter, ta_str, &secrets->output_secret_key_a);
+    ecmulm(&wallet_keys->spend_secret_key, &secrets->inv_output_secret_hash, &secrets->output_secret_key_s);
+    os_memmove(secrets->hash_pubs_sec.data, token->data + TOKEN_HASH_PUBS_SEC, sizeof(secrets->hash_pubs_sec.data));
+    os_memmove(secrets->b_coin.data, token->data + TOKEN_B_COIN, sizeof(secrets->b_coin.data));
+}
+
 void sig_add_input_finish(
         bytecoin_signing_state_t* sig_state,
         const wallet_keys_t* wallet_keys,
+        address_secret_cache_t* address_cache,
         const uint8_t* output_secret_hash_arg,
         uint32_t output_secret_hash_arg_len,
-        uint32_t address_index)
+        uint32_t address_index,
+        bytecoin_input_token_t* token)
 {
     const bool call_is_expected = (sig_state->status == SIG_STATE_EXPECT_INPUT_FINISH);
     if (!call_is_expected)
@@ -156,8 +308,16 @@ void sig_add_input_finish(
         return;
     }
 
+    elliptic_curve_scalar_t output_secret_hash;
+    hash_to_scalar(output_secret_hash_arg, output_secret_hash_arg_len, &output_secret_hash);
+    bytecoin_input_secrets_t secrets;
+    derive_input_secrets(wallet_keys, address_cache, &output_secret_hash, address_index, &secrets);
     keyimage_t keyimage;
-    generate_keyimage_for_address(wallet_keys, output_secret_hash_arg, output_secret_hash_arg_len, address_index, &keyimage);
+    derive_input_keyimage(&secrets, &keyimage);
+    hash_point_to_good_point(&keyimage, &secrets.b_coin);
+    remember_input_secrets(sig_state, &secrets);
+    if (token)
+        seal_input_token(sig_state, &secrets, token);
 
     keccak_update(&sig_state->tx_prefix_hasher, keyimage.data, sizeof(keyimage.data));
     keccak_update(&sig_state->tx_inputs_hasher, keyimage.data, sizeof(keyimage.data));
@@ -186,29 +346,29 @@ void add_output_or_change(
         public_key_t* encrypted_secret,
         uint8_t* encrypted_address_type)
 {
-    secret_key_t output_secret_scalar;
-    elliptic_curve_point_t output_secret_point;
+    hash_t output_seed;
+    generate_output_seed(wallet_keys, &sig_state->tx_inputs_hash, sig_state->outputs_counter, &output_seed);
     uint8_t output_secret_address_type;
 
-    {
-        hash_t output_seed;
-        generate_output_seed(wallet_keys, &sig_state->tx_inputs_hash, sig_state->outputs_counter, &output_seed);
-        generate_output_secrets(&output_seed, &output_secret_scalar, &output_secret_point, &output_secret_address_type);
-    }
-
-    *encrypted_address_type = dst_address_tag ^ output_secret_address_type;
-
     const bool is_linkable = (dst_address_tag == BYTECOIN_SIMPLE_ADDRESS_TAG);
-    is_linkable ?
-            linkable_derive_output_public_key(
+    if (is_linkable)
+    {
+        secret_key_t output_secret_scalar;
+        linkable_generate_output_secret(&output_seed, &output_secret_scalar, &output_secret_address_type);
+        linkable_derive_output_public_key(
                 &output_secret_scalar,
                 &sig_state->tx_inputs_hash,
                 sig_state->outputs_counter,
                 dst_address_s,
                 dst_address_s_v,
                 public_key,
-                encrypted_secret) :
-            unlinkable_derive_output_public_key(
+                encrypted_secret);
+    }
+    else
+    {
+        elliptic_curve_point_t output_secret_point;
+        unlinkable_generate_output_secret(&output_seed, &output_secret_point, &output_secret_address_type);
+        unlinkable_derive_output_public_key(
                 &output_secret_point,
                 &sig_state->tx_inputs_hash,
                 sig_state->outputs_counter,
@@ -216,6 +376,9 @@ void add_output_or_change(
                 dst_address_s_v,
                 public_key,
                 encrypted_secret);
+    }
+
+    *encrypted_address_type = dst_address_tag ^ output_secret_address_type;
 
     const uint8_t output_tag = BYTECOIN_OUTPUT_KEY_TAG;
     keccak_update_byte  (&sig_state->tx_prefix_hasher, output_tag);
@@ -229,6 +392,7 @@ static
 void add_change_output(
         bytecoin_signing_state_t* sig_state,
         const wallet_keys_t* wallet_keys,
+        address_secret_cache_t* address_cache,
         uint64_t amount,
         uint32_t change_address_index,
         public_key_t* public_key,
@@ -243,21 +407,15 @@ void add_change_output(
     }
     public_key_t change_address_s;
     public_key_t change_address_s_v;
-    prepare_address_public(wallet_keys, change_address_index, &change_address_s, &change_address_s_v);
+    prepare_address_public(wallet_keys, address_cache, change_address_index, &change_address_s, &change_address_s_v);
     add_output_or_change(sig_state, wallet_keys, amount, BYTECOIN_UNLINKABLE_ADDRESS_TAG, &change_address_s, &change_address_s_v, public_key, encrypted_secret, encrypted_address_type);
 }
 
-static
-void add_output(
+void sig_set_dst_address(
         bytecoin_signing_state_t* sig_state,
-        const wallet_keys_t* wallet_keys,
-        uint64_t amount,
         uint8_t dst_address_tag,
         const public_key_t* dst_address_s,
-        const public_key_t* dst_address_s_v,
-        public_key_t* public_key,
-        public_key_t* encrypted_secret,
-        uint8_t* encrypted_address_type)
+        const public_key_t* dst_address_s_v)
 {
     if (sig_state->dst_address_set)
     {
@@ -278,6 +436,21 @@ void add_output(
         sig_state->dst_address_s = *dst_address_s;
         sig_state->dst_address_s_v = *dst_address_s_v;
     }
+}
+
+static
+void add_output(
+        bytecoin_signing_state_t* sig_state,
+        const wallet_keys_t* wallet_keys,
+        uint64_t amount,
+        uint8_t dst_address_tag,
+        const public_key_t* dst_address_s,
+        const public_key_t* dst_address_s_v,
+        public_key_t* public_key,
+        public_key_t* encrypted_secret,
+        uint8_t* encrypted_address_type)
+{
+    sig_set_dst_address(sig_state, dst_address_tag, dst_address_s, dst_address_s_v);
     const bool is_amount_ok = add_amount(&sig_state->dst_amount, amount);
     if (!is_amount_ok)
     {
@@ -290,6 +463,7 @@ void add_output(
 int sig_add_output(
         bytecoin_signing_state_t* sig_state,
         const wallet_keys_t* wallet_keys,
+        address_secret_cache_t* address_cache,
         bool change,
         uint64_t amount,
         uint32_t change_address_index,
@@ -311,6 +485,7 @@ int sig_add_output(
         add_change_output(
                     sig_state,
                     wallet_keys,
+                    address_cache,
                     amount,
                     change_address_index,
                     public_key,
@@ -349,7 +524,7 @@ int sig_add_output(
 
     sig_state->status = SIG_STATE_EXPECT_USER_CONFIRMATION;
     sig_state->dst_fee = fee;
-    return user_confirm_tx();
+    return SW_NO_ERROR; // the caller asks the user to confirm
 
 //    sig_add_output_final(sig_state); // DEBUG: bypass the confirmation
 //    return SW_NO_ERROR;
@@ -412,54 +587,35 @@ void calc_sig_p(
 
 static
 void calc_x(
-        const bytecoin_signing_state_t* sig_state,
-        const wallet_keys_t* wallet_keys,
+        const sign_secrets_t* k,
         const elliptic_curve_point_t* b_coin,
         public_key_t* x)
 {
-    secret_key_t ks;
-    secret_key_t ka;
-    generate_sign_secret(wallet_keys, sig_state->inputs_counter, ks_str, &sig_state->random_seed, &ks);
-    generate_sign_secret(wallet_keys, sig_state->inputs_counter, ka_str, &sig_state->random_seed, &ka);
-
     elliptic_curve_point_t p1_add;
     elliptic_curve_point_t p2_add;
-    ecmul_H(&ks, &p1_add);
-    ecmul(b_coin, &ka, &p2_add);
+    ecmul_H(&k->ks, &p1_add);
+    ecmul(b_coin, &k->ka, &p2_add);
     ecadd(&p1_add, &p2_add, x); // x = ks * H + ka * b_coin
 }
 
 static
 void calc_yz(
-        const bytecoin_signing_state_t* sig_state,
-        const wallet_keys_t* wallet_keys,
-        const public_key_t* output_public_key,
+        const sign_secrets_t* k,
+        const elliptic_curve_point_t* hash_pubs_sec,
         const elliptic_curve_point_t* b_coin,
         elliptic_curve_point_t* y,
         elliptic_curve_point_t* z)
 {
-    secret_key_t kr;
-    generate_sign_secret(wallet_keys, sig_state->inputs_counter, kr_str, &sig_state->random_seed, &kr);
-
     {
         elliptic_curve_point_t G_plus_B;
         ecadd_G(b_coin, &G_plus_B);
-        ecmul(&G_plus_B, &kr, y);
+        ecmul(&G_plus_B, &k->kr, y);
     }
-    elliptic_curve_point_t hash_pubs_sec;
-    hash_point_to_good_point(output_public_key, &hash_pubs_sec);
-    ecmul(&hash_pubs_sec, &kr, z);
+    ecmul(hash_pubs_sec, &k->kr, z);
 }
 
-void sig_step_a(
-        bytecoin_signing_state_t* sig_state,
-        const wallet_keys_t* wallet_keys,
-        const uint8_t* output_secret_hash_arg,
-        uint32_t output_secret_hash_arg_len,
-        uint32_t address_index,
-        elliptic_curve_point_t* sig_p,
-        elliptic_curve_point_t* y,
-        elliptic_curve_point_t* z)
+static
+void expect_step_a(bytecoin_signing_state_t* sig_state)
 {
     if (sig_state->status == SIG_STATE_EXPECT_STEP_A_MORE_DATA && sig_state->inputs_counter + 1 < sig_state->inputs_num)
     {
@@ -473,45 +629,77 @@ void sig_step_a(
         THROW(SW_COMMAND_NOT_ALLOWED);
         return;
     }
+}
 
-    secret_key_t inv_output_secret_hash;
-    {
-        elliptic_curve_scalar_t output_secret_hash;
-        hash_to_scalar(output_secret_hash_arg, output_secret_hash_arg_len, &output_secret_hash);
-        invert32(&output_secret_hash, &inv_output_secret_hash);
-    }
+static
+void step_a(
+        bytecoin_signing_state_t* sig_state,
+        const wallet_keys_t* wallet_keys,
+        const bytecoin_input_secrets_t* secrets,
+        elliptic_curve_point_t* sig_p,
+        elliptic_curve_point_t* y,
+        elliptic_curve_point_t* z)
+{
+    keccak_update(&sig_state->tx_prefix_hasher, secrets->inv_output_secret_hash.data, sizeof(secrets->inv_output_secret_hash.data));
+    keccak_update_varint(&sig_state->tx_prefix_hasher, secrets->address_index);
+
+    calc_sig_p(&secrets->b_coin, &secrets->output_secret_key_a, &secrets->output_secret_key_s, sig_p);
+    keccak_update(&sig_state->tx_inputs_hasher, sig_p->data, sizeof(sig_p->data));
 
-    secret_key_t output_secret_key_a;
+    sign_secrets_t k;
+    generate_sign_secrets(wallet_keys, sig_state->inputs_counter, &sig_state->random_seed, &k);
     {
-        secret_key_t address_audit_secret_key;
-        prepare_address_secret(wallet_keys, address_index, &address_audit_secret_key);
-        ecmulm(&address_audit_secret_key, &inv_output_secret_hash, &output_secret_key_a);
+        public_key_t x;
+        calc_x(&k, &secrets->b_coin, &x);
+        keccak_update(&sig_state->tx_inputs_hasher, x.data, sizeof(x.data));
     }
-    secret_key_t output_secret_key_s;
-    ecmulm(&wallet_keys->spend_secret_key, &inv_output_secret_hash, &output_secret_key_s);
-    public_key_t output_public_key;
-    secret_keys_to_public_key(&output_secret_key_a, &output_secret_key_s, &output_public_key);
-    keyimage_t keyimage;
-    generate_keyimage(&output_public_key, &output_secret_key_a, &keyimage);
 
-    keccak_update(&sig_state->tx_prefix_hasher, inv_output_secret_hash.data, sizeof(inv_output_secret_hash.data));
-    keccak_update_varint(&sig_state->tx_prefix_hasher, address_index);
+    calc_yz(&k, &secrets->hash_pubs_sec, &secrets->b_coin, y, z);
 
-    elliptic_curve_point_t b_coin;
-    hash_point_to_good_point(&keyimage, &b_coin);
+    sig_state->status = SIG_STATE_EXPECT_STEP_A_MORE_DATA;
+}
 
-    calc_sig_p(&b_coin, &output_secret_key_a, &output_secret_key_s, sig_p);
-    keccak_update(&sig_state->tx_inputs_hasher, sig_p->data, sizeof(sig_p->data));
+void sig_step_a(
+        bytecoin_signing_state_t* sig_state,
+        const wallet_keys_t* wallet_keys,
+        address_secret_cache_t* address_cache,
+        const uint8_t* output_secret_hash_arg,
+        uint32_t output_secret_hash_arg_len,
+        uint32_t address_index,
+        elliptic_curve_point_t* sig_p,
+        elliptic_curve_point_t* y,
+        elliptic_curve_point_t* z)
+{
+    expect_step_a(sig_state);
 
+    elliptic_curve_scalar_t output_secret_hash;
+    hash_to_scalar(output_secret_hash_arg, output_secret_hash_arg_len, &output_secret_hash);
+    bytecoin_input_secrets_t secrets;
+    if (!recall_input_secrets(sig_state, wallet_keys, address_cache, &output_secret_hash, address_index, &secrets))
     {
-        public_key_t x;
-        calc_x(sig_state, wallet_keys, &b_coin, &x);
-        keccak_update(&sig_state->tx_inputs_hasher, x.data, sizeof(x.data));
+        derive_input_secrets(wallet_keys, address_cache, &output_secret_hash, address_index, &secrets);
+        keyimage_t keyimage;
+        derive_input_keyimage(&secrets, &keyimage);
+        hash_point_to_good_point(&keyimage, &secrets.b_coin);
     }
 
-    calc_yz(sig_state, wallet_keys, &output_public_key, &b_coin, y, z);
+    step_a(sig_state, wallet_keys, &secrets, sig_p, y, z);
+}
 
-    sig_state->status = SIG_STATE_EXPECT_STEP_A_MORE_DATA;
+void sig_step_a_token(
+        bytecoin_signing_state_t* sig_state,
+        const wallet_keys_t* wallet_keys,
+        const bytecoin_input_token_t* token,
+        elliptic_curve_point_t* sig_p,
+        elliptic_curve_point_t* y,
+        elliptic_curve_point_t* z)
+{
+    expect_step_a(sig_state);
+
+    bytecoin_input_secrets_t secrets;
+    open_input_token(sig_state, wallet_keys, token, &secrets);
+
+    step_a(sig_state, wallet_keys, &secrets, sig_p, y, z);
 }
 
 void sig_step_a_more_data(
@@ -549,17 +737,8 @@ void sig_get_c0(
     sig_state->status = SIG_STATE_EXPECT_STEP_B;
 }
 
-void sig_step_b(
-        bytecoin_signing_state_t* sig_state,
-        const wallet_keys_t* wallet_keys,
-        const uint8_t* output_secret_hash_arg,
-        uint32_t output_secret_hash_arg_len,
-        uint32_t address_index,
-        const elliptic_curve_scalar_t* my_c,
-        hash_t* sig_my_rr,
-        hash_t* sig_rs,
-        hash_t* sig_ra,
-        hash_t* e_key)
+static
+void expect_step_b(const bytecoin_signing_state_t* sig_state)
 {
     const bool call_is_expected = (sig_state->status == SIG_STATE_EXPECT_STEP_B && sig_state->inputs_counter < sig_state->inputs_num);
     if (!call_is_expected)
@@ -567,52 +746,54 @@ void sig_step_b(
         THROW(SW_COMMAND_NOT_ALLOWED);
         return;
     }
+}
 
-    secret_key_t inv_output_secret_hash;
-    {
-        elliptic_curve_scalar_t output_secret_hash;
-        hash_to_scalar(output_secret_hash_arg, output_secret_hash_arg_len, &output_secret_hash);
-        invert32(&output_secret_hash, &inv_output_secret_hash);
-    }
+static
+void step_b(
+        bytecoin_signing_state_t* sig_state,
+        const wallet_keys_t* wallet_keys,
+        const bytecoin_input_secrets_t* secrets,
+        const elliptic_curve_scalar_t* my_c,
+        bool key_stream,
+        hash_t* sig_my_rr,
+        hash_t* sig_rs,
+        hash_t* sig_ra,
+        hash_t* e_key)
+{
+    keccak_update(&sig_state->tx_prefix_hasher, secrets->inv_output_secret_hash.data, sizeof(secrets->inv_output_secret_hash.data));
+    keccak_update_varint(&sig_state->tx_prefix_hasher, secrets->address_index);
 
-    secret_key_t output_secret_key_a;
+    sign_secrets_t k;
+    generate_sign_secrets(wallet_keys, sig_state->inputs_counter, &sig_state->random_seed, &k);
+    secret_key_t rsig[3]; // my_rr, rs, ra in the order of the response
     {
-        secret_key_t address_audit_secret_key;
-        prepare_address_secret(wallet_keys, address_index, &address_audit_secret_key);
-        ecmulm(&address_audit_secret_key, &inv_output_secret_hash, &output_secret_key_a);
+        elliptic_curve_scalar_t rr_sub;
+        ecmulm(my_c, &secrets->output_secret_key_a, &rr_sub);
+        ecsubm(&k.kr, &rr_sub, &rsig[0]);
     }
-    secret_key_t output_secret_key_s;
-    ecmulm(&wallet_keys->spend_secret_key, &inv_output_secret_hash, &output_secret_key_s);
-
-    keccak_update(&sig_state->tx_prefix_hasher, inv_output_secret_hash.data, sizeof(inv_output_secret_hash.data));
-    keccak_update_varint(&sig_state->tx_prefix_hasher, address_index);
-
     {
-        secret_key_t ks;
-        generate_sign_secret(wallet_keys, sig_state->inputs_counter, ks_str, &sig_state->random_seed, &ks);
         elliptic_curve_scalar_t rs_sub;
-        ecmulm(&sig_state->c0, &output_secret_key_s, &rs_sub);
-        secret_key_t rsig_rs;
-        ecsubm(&ks, &rs_sub, &rsig_rs);
-        encrypt_scalar(&sig_state->encryption_key, &rsig_rs, sig_state->inputs_counter, rs_str, sig_rs);
+        ecmulm(&sig_state->c0, &secrets->output_secret_key_s, &rs_sub);
+        ecsubm(&k.ks, &rs_sub, &rsig[1]);
     }
     {
-        secret_key_t ka;
-        generate_sign_secret(wallet_keys, sig_state->inputs_counter, ka_str, &sig_state->random_seed, &ka);
         elliptic_curve_scalar_t ra_add;
-        ecmulm(&sig_state->c0, &output_secret_key_a, &ra_add);
-        secret_key_t rsig_ra;
-        ecaddm(&ka, &ra_add, &rsig_ra);
-        encrypt_scalar(&sig_state->encryption_key, &rsig_ra, sig_state->inputs_counter, ra_str, sig_ra);
+        ecmulm(&sig_state->c0, &secrets->output_secret_key_a, &ra_add);
+        ecaddm(&k.ka, &ra_add, &rsig[2]);
     }
+    if (key_stream)
     {
-        secret_key_t kr;
-        generate_sign_secret(wallet_keys, sig_state->inputs_counter, kr_str, &sig_state->random_seed, &kr);
-        elliptic_curve_scalar_t rr_sub;
-        ecmulm(my_c, &output_secret_key_a, &rr_sub);
-        secret_key_t rsig_my_rr;
-        ecsubm(&kr, &rr_sub, &rsig_my_rr);
-        encrypt_scalar(&sig_state->encryption_key, &rsig_my_rr, sig_state->inputs_counter, rr_str, sig_my_rr);
+        hash_t encrypted[3];
+        encrypt_scalars(&sig_state->encryption_key, rsig, sig_state->inputs_counter, encrypted);
+        *sig_my_rr = encrypted[0];
+        *sig_rs = encrypted[1];
+        *sig_ra = encrypted[2];
+    }
+    else
+    {
+        encrypt_scalar(&sig_state->encryption_key, &rsig[0], sig_state->inputs_counter, rr_str, sig_my_rr);
+        encrypt_scalar(&sig_state->encryption_key, &rsig[1], sig_state->inputs_counter, rs_str, sig_rs);
+        encrypt_scalar(&sig_state->encryption_key, &rsig[2], sig_state->inputs_counter, ra_str, sig_ra);
     }
 
     if (++sig_state->inputs_counter < sig_state->inputs_num)
@@ -626,14 +807,60 @@ void sig_step_b(
         os_memset(sig_state->encryption_key.data, 0, sizeof(sig_state->encryption_key.data));
     *e_key = sig_state->encryption_key;
 
+    os_memset(sig_state->input_cache, 0, sizeof(sig_state->input_cache));
     sig_state->status = SIG_STATE_FINISHED;
 }
 
+void sig_step_b(
+        bytecoin_signing_state_t* sig_state,
+        const wallet_keys_t* wallet_keys,
+        address_secret_cache_t* address_cache,
+        const uint8_t* output_secret_hash_arg,
+        uint32_t output_secret_hash_arg_len,
+        uint32_t address_index,
+        const elliptic_curve_scalar_t* my_c,
+        bool key_stream,
+        hash_t* sig_my_rr,
+        hash_t* sig_rs,
+        hash_t* sig_ra,
+        hash_t* e_key)
+{
+    expect_step_b(sig_state);
+
+    elliptic_curve_scalar_t output_secret_hash;
+    hash_to_scalar(output_secret_hash_arg, output_secret_hash_arg_len, &output_secret_hash);
+    bytecoin_input_secrets_t secrets;
+    if (!recall_input_secrets(sig_state, wallet_keys, address_cache, &output_secret_hash, address_index, &secrets))
+        derive_input_secrets(wallet_keys, address_cache, &output_secret_hash, address_index, &secrets);
+
+    step_b(sig_state, wallet_keys, &secrets, my_c, key_stream, sig_my_rr, sig_rs, sig_ra, e_key);
+}
+
+void sig_step_b_token(
+        bytecoin_signing_state_t* sig_state,
+        const wallet_keys_t* wallet_keys,
+        const bytecoin_input_token_t* token,
+        const elliptic_curve_scalar_t* my_c,
+        bool key_stream,
+        hash_t* sig_my_rr,
+        hash_t* sig_rs,
+        hash_t* sig_ra,
+        hash_t* e_key)
+{
+    expect_step_b(sig_state);
+
+    bytecoin_input_secrets_t secrets;
+    open_input_token(sig_state, wallet_keys, token, &secrets);
+
+    step_b(sig_state, wallet_keys, &secrets, my_c, key_stream, sig_my_rr, sig_rs, sig_ra, e_key);
+}
+
 void sig_proof_start(
         bytecoin_signing_state_t* sig_state,
         uint32_t len)
 {
     init_signing_state(sig_state);
+    generate_token_key(&sig_state->token_key);
     sig_state->inputs_num = 1;
     sig_state->extra_size = len;
 
@@ -23,6 +23,50 @@
 #include "bytecoin_wallet.h"
 #include "bytecoin_crypto.h"
 
+#define BYTECOIN_INPUT_KEY_TAG  2
+#define BYTECOIN_OUTPUT_KEY_TAG 2
+
+// What steps A and B need of an input, handed out after its key image so they
+// need not derive it again: address_index (4), the inverse of the output
+// secret hash and output_secret_key_a encrypted (2 * 32), the key image base
+// and b_coin (2 * 32) and a tag (16). It holds for its input of the
+// transaction in progress only.
+#define BYTECOIN_INPUT_TOKEN_TAG_SIZE 16
+#define BYTECOIN_INPUT_TOKEN_SIZE     (4 + 4 * 32 + BYTECOIN_INPUT_TOKEN_TAG_SIZE)
+
+typedef struct bytecoin_input_token_s
+{
+    uint8_t data[BYTECOIN_INPUT_TOKEN_SIZE];
+} bytecoin_input_token_t;
+
+// what steps A and B need of an input, derived from its key image arguments
+// or read from its token
+typedef struct bytecoin_input_secrets_s
+{
+    secret_key_t inv_output_secret_hash;
+    secret_key_t output_secret_key_a;
+    secret_key_t output_secret_key_s;
+    elliptic_curve_point_t hash_pubs_sec; // the base of the key image
+    elliptic_curve_point_t b_coin;
+    uint32_t address_index;
+} bytecoin_input_secrets_t;
+
+// What sig_add_input_finish derived for the first inputs, in the slot of the
+// input index, for steps A and B given the same arguments. The inverse stands
+// for the output secret hash it was computed from, and the secret keys follow
+// from it. hash_pubs_sec and b_coin are the points sig_add_input_finish
+// hashed to the curve, step A does not hash them again. Inputs past the cache
+// derive everything again. Wiped when the signing finishes.
+#define BYTECOIN_INPUT_CACHE_SIZE 4
+
+typedef struct bytecoin_input_cache_entry_s
+{
+    secret_key_t inv_output_secret_hash;
+    elliptic_curve_point_t hash_pubs_sec;
+    elliptic_curve_point_t b_coin;
+    uint32_t address_index;
+} bytecoin_input_cache_entry_t;
+
 typedef enum bytecoin_signature_status_e
 {
     SIG_STATE_FINISHED = 0,
@@ -48,10 +92,13 @@ typedef struct bytecoin_signing_state_s
     hash_t random_seed;
     hash_t tx_inputs_hash;
     hash_t encryption_key;
+    hash_t token_key;       // of the input tokens of this transaction
     hash_t step_args_hash;
 
     elliptic_curve_scalar_t c0;
 
+    bytecoin_input_cache_entry_t input_cache[BYTECOIN_INPUT_CACHE_SIZE];
+
     uint64_t inputs_amount;
     uint64_t dst_amount;
     uint64_t change_amount;
@@ -97,13 +144,24 @@ void sig_add_input_indexes(
 void sig_add_input_finish(
         bytecoin_signing_state_t* sig_state,
         const wallet_keys_t* wallet_keys,
+        address_secret_cache_t* address_cache,
         const uint8_t* output_secret_hash_arg,
         uint32_t output_secret_hash_arg_len,
-        uint32_t address_index);
+        uint32_t address_index,
+        bytecoin_input_token_t* token); // may be NULL
+
+// the destination of every output that is not change, checked against the
+// one set before
+void sig_set_dst_address(
+        bytecoin_signing_state_t* sig_state,
+        uint8_t dst_address_tag,
+        const public_key_t* dst_address_s,
+        const public_key_t* dst_address_s_v);
 
 int sig_add_output(
         bytecoin_signing_state_t* sig_state,
         const wallet_keys_t* wallet_keys,
+        address_secret_cache_t* address_cache,
         bool change,
         uint64_t amount,
         uint32_t change_address_index,
@@ -124,6 +182,7 @@ void sig_add_extra(
 void sig_step_a(
         bytecoin_signing_state_t* sig_state,
         const wallet_keys_t* wallet_keys,
+        address_secret_cache_t* address_cache,
         const uint8_t* output_secret_hash_arg,
         uint32_t output_secret_hash_arg_len,
         uint32_t address_index,
@@ -131,6 +190,14 @@ void sig_step_a(
         elliptic_curve_point_t* y,
         elliptic_curve_point_t* z);
 
+void sig_step_a_token(
+        bytecoin_signing_state_t* sig_state,
+        const wallet_keys_t* wallet_keys,
+        const bytecoin_input_token_t* token,
+        elliptic_curve_point_t* sig_p,
+        elliptic_curve_point_t* y,
+        elliptic_curve_point_t* z);
+
 void sig_step_a_more_data(
         bytecoin_signing_state_t* sig_state,
         const void* buf,
@@ -143,10 +210,23 @@ void sig_get_c0(
 void sig_step_b(
         bytecoin_signing_state_t* sig_state,
         const wallet_keys_t* wallet_keys,
+        address_secret_cache_t* address_cache,
         const uint8_t* output_secret_hash_arg,
         uint32_t output_secret_hash_arg_len,
         uint32_t address_index,
         const elliptic_curve_scalar_t* my_c,
+        bool key_stream, // encrypt_scalars() instead of encrypt_scalar()
+        hash_t* sig_my_rr,
+        hash_t* sig_rs,
+        hash_t* sig_ra,
+        hash_t* e_key);
+
+void sig_step_b_token(
+        bytecoin_signing_state_t* sig_state,
+        const wallet_keys_t* wallet_keys,
+        const bytecoin_input_token_t* token,
+        const elliptic_curve_scalar_t* my_c,
+        bool key_stream, // encrypt_scalars() instead of encrypt_scalar()
         hash_t* sig_my_rr,
         hash_t* sig_rs,
         hash_t* sig_ra,
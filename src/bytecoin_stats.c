@@ -0,0 +1,76 @@
+/*******************************************************************************
+*   Bytecoin Wallet for Ledger Nano S
+*   (c) 2018 - 2019 The Bytecoin developers
+*
+*  Licensed under the Apache License, Version 2.0 (the "License");
+*  you may not use this file except in compliance with the License.
+*  You may obtain a copy of the License at
+*
+*      http://www.apache.org/licenses/LICENSE-2.0
+*
+*  Unless required by applicable law or agreed to in writing, software
+*  distributed under the License is distributed on an "AS IS" BASIS,
+*  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+*  See the License for the specific language governing permissions and
+*  limitations under the License.
+********************************************************************************/
+
+#include "os.h"
+#include "bytecoin_stats.h"
+
+#ifdef BYTECOIN_CRYPTO_COUNTERS
+BYTECOIN_THREAD_LOCAL bytecoin_crypto_counters_t G_crypto_counters;
+
+void next_crypto_counters(void)
+{
+    os_memmove(G_crypto_counters.last, G_crypto_counters.current, sizeof(G_crypto_counters.last));
+    os_memset(G_crypto_counters.current, 0, sizeof(G_crypto_counters.current));
+}
+#endif
+
+#ifdef BYTECOIN_STATS
+void init_stats(bytecoin_stats_t* stats)
+{
+    os_memset(stats, 0, sizeof(bytecoin_stats_t));
+    stats->current_slot = BYTECOIN_STATS_NO_SLOT;
+}
+
+#define STATS_SLOT_INS(ins) ins,
+static const uint8_t slot_ins[BYTECOIN_STATS_SLOTS] = { INS_NONE, BYTECOIN_STATS_INS(STATS_SLOT_INS) };
+
+uint8_t stats_slot(uint8_t ins)
+{
+    for (uint8_t slot = 1; slot < BYTECOIN_STATS_SLOTS; ++slot)
+        if (slot_ins[slot] == ins)
+            return slot;
+    return 0;
+}
+
+uint8_t stats_slot_ins(uint8_t slot)
+{
+    return slot_ins[slot];
+}
+
+void stats_begin(bytecoin_stats_t* stats, uint8_t ins, uint16_t bytes_in)
+{
+    stats->current_slot = stats_slot(ins);
+    bytecoin_ins_stats_t* s = &stats->ins[stats->current_slot];
+    s->calls += 1;
+    s->bytes_in += bytes_in;
+}
+
+void stats_end(bytecoin_stats_t* stats, uint16_t sw, uint16_t bytes_out)
+{
+    // io_do threw before a command was received
+    if (stats->current_slot == BYTECOIN_STATS_NO_SLOT)
+        return;
+    bytecoin_ins_stats_t* s = &stats->ins[stats->current_slot];
+    stats->current_slot = BYTECOIN_STATS_NO_SLOT;
+    s->bytes_out += bytes_out;
+    // sw == 0: the reply waits for the user and is not counted, 61xx: more
+    // of the response follows
+    const uint8_t failed = sw != SW_NO_ERROR && sw != 0 && (sw & 0xFF00) != SW_BYTES_REMAINING_00;
+    if (failed && s->errors != UINT16_MAX)
+        s->errors += 1;
+}
+#endif
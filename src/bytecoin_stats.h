@@ -0,0 +1,130 @@
+/*******************************************************************************
+*   Bytecoin Wallet for Ledger Nano S
+*   (c) 2018 - 2019 The Bytecoin developers
+*
+*  Licensed under the Apache License, Version 2.0 (the "License");
+*  you may not use this file except in compliance with the License.
+*  You may obtain a copy of the License at
+*
+*      http://www.apache.org/licenses/LICENSE-2.0
+*
+*  Unless required by applicable law or agreed to in writing, software
+*  distributed under the License is distributed on an "AS IS" BASIS,
+*  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+*  See the License for the specific language governing permissions and
+*  limitations under the License.
+********************************************************************************/
+
+#ifndef BYTECOIN_STATS_H
+#define BYTECOIN_STATS_H
+
+#include <stdint.h>
+#include "bytecoin_ledger_api.h"
+
+#ifdef BYTECOIN_STATS
+// Calls, errors and bytes per instruction for INS_GET_STATS, for diagnostic
+// builds only. I(ins) of the instructions with a slot of their own, in INS
+// order; slot 0 collects the others.
+#define BYTECOIN_STATS_INS(I) \
+    I(INS_GET_WALLET_KEYS) \
+    I(INS_SCAN_OUTPUTS) \
+    I(INS_GENERATE_KEYIMAGE) \
+    I(INS_GENERATE_OUTPUT_SEED) \
+    I(INS_EXPORT_VIEW_ONLY) \
+    I(INS_SIG_START) \
+    I(INS_SIG_ADD_INPUT_START) \
+    I(INS_SIG_ADD_INPUT_INDEXES) \
+    I(INS_SIG_ADD_INPUT_FINISH) \
+    I(INS_SIG_ADD_OUPUT) \
+    I(INS_SIG_ADD_EXTRA) \
+    I(INS_SIG_STEP_A) \
+    I(INS_SIG_STEP_A_MORE_DATA) \
+    I(INS_SIG_GET_C0) \
+    I(INS_SIG_STEP_B) \
+    I(INS_SIG_PROOF_START) \
+    I(INS_GET_APP_INFO) \
+    I(INS_GET_STATS) \
+    I(INS_GET_CRYPTO_COUNTERS) \
+    I(INS_BATCH) \
+    I(INS_GET_LAST_RESPONSE) \
+    I(INS_SIG_ADD_INPUT) \
+    I(INS_SIG_ADD_INPUT_VARINTS) \
+    I(INS_SIG_ADD_OUTPUTS) \
+    I(INS_SIG_STEP_A_INPUTS) \
+    I(INS_SIG_STEP_B_INPUTS) \
+    I(INS_SIG_PREFIX) \
+    I(INS_SIG_STEP_A_TOKEN) \
+    I(INS_SIG_STEP_B_TOKEN)
+
+#define BYTECOIN_STATS_ONE_SLOT(ins) + 1
+#define BYTECOIN_STATS_SLOTS     (1 BYTECOIN_STATS_INS(BYTECOIN_STATS_ONE_SLOT))
+#define BYTECOIN_STATS_NO_SLOT   0xFF
+
+typedef struct bytecoin_ins_stats_s
+{
+    uint32_t calls;
+    uint32_t bytes_in;
+    uint32_t bytes_out;
+    uint16_t errors;
+} bytecoin_ins_stats_t;
+
+typedef struct bytecoin_stats_s
+{
+    bytecoin_ins_stats_t ins[BYTECOIN_STATS_SLOTS];
+    uint8_t current_slot; // BYTECOIN_STATS_NO_SLOT outside of stats_begin/stats_end
+} bytecoin_stats_t;
+
+void init_stats(bytecoin_stats_t* stats);
+
+uint8_t stats_slot(uint8_t ins);
+uint8_t stats_slot_ins(uint8_t slot);
+
+// called by the main loop around dispatch()
+void stats_begin(bytecoin_stats_t* stats, uint8_t ins, uint16_t bytes_in);
+void stats_end(bytecoin_stats_t* stats, uint16_t sw, uint16_t bytes_out);
+#endif
+
+#ifdef BYTECOIN_CRYPTO_COUNTERS
+// Crypto operations of the current and of the previous command, for profiling
+// builds only. The order is part of INS_GET_CRYPTO_COUNTERS.
+typedef enum bytecoin_crypto_op_e
+{
+    CRYPTO_OP_DECOMPRESS_POINT = 0,
+    CRYPTO_OP_COMPRESS_POINT,
+    CRYPTO_OP_ECMUL,
+    CRYPTO_OP_D_ECMUL,
+    CRYPTO_OP_ECADD,
+    CRYPTO_OP_D_ECADD,
+    CRYPTO_OP_ECSUB,
+    CRYPTO_OP_ECMUL_8,
+    CRYPTO_OP_INVERT32,
+    CRYPTO_OP_REDUCE32,
+    CRYPTO_OP_REDUCE64,
+    CRYPTO_OP_GE_FROMFE_FROMBYTES,
+    CRYPTO_OP_FE_MATH,
+    CRYPTO_OP_KECCAK_PERMUTATION,
+    CRYPTO_OP_COUNT
+} bytecoin_crypto_op_t;
+
+typedef struct bytecoin_crypto_counters_s
+{
+    uint16_t current[CRYPTO_OP_COUNT];
+    uint16_t last[CRYPTO_OP_COUNT];
+} bytecoin_crypto_counters_t;
+
+// host builds running devices on several threads make it per thread
+#ifndef BYTECOIN_THREAD_LOCAL
+#define BYTECOIN_THREAD_LOCAL
+#endif
+
+extern BYTECOIN_THREAD_LOCAL bytecoin_crypto_counters_t G_crypto_counters;
+
+// called by the main loop before dispatch(), the counts of the previous command become the last ones
+void next_crypto_counters(void);
+
+#define COUNT_CRYPTO_OP(op) (++G_crypto_counters.current[(op)])
+#else
+#define COUNT_CRYPTO_OP(op) ((void)0)
+#endif
+
+#endif // BYTECOIN_STATS_H
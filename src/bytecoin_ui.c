@@ -23,7 +23,9 @@
 #include "bytecoin_vars.h"
 #include "bytecoin_keys.h"
 #include "bytecoin_apdu.h"
+#include "bytecoin_dispatch.h"
 #include "bytecoin_debug.h"
+#include "bytecoin_ui_text.h"
 
 extern unsigned char G_io_seproxyhal_spi_buffer[IO_SEPROXYHAL_BUFFER_SIZE_B];
 ux_state_t ux;
@@ -32,8 +34,6 @@ ux_state_t ux;
 #define MENU_CURRENT_ENTRY_LINE1_ID 0x21 // line1 and line2 preprocessors aren't called if line2 is null
 #define MENU_CURRENT_ENTRY_LINE2_ID 0x22
 
-static const char BCN_str[] = " BCN";
-
 void init_ui_data(ui_data_t* ui_data)
 {
     os_memset(ui_data, 0, sizeof(ui_data_t));
@@ -106,7 +106,7 @@ const bagl_element_t* ui_menu_main_preprocessor(const ux_menu_entry_t* entry, ba
 
                 public_key_t address_S;
                 public_key_t address_Sv;
-                prepare_address_public(&G_bytecoin_vstate.wallet_keys, 0, &address_S, &address_Sv);
+                prepare_address_public(&G_bytecoin_vstate.wallet_keys, &G_bytecoin_vstate.address_cache, 0, &address_S, &address_Sv);
                 size = encode_address(BYTECOIN_ADDRESS_BASE58_PREFIX_AMETHYST, &address_S, &address_Sv, addr_str, size);
                 short_address(addr_str, size);
                 G_bytecoin_vstate.ui_data.string_is_valid = true;
@@ -241,18 +241,20 @@ unsigned int ui_export_viewkey_button(unsigned int button_mask, unsigned int but
         sw = SW_SECURITY_STATUS_NOT_SATISFIED;
         break;
     case BUTTON_EVT_RELEASED | BUTTON_RIGHT:  // OK
-          return user_confirm_view_outgoing_addresses();
+          return user_confirm_view_outgoing_addresses(&G_bytecoin_vstate);
         break;
     default:
         return 0;
     }
-    insert_var(sw);
-    io_do(&G_bytecoin_vstate.prev_io_call_params, &G_bytecoin_vstate.io_buffer, IO_RETURN_AFTER_TX);
+    bytecoin_v_state_t* state = &G_bytecoin_vstate;
+    finish_response(state, sw);
+    io_do(&state->prev_io_call_params, &state->io_buffer, IO_RETURN_AFTER_TX);
     ui_menu_main_display(0);
     return 0;
 }
 
-int user_confirm_export_view_only(void)
+// the device UI only ever drives the firmware's single instance
+int user_confirm_export_view_only(bytecoin_v_state_t* state)
 {
     ask_pin_if_needed();
     UX_DISPLAY(ui_export_viewkey, ui_export_viewkey_preprocessor);
@@ -322,14 +324,15 @@ unsigned int ui_view_outgoing_addresses_button(unsigned int button_mask, unsigne
     default:
         return 0;
     }
-    const uint16_t sw = bytecoin_apdu_export_view_only_final(allow);
-    insert_var(sw);
-    io_do(&G_bytecoin_vstate.prev_io_call_params, &G_bytecoin_vstate.io_buffer, IO_RETURN_AFTER_TX);
+    bytecoin_v_state_t* state = &G_bytecoin_vstate;
+    const uint16_t sw = bytecoin_apdu_export_view_only_final(state, allow);
+    finish_response(state, sw);
+    io_do(&state->prev_io_call_params, &state->io_buffer, IO_RETURN_AFTER_TX);
     ui_menu_main_display(0);
     return 0;
 }
 
-int user_confirm_view_outgoing_addresses(void)
+int user_confirm_view_outgoing_addresses(bytecoin_v_state_t* state)
 {
     ask_pin_if_needed();
     UX_DISPLAY(ui_view_outgoing_addresses, ui_view_outgoing_addresses_preprocessor);
@@ -386,73 +389,6 @@ int user_confirm_view_outgoing_addresses(void)
 //    return amount_len;
 //}
 
-static
-void ffw(uint64_t amount, size_t digs, char* buf)
-{
-    for(; digs > 0; digs -=1)
-    {
-        const uint64_t d = amount % 10;
-        amount /= 10;
-        buf[digs - 1] = '0' + d;
-    }
-}
-
-static
-size_t amount2str(uint64_t amount, char* buffer, size_t len)
-{
-    const size_t COIN = 100000000;
-    const size_t CENT = COIN / 100;
-    uint64_t ia = amount / COIN;
-    uint64_t fa = amount - ia * COIN;
-    size_t pos = 0;
-
-    while (ia >= 1000)
-    {
-        pos += 4;
-        os_memmove(buffer + 4, buffer, pos);
-        buffer[0] = '\'';
-        ffw(ia % 1000, 3, buffer + 1);
-        ia /= 1000;
-    }
-
-    while(true)
-    {
-        uint64_t d = ia % 10;
-        ia = ia / 10;
-        pos += 1;
-        memmove(buffer + 1, buffer, pos);
-        buffer[0] = '0' + d;
-        if(ia == 0)
-          break;
-    }
-
-    if (fa != 0)
-    {  // cents
-        buffer[pos++] = '.';
-        ffw(fa / CENT, 2, buffer + pos);
-        pos += 2;
-        fa %= CENT;
-    }
-
-    if (fa != 0)
-    {
-    //    buffer[pos++] = '\'';
-        ffw(fa / 1000, 3, buffer + pos);
-        pos += 3;
-        fa %= 1000;
-    }
-    if (fa != 0)
-    {
-    //    buffer[pos++] = '\'';
-        ffw(fa, 3, buffer + pos);
-        pos += 3;
-    }
-    return pos;
-}
-
-#define BYTECOIN_SIMPLE_ADDRESS_TAG     0
-#define BYTECOIN_UNLINKABLE_ADDRESS_TAG 1
-
 static
 void ui_confirm_tx_reject_action(unsigned int value);
 static
@@ -472,73 +408,23 @@ static
 const bagl_element_t* ui_menu_confirm_tx_preprocessor(const ux_menu_entry_t* entry, bagl_element_t* element)
 {
     const bytecoin_signing_state_t* sig_state = &G_bytecoin_vstate.sig_state;
-    if (entry == &ui_menu_confirm_tx[0])
-    {
-        switch (element->component.userid)
-        {
-        case MENU_CURRENT_ENTRY_LINE1_ID:
-            element->component.font_id = BAGL_FONT_OPEN_SANS_REGULAR_11px | BAGL_FONT_ALIGNMENT_CENTER;
-            break;
-        case MENU_CURRENT_ENTRY_LINE2_ID:
-            {
-                const uint64_t prefix = (sig_state->dst_address_tag == BYTECOIN_UNLINKABLE_ADDRESS_TAG) ? BYTECOIN_ADDRESS_BASE58_PREFIX_AMETHYST : BYTECOIN_ADDRESS_BASE58_PREFIX;
-                encode_address(prefix, &sig_state->dst_address_s, &sig_state->dst_address_s_v, G_bytecoin_vstate.ui_data.address_str, sizeof(G_bytecoin_vstate.ui_data.address_str) - 1);
-
-                element->component.stroke = 10;  // 1 sec stop in each way
-                element->component.icon_id = 35; // roundtrip speed in pixel/s
-                element->component.width = 95;
-                element->text = G_bytecoin_vstate.ui_data.address_str;
-                UX_CALLBACK_SET_INTERVAL(bagl_label_roundtrip_duration_ms(element, 8));
-            }
-            break;
-        }
-    }
-
-    if (entry == &ui_menu_confirm_tx[1])
+    for (ui_confirm_tx_item_t item = 0; item < UI_CONFIRM_TX_ITEMS; ++item)
     {
+        if (entry != &ui_menu_confirm_tx[item])
+            continue;
         switch (element->component.userid)
         {
         case MENU_CURRENT_ENTRY_LINE1_ID:
             element->component.font_id = BAGL_FONT_OPEN_SANS_REGULAR_11px | BAGL_FONT_ALIGNMENT_CENTER;
             break;
         case MENU_CURRENT_ENTRY_LINE2_ID:
-            {
-                const size_t len = amount2str(sig_state->dst_amount, G_bytecoin_vstate.ui_data.address_str, sizeof(G_bytecoin_vstate.ui_data.address_str));
-                if (len + sizeof(BCN_str) > sizeof(G_bytecoin_vstate.ui_data.address_str))
-                    THROW(SW_NOT_ENOUGH_MEMORY);
-                ;
-                os_memmove(G_bytecoin_vstate.ui_data.address_str + len, BCN_str, sizeof(BCN_str));
-
-                element->component.stroke = 10;  // 1 sec stop in each way
-                element->component.icon_id = 35; // roundtrip speed in pixel/s
-                element->component.width = 95;
-                element->text = G_bytecoin_vstate.ui_data.address_str;
-                UX_CALLBACK_SET_INTERVAL(bagl_label_roundtrip_duration_ms(element, 8));
-            }
-            break;
-        }
-    }
+            ui_confirm_tx_text(sig_state, item, G_bytecoin_vstate.ui_data.address_str, sizeof(G_bytecoin_vstate.ui_data.address_str));
 
-    if (entry == &ui_menu_confirm_tx[2])
-    {
-        switch (element->component.userid)
-        {
-        case MENU_CURRENT_ENTRY_LINE1_ID:
-            element->component.font_id = BAGL_FONT_OPEN_SANS_REGULAR_11px | BAGL_FONT_ALIGNMENT_CENTER;
-            break;
-        case MENU_CURRENT_ENTRY_LINE2_ID:
-            {
-                const size_t len = amount2str(sig_state->dst_fee, G_bytecoin_vstate.ui_data.address_str, sizeof(G_bytecoin_vstate.ui_data.address_str));
-                if (len + sizeof(BCN_str) > sizeof(G_bytecoin_vstate.ui_data.address_str))
-                    THROW(SW_NOT_ENOUGH_MEMORY);
-                os_memmove(G_bytecoin_vstate.ui_data.address_str + len, BCN_str, sizeof(BCN_str));
-
-                element->component.stroke = 10;  // 1 sec stop in each way
-                element->component.icon_id = 35; // roundtrip speed in pixel/s
-                element->component.width = 95;
-                element->text = G_bytecoin_vstate.ui_data.address_str;
-                UX_CALLBACK_SET_INTERVAL(bagl_label_roundtrip_duration_ms(element, 8));
-            }
+            element->component.stroke = 10;  // 1 sec stop in each way
+            element->component.icon_id = 35; // roundtrip speed in pixel/s
+            element->component.width = 95;
+            element->text = G_bytecoin_vstate.ui_data.address_str;
+            UX_CALLBACK_SET_INTERVAL(bagl_label_roundtrip_duration_ms(element, 8));
             break;
         }
     }
@@ -549,25 +435,27 @@ const bagl_element_t* ui_menu_confirm_tx_preprocessor(const ux_menu_entry_t* ent
 static
 void ui_confirm_tx_reject_action(unsigned int value)
 {
+    bytecoin_v_state_t* state = &G_bytecoin_vstate;
     const uint16_t sw = SW_SECURITY_STATUS_NOT_SATISFIED;
-    insert_var(sw);
-    io_do(&G_bytecoin_vstate.prev_io_call_params, &G_bytecoin_vstate.io_buffer, IO_RETURN_AFTER_TX);
+    finish_response(state, sw);
+    io_do(&state->prev_io_call_params, &state->io_buffer, IO_RETURN_AFTER_TX);
     ui_menu_main_display(0);
 }
 
 static
 void ui_confirm_tx_accept_action(unsigned int value)
 {
-    const uint16_t sw = bytecoin_apdu_sig_add_output_final();
-    insert_var(sw);
-    io_do(&G_bytecoin_vstate.prev_io_call_params, &G_bytecoin_vstate.io_buffer, IO_RETURN_AFTER_TX);
+    bytecoin_v_state_t* state = &G_bytecoin_vstate;
+    const uint16_t sw = bytecoin_apdu_sig_add_output_final(state);
+    finish_response(state, sw);
+    io_do(&state->prev_io_call_params, &state->io_buffer, IO_RETURN_AFTER_TX);
     ui_menu_main_display(0);
 }
 
 
-int user_confirm_tx(void)
+int user_confirm_tx(bytecoin_v_state_t* state)
 {
-    G_bytecoin_vstate.ui_data.string_is_valid = false;
+    state->ui_data.string_is_valid = false;
 
     ask_pin_if_needed();
     UX_MENU_DISPLAY(0, ui_menu_confirm_tx, ui_menu_confirm_tx_preprocessor);
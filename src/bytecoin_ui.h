@@ -31,14 +31,17 @@ typedef struct ui_data_s
     bool string_is_valid;
 } ui_data_t;
 
+struct bytecoin_v_state_s;
+
 void init_ui_data(ui_data_t* ui_data);
 void ui_init(void);
 
-int user_confirm_export_view_only(void);
+// the confirmations reply to the pending APDU of state once the user decides
+int user_confirm_export_view_only(struct bytecoin_v_state_s* state);
 
 // ask user if he/she wants to allow view wallet to view outgoing addresses
-int user_confirm_view_outgoing_addresses(void);
+int user_confirm_view_outgoing_addresses(struct bytecoin_v_state_s* state);
 
-int user_confirm_tx(void);
+int user_confirm_tx(struct bytecoin_v_state_s* state);
 
 #endif // BYTECOIN_UI_H
@@ -0,0 +1,119 @@
+/*******************************************************************************
+*   Bytecoin Wallet for Ledger Nano S
+*   (c) 2018 - 2019 The Bytecoin developers
+*
+*  Licensed under the Apache License, Version 2.0 (the "License");
+*  you may not use this file except in compliance with the License.
+*  You may obtain a copy of the License at
+*
+*      http://www.apache.org/licenses/LICENSE-2.0
+*
+*  Unless required by applicable law or agreed to in writing, software
+*  distributed under the License is distributed on an "AS IS" BASIS,
+*  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+*  See the License for the specific language governing permissions and
+*  limitations under the License.
+********************************************************************************/
+
+#include <string.h>
+#include "os.h"
+#include "bytecoin_ui_text.h"
+#include "bytecoin_ledger_api.h"
+#include "bytecoin_keys.h"
+
+#define BYTECOIN_UNLINKABLE_ADDRESS_TAG 1
+
+// the longest amount, 184'467'440'737.09551615
+#define AMOUNT_STR_MAX_LENGTH 24
+
+static const char BCN_str[] = " BCN";
+
+static
+void ffw(uint64_t amount, size_t digs, char* buf)
+{
+    for(; digs > 0; digs -=1)
+    {
+        const uint64_t d = amount % 10;
+        amount /= 10;
+        buf[digs - 1] = '0' + d;
+    }
+}
+
+size_t amount2str(uint64_t amount, char* buffer, size_t len)
+{
+    const size_t COIN = 100000000;
+    const size_t CENT = COIN / 100;
+    uint64_t ia = amount / COIN;
+    uint64_t fa = amount - ia * COIN;
+    size_t pos = 0;
+
+    while (ia >= 1000)
+    {
+        pos += 4;
+        os_memmove(buffer + 4, buffer, pos);
+        buffer[0] = '\'';
+        ffw(ia % 1000, 3, buffer + 1);
+        ia /= 1000;
+    }
+
+    while(true)
+    {
+        uint64_t d = ia % 10;
+        ia = ia / 10;
+        pos += 1;
+        memmove(buffer + 1, buffer, pos);
+        buffer[0] = '0' + d;
+        if(ia == 0)
+          break;
+    }
+
+    if (fa != 0)
+    {  // cents
+        buffer[pos++] = '.';
+        ffw(fa / CENT, 2, buffer + pos);
+        pos += 2;
+        fa %= CENT;
+    }
+
+    if (fa != 0)
+    {
+    //    buffer[pos++] = '\'';
+        ffw(fa / 1000, 3, buffer + pos);
+        pos += 3;
+        fa %= 1000;
+    }
+    if (fa != 0)
+    {
+    //    buffer[pos++] = '\'';
+        ffw(fa, 3, buffer + pos);
+        pos += 3;
+    }
+    return pos;
+}
+
+size_t ui_confirm_tx_text(
+        const bytecoin_signing_state_t* sig_state,
+        ui_confirm_tx_item_t item,
+        char* str,
+        size_t size)
+{
+    size_t len = 0;
+    if (item == UI_CONFIRM_TX_RECIPIENT)
+    {
+        const uint64_t prefix = (sig_state->dst_address_tag == BYTECOIN_UNLINKABLE_ADDRESS_TAG) ? BYTECOIN_ADDRESS_BASE58_PREFIX_AMETHYST : BYTECOIN_ADDRESS_BASE58_PREFIX;
+        if (size < 1)
+            THROW(SW_NOT_ENOUGH_MEMORY);
+        len = encode_address(prefix, &sig_state->dst_address_s, &sig_state->dst_address_s_v, str, size - 1);
+    }
+    else
+    {
+        if (size < AMOUNT_STR_MAX_LENGTH + sizeof(BCN_str))
+            THROW(SW_NOT_ENOUGH_MEMORY);
+        const uint64_t amount = (item == UI_CONFIRM_TX_AMOUNT) ? sig_state->dst_amount : sig_state->dst_fee;
+        len = amount2str(amount, str, size);
+        os_memmove(str + len, BCN_str, sizeof(BCN_str) - 1);
+        len += sizeof(BCN_str) - 1;
+    }
+    str[len] = 0;
+    return len;
+}
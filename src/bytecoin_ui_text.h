@@ -0,0 +1,45 @@
+/*******************************************************************************
+*   Bytecoin Wallet for Ledger Nano S
+*   (c) 2018 - 2019 The Bytecoin developers
+*
+*  Licensed under the Apache License, Version 2.0 (the "License");
+*  you may not use this file except in compliance with the License.
+*  You may obtain a copy of the License at
+*
+*      http://www.apache.org/licenses/LICENSE-2.0
+*
+*  Unless required by applicable law or agreed to in writing, software
+*  distributed under the License is distributed on an "AS IS" BASIS,
+*  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+*  See the License for the specific language governing permissions and
+*  limitations under the License.
+********************************************************************************/
+
+#ifndef BYTECOIN_UI_TEXT_H
+#define BYTECOIN_UI_TEXT_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "bytecoin_sig.h"
+
+// Text of the transaction confirmation, shared by bytecoin_ui.c and the host
+// stand-in so that both display and time the same strings.
+typedef enum ui_confirm_tx_item_e
+{
+    UI_CONFIRM_TX_RECIPIENT = 0,
+    UI_CONFIRM_TX_AMOUNT,
+    UI_CONFIRM_TX_FEE,
+    UI_CONFIRM_TX_ITEMS
+} ui_confirm_tx_item_t;
+
+// writes the amount in coins without a terminating zero, returns its length
+size_t amount2str(uint64_t amount, char* buffer, size_t len);
+
+// writes the value of the item as a zero terminated string, returns its length
+size_t ui_confirm_tx_text(
+        const bytecoin_signing_state_t* sig_state,
+        ui_confirm_tx_item_t item,
+        char* str,
+        size_t size);
+
+#endif // BYTECOIN_UI_TEXT_H
@@ -17,11 +17,25 @@
 
 #include "bytecoin_vars.h"
 
-void init_vstate(bytecoin_v_state_t* state)
+// The RAM the state may take on the Nano S next to the SDK and the stack; it
+// is 1800 bytes on a 64-bit host, a little less on the device. Grow it
+// knowingly; the stats of BYTECOIN_STATS come on top.
+#define BYTECOIN_VSTATE_MAX_SIZE 1824
+
+#ifndef BYTECOIN_STATS
+_Static_assert(sizeof(bytecoin_v_state_t) <= BYTECOIN_VSTATE_MAX_SIZE, "bytecoin_v_state_t outgrew BYTECOIN_VSTATE_MAX_SIZE");
+#endif
+
+void init_vstate(bytecoin_v_state_t* state, uint8_t* io_apdu_buffer)
 {
-    init_io_buffer(&state->io_buffer);
+    init_io_buffer(&state->io_buffer, io_apdu_buffer);
     init_signing_state(&state->sig_state);
+    init_prefix(&state->prefix);
     init_wallet_keys(&state->wallet_keys);
+    init_address_secret_cache(&state->address_cache);
     init_ui_data(&state->ui_data);
     init_io_call_params(&state->prev_io_call_params);
+#ifdef BYTECOIN_STATS
+    init_stats(&state->stats);
+#endif
 }
@@ -20,20 +20,31 @@
 
 #include "bytecoin_io.h"
 #include "bytecoin_sig.h"
+#include "bytecoin_prefix.h"
 #include "bytecoin_wallet.h"
 #include "bytecoin_ui.h"
+#include "bytecoin_stats.h"
 
+// everything a wallet instance keeps between APDUs; the core only works on
+// the state it is given, so any number of instances may run side by side
 typedef struct bytecoin_v_state_s
 {
     io_buffer_t io_buffer;
     bytecoin_signing_state_t sig_state;
+    bytecoin_prefix_t prefix;
     wallet_keys_t wallet_keys;
+    address_secret_cache_t address_cache;
     ui_data_t ui_data;
     io_call_params_t prev_io_call_params;
+#ifdef BYTECOIN_STATS
+    bytecoin_stats_t stats;
+#endif
 } bytecoin_v_state_t;
 
-void init_vstate(bytecoin_v_state_t* state);
+// io_apdu_buffer is the BYTECOIN_IO_BUFFER_SIZE bytes buffer io_exchange() works on
+void init_vstate(bytecoin_v_state_t* state, uint8_t* io_apdu_buffer);
 
+// the single instance of the firmware, only the device glue refers to it
 extern bytecoin_v_state_t G_bytecoin_vstate;
 
 #endif // BYTECOIN_VARS_H
@@ -34,14 +34,13 @@ static const char view_key_str[]       = "view_key";
 static const char view_key_audit_str[] = "view_key_audit";
 static const char spend_key_str[]      = "spend_key";
 static const char wallet_key_str[]     = "wallet_key";
+static const char sign_secrets_str[]   = "sign_secrets";
+static const char scalars_str[]        = "scalars";
 
 #ifdef BYTECOIN_DEBUG_SEED
 static const char bcn_str[] = "bcn";
 #endif
 
-uint32_t G_last_index;
-uint8_t G_last_audit_secret_key[sizeof(secret_key_t)];
-
 void init_wallet_keys(wallet_keys_t* wallet_keys)
 {
     uint8_t bpk[32];
@@ -61,32 +60,37 @@ void init_wallet_keys(wallet_keys_t* wallet_keys)
                 &wallet_keys->audit_key_base_secret_key,
                 &wallet_keys->sH,
                 &wallet_keys->A_plus_sH);
+}
 
-    G_last_index = UINT32_MAX;
-    os_memset(G_last_audit_secret_key, 0, sizeof(G_last_audit_secret_key));
+void init_address_secret_cache(address_secret_cache_t* cache)
+{
+    os_memset(cache, 0, sizeof(address_secret_cache_t));
+    cache->index = UINT32_MAX;
 }
 
 void prepare_address_secret(
         const wallet_keys_t* wallet_keys,
+        address_secret_cache_t* address_cache,
         uint32_t address_index,
         secret_key_t* result)
 {
-    if (G_last_index != address_index)
+    if (address_cache->index != address_index)
     {
-        generate_hd_secret_key(&wallet_keys->audit_key_base_secret_key, &wallet_keys->A_plus_sH, address_index, (secret_key_t*)G_last_audit_secret_key);
-        G_last_index = address_index;
+        generate_hd_secret_key(&wallet_keys->audit_key_base_secret_key, &wallet_keys->A_plus_sH, address_index, &address_cache->secret);
+        address_cache->index = address_index;
     }
-    os_memmove(result->data, G_last_audit_secret_key, sizeof(result->data));
+    os_memmove(result->data, address_cache->secret.data, sizeof(result->data));
 }
 
 void prepare_address_public(
         const wallet_keys_t* wallet_keys,
+        address_secret_cache_t* address_cache,
         uint32_t address_index,
         public_key_t* address_S,
         public_key_t* address_Sv)
 {
     secret_key_t address_audit_secret_key;
-    prepare_address_secret(wallet_keys, address_index, &address_audit_secret_key);
+    prepare_address_secret(wallet_keys, address_cache, address_index, &address_audit_secret_key);
     public_key_t address_audit_public_key;
     secret_key_to_public_key(&address_audit_secret_key, &address_audit_public_key);
 
@@ -126,6 +130,7 @@ void scan_outputs(
 
 void generate_keyimage_for_address(
         const wallet_keys_t* wallet_keys,
+        address_secret_cache_t* address_cache,
         const uint8_t* buf,
         size_t len,
         uint32_t address_index,
@@ -137,7 +142,7 @@ void generate_keyimage_for_address(
     invert32(&output_secret_hash, &inv_output_secret_hash);
 
     secret_key_t address_audit_secret_key;
-    prepare_address_secret(wallet_keys, address_index, &address_audit_secret_key);
+    prepare_address_secret(wallet_keys, address_cache, address_index, &address_audit_secret_key);
     secret_key_t output_secret_key_a;
     ecmulm(&address_audit_secret_key, &inv_output_secret_hash, &output_secret_key_a);
     secret_key_t output_secret_key_s;
@@ -161,12 +166,11 @@ void generate_output_seed(
     keccak_final(&hasher, result);
 }
 
-void generate_sign_secret(
+void generate_sign_secrets(
         const wallet_keys_t* wallet_keys,
         uint32_t i,
-        const uint8_t secret_name[2],
         const hash_t* random_seed,
-        secret_key_t* result)
+        sign_secrets_t* result)
 {
     keccak_hasher_t hasher;
     keccak_init(&hasher);
@@ -176,10 +180,17 @@ void generate_sign_secret(
     reverse(reversed, wallet_keys->spend_secret_key.data, sizeof(reversed));
 
     keccak_update(&hasher, reversed, sizeof(reversed));
-    keccak_update_byte(&hasher, secret_name[0]);
-    keccak_update_byte(&hasher, secret_name[1]);
+    keccak_update(&hasher, sign_secrets_str, sizeof(sign_secrets_str) - 1);
+    keccak_update_varint(&hasher, BYTECOIN_SIGN_SECRETS_VERSION);
     keccak_update_varint(&hasher, i);
-    keccak_final_to_scalar64(&hasher, result);
+
+    // ks, ka and kr of 64 bytes each
+    uint8_t wide[3][64];
+    crypto_keccak_final(&hasher, wide[0], sizeof(wide));
+    reduce64_wide(wide[0], &result->ks);
+    reduce64_wide(wide[1], &result->ka);
+    reduce64_wide(wide[2], &result->kr);
+    os_memset(wide, 0, sizeof(wide));
 }
 
 void encrypt_scalar(
@@ -202,6 +213,26 @@ void encrypt_scalar(
         result->data[j] ^= scalar->data[sizeof(scalar->data) - j - 1];
 }
 
+void encrypt_scalars(
+        const hash_t* encryption_key,
+        const elliptic_curve_scalar_t scalars[3],
+        uint32_t i,
+        hash_t result[3])
+{
+    {
+        keccak_hasher_t hasher;
+        keccak_init(&hasher);
+        keccak_update(&hasher, encryption_key->data, sizeof(encryption_key->data));
+        keccak_update(&hasher, scalars_str, sizeof(scalars_str) - 1);
+        keccak_update_varint(&hasher, BYTECOIN_SCALARS_KEY_STREAM_VERSION);
+        keccak_update_varint(&hasher, i);
+        crypto_keccak_final(&hasher, result[0].data, 3 * sizeof(result[0].data));
+    }
+    for (uint32_t k = 0; k < 3; ++k)
+        for (uint32_t j = 0; j < sizeof(scalars[k].data); ++j)
+            result[k].data[j] ^= scalars[k].data[sizeof(scalars[k].data) - j - 1];
+}
+
 void generate_random_keys(
         hash_t* random_seed,
         hash_t* encryption_key)
@@ -215,6 +246,15 @@ void generate_random_keys(
 #endif
 }
 
+void generate_token_key(hash_t* token_key)
+{
+#ifdef BYTECOIN_DEBUG_SEED
+    fast_hash(bcn_str, sizeof(bcn_str) - 1, token_key);
+#else
+    generate_random_bytes(token_key->data, sizeof(token_key->data));
+#endif
+}
+
 void export_view_only(
         const wallet_keys_t* wallet_keys,
         secret_key_t* audit_key_base_secret_key,
@@ -32,7 +32,15 @@ typedef struct wallet_keys_s
     public_key_t A_plus_sH;
 } wallet_keys_t;
 
+// the audit secret key of the last address used, deriving it is expensive
+typedef struct address_secret_cache_s
+{
+    uint32_t index;
+    secret_key_t secret;
+} address_secret_cache_t;
+
 void init_wallet_keys(wallet_keys_t* wallet_keys);
+void init_address_secret_cache(address_secret_cache_t* cache);
 
 void get_wallet_keys(
         const wallet_keys_t* wallet_keys,
@@ -48,6 +56,7 @@ void scan_outputs(
 
 void generate_keyimage_for_address(
         const wallet_keys_t* wallet_keys,
+        address_secret_cache_t* address_cache,
         const uint8_t* buf,
         size_t len,
         uint32_t address_index,
@@ -59,12 +68,22 @@ void generate_output_seed(
         uint32_t out_index,
         hash_t* result);
 
-void generate_sign_secret(
+// Bumped whenever the derivation of the sign secrets changes: 1 hashed each
+// secret apart, 2 squeezes the three of an input from one sponge.
+#define BYTECOIN_SIGN_SECRETS_VERSION 2
+
+typedef struct sign_secrets_s
+{
+    secret_key_t ks;
+    secret_key_t ka;
+    secret_key_t kr;
+} sign_secrets_t;
+
+void generate_sign_secrets(
         const wallet_keys_t* wallet_keys,
         uint32_t i,
-        const uint8_t secret_name[2],
         const hash_t* random_seed,
-        secret_key_t* result);
+        sign_secrets_t* result);
 
 void encrypt_scalar(
         const hash_t* encryption_key,
@@ -73,17 +92,32 @@ void encrypt_scalar(
         const uint8_t scalar_name[2],
         hash_t* result);
 
+// Bumped whenever the key stream of encrypt_scalars() changes.
+#define BYTECOIN_SCALARS_KEY_STREAM_VERSION 1
+
+// the three scalars of input i encrypted as encrypt_scalar() does, with
+// slices of one key stream
+void encrypt_scalars(
+        const hash_t* encryption_key,
+        const elliptic_curve_scalar_t scalars[3],
+        uint32_t i,
+        hash_t result[3]);
+
 void generate_random_keys(
         hash_t* random_seed,
         hash_t* encryption_key);
 
+void generate_token_key(hash_t* token_key);
+
 void prepare_address_secret(
         const wallet_keys_t* wallet_keys,
+        address_secret_cache_t* address_cache,
         uint32_t address_index,
         secret_key_t* result);
 
 void prepare_address_public(
         const wallet_keys_t* wallet_keys,
+        address_secret_cache_t* address_cache,
         uint32_t address_index,
         public_key_t* address_S,
         public_key_t* address_Sv);